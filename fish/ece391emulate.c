@@ -225,3 +225,13 @@ ece391_close (int32_t fd)
     return 0;
 }
 
+int32_t 
+ece391_sbrk (int32_t increment)
+{
+    void* old_brk;
+
+    /* memory the host's brk hands out for the first time is zeroed too */
+    if ((void*)-1 == (old_brk = sbrk (increment)))
+        return -1;
+    return (int32_t)old_brk;
+}
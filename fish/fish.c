@@ -18,14 +18,19 @@ uint8_t file1[] = "frame1.txt";
 extern int mp1_ioctl(unsigned long arg, unsigned long cmd);
 extern void mp1_rtc_tasklet(unsigned long trash);
 
-static struct mp1_blink_struct blink_array[80*25];
+/* one per screen cell, on the heap: sbrk memory reads as zero and only the pages
+ * touched take physical memory */
+static struct mp1_blink_struct* blink_array;
 
 int main(void)
 {
     int rtc_fd, ret_val, i, garbage;
     struct mp1_blink_struct blink_struct;
 
-    ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
+    blink_array = (struct mp1_blink_struct*)ece391_sbrk(sizeof(struct mp1_blink_struct)*80*25);
+    if((int32_t)blink_array == -1) {
+        return -1;
+    }
 
     if(mp1_set_video_mode() == NULL) {
         return -1;
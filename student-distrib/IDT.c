@@ -29,7 +29,7 @@ void setup_idt () {
     SET_IDT_ENTRY(idt[0x0B], &exception_segment_not_present);
     SET_IDT_ENTRY(idt[0x0C], &exception_stack_fault);
     SET_IDT_ENTRY(idt[0x0D], &exception_general_protection);
-    SET_IDT_ENTRY(idt[0x0E], &exception_page_fault);
+    SET_IDT_ENTRY(idt[0x0E], &page_fault_linkage);  // returns after demand paging
     /* no interrupt 15 defined */
     SET_IDT_ENTRY(idt[0x10], &exception_FPU_floating_point_error);
     SET_IDT_ENTRY(idt[0x11], &exception_alignment_check);
@@ -39,6 +39,12 @@ void setup_idt () {
     SET_IDT_ENTRY(idt[KEYBOARD], &keyboard_irq_handler_linkage); // call linkage function
     SET_IDT_ENTRY(idt[RTC], &RTC_linkage);  // call linkage function
     SET_IDT_ENTRY(idt[PIT], &PIT_linkage);  // call linkage function
+    SET_IDT_ENTRY(idt[ATA_PRIMARY], &ata_primary_linkage);
+    SET_IDT_ENTRY(idt[ATA_SECONDARY], &ata_secondary_linkage);
+    SET_IDT_ENTRY(idt[PCI_IRQ5], &pci_irq5_linkage);
+    SET_IDT_ENTRY(idt[PCI_IRQ9], &pci_irq9_linkage);
+    SET_IDT_ENTRY(idt[PCI_IRQ10], &pci_irq10_linkage);
+    SET_IDT_ENTRY(idt[PCI_IRQ11], &pci_irq11_linkage);
     SET_IDT_ENTRY(idt[SYSTEM_CALL], &system_calls);
     /* go through first 20 exceptions first */
     for (i = 0; i < 20; i++) {
@@ -53,6 +59,7 @@ void setup_idt () {
         idt[i].present = 1;
         idt[i].dpl = 0;     // ring 0 for kernel Descriptor Privilege Level
     }
+    idt[0x0E].reserved3 = 0;    // page fault uses an interrupt gate so cr2 cannot be clobbered before it is read
     // go through interrupts
     for (i = 32; i < NUM_VEC; i++) {
         idt[i].seg_selector = KERNEL_CS;    // all descriptors are in kernel code segment
@@ -196,6 +203,12 @@ void exception_general_protection() {
 }
 
 void exception_page_fault() {
+    uint32_t fault_addr;
+    asm volatile ("movl %%cr2, %0" : "=r"(fault_addr));
+    page_fault_count++;
+    if (demand_load_page(fault_addr) == 0) {
+        return;     // page is now mapped, retry the faulting instruction
+    }
     printf("Page fault \n");
     system_calls(halt(0x0E));
     while(1);
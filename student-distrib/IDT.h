@@ -10,6 +10,15 @@
 #define PIT 0x20                // IDT port for PIT
 #define KEYBOARD 0x21           // IDT port for keyboard
 #define RTC 0x28                // IDT port for RTC
+#define ATA_PRIMARY 0x2E        // IDT port for the primary IDE channel
+#define ATA_SECONDARY 0x2F      // IDT port for the secondary IDE channel
+#define PCI_IRQ5 0x25           // IDT ports for the lines PCI interrupts may be routed to
+#define PCI_IRQ9 0x29
+#define PCI_IRQ10 0x2A
+#define PCI_IRQ11 0x2B
+
+/* page faults taken since boot, including the ones demand loading resolved */
+uint32_t page_fault_count;
 
 void setup_idt ();
 /* exceptions */
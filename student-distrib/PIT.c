@@ -33,6 +33,7 @@ void init_PIT() {
  *   Side effects: send eoi
  */
 void PIT_handler() {
+    irq_counts[PIT_IRQ]++;
     send_eoi(PIT_IRQ);
 
     /* To be done: context switch */
@@ -1,6 +1,7 @@
 #include "RTC.h"
 #include "lib.h"
 #include "i8259.h"
+#include "system_calls.h"
 /* Global variables */
 int num_interrupts;
 int int_count;
@@ -36,6 +37,7 @@ void init_RTC () {
  *   SIDE EFFECTS: call RTC test function for checkpoint 1
  */  
 void RTC_handler () {
+    irq_counts[IRQ_NUM]++;
     outb(STATUS_REG_C, IO_PORT1);   // set register C
     inb(IO_PORT2);	                // throw away contents
     int_count--;                    // decrement int_count
@@ -134,3 +136,20 @@ int32_t RTC_read (int32_t fd, void* buf, int32_t nbytes) {
     }
     return 0;
 }
+
+/*
+ * RTC_stat
+ *   DESCRIPTION: file stat function for RTC
+ *   INPUTS: int32_t fd, stat_t* buf
+ *   OUTPUTS: buf filled with the RTC's type
+ *   RETURN VALUE: 0 
+ *   SIDE EFFECTS: none
+ */
+int32_t RTC_stat (int32_t fd, stat_t* buf) {
+    buf->file_type = RTC_TYPE;
+    buf->inode_num = 0;
+    buf->size = 0;
+    return 0;
+}
+
+file_ops RTC_fop = {RTC_open, RTC_read, RTC_write, RTC_close, RTC_stat};
@@ -2,6 +2,7 @@
 #define _RTC_H
 
 #include "types.h"
+#include "filesystem.h"
 
 #define IRQ_NUM 8   // designated IRQ port on PIC
 #define IO_PORT1 0x70   // IO port 1, used to specify an index
@@ -23,5 +24,6 @@ int32_t RTC_open (const uint8_t* fname);
 int32_t RTC_close (int32_t fd);
 int32_t RTC_read (int32_t fd, void* buf, int32_t nbytes);
 int32_t RTC_write (int32_t fd, const void* buf, int32_t nbytes);
+int32_t RTC_stat (int32_t fd, stat_t* buf);
 
 #endif
@@ -0,0 +1,527 @@
+/* ata.c - ATA (IDE) disk driver with PIO and bus master DMA
+ * vim:ts=4 noexpandtab
+ *
+ * Register usage follows https://wiki.osdev.org/ATA_PIO_Mode and
+ * https://wiki.osdev.org/ATA/ATAPI_using_DMA. Drives are addressed with LBA28.
+ *
+ * PIO transfers are polled with interrupts off. DMA transfers are started, then the
+ * caller spins with interrupts on until the channel's IRQ marks the request done, so
+ * the scheduler keeps running other processes meanwhile. A caller that has interrupts
+ * off (mount at boot, filesystem code under cli) polls the bus master status instead.
+ * start_read programs the same DMA and returns at once; the interrupt then calls the
+ * block layer's callback.
+*/
+
+#include "ata.h"
+#include "lib.h"
+#include "i8259.h"
+#include "pci.h"
+
+#define EFLAGS_IF   0x200   // interrupts enabled
+
+static ata_channel_t channels[ATA_CHANNELS];
+static ata_drive_t drives[ATA_DRIVES];
+static uint16_t identify_buf[ATA_IDENTIFY_WORDS];
+
+/* ata_delay
+ * Description: wait the 400ns a drive needs after selection, by reading the alternate
+ *              status register, which does not acknowledge an interrupt
+ * Input: chan: the channel
+ * Output: the alternate status
+*/
+static uint8_t ata_delay(ata_channel_t* chan){
+    inb(chan->ctrl);
+    inb(chan->ctrl);
+    inb(chan->ctrl);
+    return inb(chan->ctrl);
+}
+
+/* ata_wait
+ * Description: poll until the drive is not busy, and has data ready if drq is set
+ * Input: chan: the channel
+ *        drq: 1 to also wait for DRQ
+ * Output: 0 when ready, -1 on a drive error or timeout
+*/
+static int32_t ata_wait(ata_channel_t* chan, uint32_t drq){
+    uint32_t i;
+    uint8_t status;
+
+    for(i = 0; i < ATA_TIMEOUT; i++){
+        status = inb(chan->ctrl);
+        if(status & ATA_STATUS_BSY){
+            continue;
+        }
+        if(status & (ATA_STATUS_ERR | ATA_STATUS_DF)){
+            return -1;
+        }
+        if(!drq || (status & ATA_STATUS_DRQ)){
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* ata_select
+ * Description: select a drive and load the task file for a transfer
+ * Input: drive: the drive
+ *        lba: first sector
+ *        count: number of sectors, 1 to 256
+ * Output: none
+*/
+static void ata_select(ata_drive_t* drive, uint32_t lba, uint32_t count){
+    ata_channel_t* chan = drive->channel;
+
+    outb(ATA_DRIVE_LBA | (drive->slave << 4) | ((lba >> 24) & 0x0F), chan->io + ATA_REG_DRIVE);
+    ata_delay(chan);
+    outb(count & 0xFF, chan->io + ATA_REG_COUNT);   //0 means 256
+    outb(lba & 0xFF, chan->io + ATA_REG_LBA0);
+    outb((lba >> 8) & 0xFF, chan->io + ATA_REG_LBA1);
+    outb((lba >> 16) & 0xFF, chan->io + ATA_REG_LBA2);
+}
+
+/* ata_complete
+ * Description: finish the channel's DMA transfer: stop the bus master, acknowledge the
+ *              drive, and hand the status to the waiting request
+ * Input: chan: the channel, with interrupts off
+ * Output: none
+*/
+static void ata_complete(ata_channel_t* chan){
+    ata_request_t* req = chan->current;
+
+    if(req == NULL){
+        inb(chan->io + ATA_REG_STATUS);     //acknowledge a stray or PIO interrupt
+        return;
+    }
+    outb(0, chan->bm + BM_REG_CMD);
+    req->bm_status = inb(chan->bm + BM_REG_STATUS);
+    req->status = inb(chan->io + ATA_REG_STATUS);
+    outb(BM_STATUS_IRQ | BM_STATUS_ERR, chan->bm + BM_REG_STATUS);  //write 1 to clear
+    chan->current = NULL;
+    req->done = 1;
+    if(req->callback != NULL){
+        req->callback(req->arg, ((req->bm_status & BM_STATUS_ERR) ||
+                                 (req->status & (ATA_STATUS_ERR | ATA_STATUS_DF))) ? -1 : 0);
+    }
+}
+
+/* ata_poll
+ * Description: complete the channel's DMA transfer if the drive has finished it, for
+ *              callers that cannot wait for the interrupt
+ * Input: chan: the channel, with interrupts off
+ * Output: none
+*/
+static void ata_poll(ata_channel_t* chan){
+    if(chan->current != NULL && (inb(chan->bm + BM_REG_STATUS) & (BM_STATUS_IRQ | BM_STATUS_ERR)) &&
+       !(inb(chan->ctrl) & ATA_STATUS_BSY)){
+        ata_complete(chan);
+    }
+}
+
+/* ata_claim
+ * Description: wait for the channel to be idle and leave interrupts off, so the caller
+ *              owns it until it starts a transfer or restores flags
+ * Input: chan: the channel
+ *        flags: set to the caller's EFLAGS, for restore_flags
+ * Output: none
+*/
+static void ata_claim(ata_channel_t* chan, uint32_t* flags){
+    uint32_t saved;
+    uint32_t i;
+
+    for(i = 0; ; i++){
+        cli_and_save(saved);
+        if(chan->current == NULL){
+            *flags = saved;
+            return;
+        }
+        if(!(saved & EFLAGS_IF)){
+            ata_poll(chan);     //the owner cannot run until we give up the CPU
+            if(i == ATA_TIMEOUT){
+                ata_complete(chan); //abandon a transfer the drive never finished
+            }
+        }
+        restore_flags(saved);
+    }
+}
+
+/* ata_pio
+ * Description: transfer sectors by PIO, polling the drive
+ * Input: drive: the drive
+ *        lba: first sector
+ *        count: number of sectors, at most ATA_MAX_SECTORS
+ *        buf: data
+ *        write: 1 to write to the disk
+ * Output: 0 for success, -1 on a drive error or timeout
+*/
+static int32_t ata_pio(ata_drive_t* drive, uint32_t lba, uint32_t count, uint16_t* buf, uint32_t write){
+    ata_channel_t* chan = drive->channel;
+    uint32_t flags, i, j;
+    int32_t ret = 0;
+
+    ata_claim(chan, &flags);
+    ata_select(drive, lba, count);
+    outb(write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO, chan->io + ATA_REG_STATUS);
+    for(i = 0; i < count && ret == 0; i++){
+        ata_delay(chan);
+        if(ata_wait(chan, 1) == -1){
+            ret = -1;
+            break;
+        }
+        for(j = 0; j < SECTOR_SIZE / 2; j++, buf++){
+            if(write){
+                outw(*buf, chan->io + ATA_REG_DATA);
+            }else{
+                *buf = inw(chan->io + ATA_REG_DATA);
+            }
+        }
+    }
+    if(write && ret == 0){
+        outb(ATA_CMD_FLUSH, chan->io + ATA_REG_STATUS);
+        ret = ata_wait(chan, 0);
+    }
+    inb(chan->io + ATA_REG_STATUS);     //acknowledge the last interrupt
+    restore_flags(flags);
+    return ret;
+}
+
+/* ata_build_prdt
+ * Description: describe a buffer to the bus master, splitting it at 64KB boundaries
+ * Input: chan: the channel
+ *        buf: buffer, identity mapped kernel memory at an even address
+ *        bytes: length, at most ATA_MAX_SECTORS sectors
+ * Output: 0 for success, -1 if the buffer needs more entries than the table holds
+*/
+static int32_t ata_build_prdt(ata_channel_t* chan, uint32_t buf, uint32_t bytes){
+    uint32_t i, piece;
+
+    for(i = 0; i < ATA_PRD_ENTRIES && bytes > 0; i++){
+        piece = PRD_MAX_BYTES - (buf & (PRD_MAX_BYTES - 1));
+        if(piece > bytes){
+            piece = bytes;
+        }
+        chan->prdt[i].addr = buf;
+        chan->prdt[i].count = piece & 0xFFFF;
+        chan->prdt[i].flags = 0;
+        buf += piece;
+        bytes -= piece;
+    }
+    if(bytes > 0){
+        return -1;
+    }
+    chan->prdt[i - 1].flags = PRD_EOT;
+    return 0;
+}
+
+/* ata_build_prdt_pages
+ * Description: describe separate pages to the bus master, one entry each
+ * Input: chan: the channel
+ *        pages: number of pages, at most ATA_PRD_ENTRIES
+ *        page_bufs: BLK_PAGE_SIZE aligned, identity mapped kernel buffers
+ * Output: none
+*/
+static void ata_build_prdt_pages(ata_channel_t* chan, uint32_t pages, uint8_t* const* page_bufs){
+    uint32_t i;
+
+    for(i = 0; i < pages; i++){
+        chan->prdt[i].addr = (uint32_t)page_bufs[i];
+        chan->prdt[i].count = BLK_PAGE_SIZE;
+        chan->prdt[i].flags = 0;
+    }
+    chan->prdt[pages - 1].flags = PRD_EOT;
+}
+
+/* ata_dma_start
+ * Description: start a bus master transfer described by the channel's table
+ * Input: drive: the drive, whose channel the caller has claimed with interrupts off
+ *        lba: first sector
+ *        count: number of sectors, at most ATA_MAX_SECTORS
+ *        write: 1 to write to the disk
+ *        req: request the interrupt completes
+ * Output: none
+*/
+static void ata_dma_start(ata_drive_t* drive, uint32_t lba, uint32_t count, uint32_t write, ata_request_t* req){
+    ata_channel_t* chan = drive->channel;
+
+    req->done = 0;
+    outb(0, chan->bm + BM_REG_CMD);
+    outl((uint32_t)chan->prdt, chan->bm + BM_REG_PRDT);
+    outb(BM_STATUS_IRQ | BM_STATUS_ERR, chan->bm + BM_REG_STATUS);
+    outb(write ? 0 : BM_CMD_READ, chan->bm + BM_REG_CMD);
+    ata_select(drive, lba, count);
+    chan->current = req;
+    outb(write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA, chan->io + ATA_REG_STATUS);
+    outb((write ? 0 : BM_CMD_READ) | BM_CMD_START, chan->bm + BM_REG_CMD);
+}
+
+/* ata_dma
+ * Description: transfer sectors by bus master DMA and wait for the interrupt
+ * Input: drive: the drive
+ *        lba: first sector
+ *        count: number of sectors, at most ATA_MAX_SECTORS
+ *        buf: data, identity mapped kernel memory at an even address
+ *        write: 1 to write to the disk
+ * Output: 0 for success, -1 on a drive or bus error
+*/
+static int32_t ata_dma(ata_drive_t* drive, uint32_t lba, uint32_t count, void* buf, uint32_t write){
+    ata_channel_t* chan = drive->channel;
+    ata_request_t req;
+    uint32_t flags, i;
+
+    ata_claim(chan, &flags);
+    if(ata_build_prdt(chan, (uint32_t)buf, count * SECTOR_SIZE) == -1){
+        restore_flags(flags);
+        return -1;
+    }
+    req.callback = NULL;
+    ata_dma_start(drive, lba, count, write, &req);
+    restore_flags(flags);
+
+    for(i = 0; !req.done; i++){
+        if(!(flags & EFLAGS_IF)){
+            ata_poll(chan);     //no interrupt can arrive
+        }
+        if(i == ATA_TIMEOUT){
+            cli_and_save(flags);
+            if(!req.done){
+                ata_complete(chan);
+                req.bm_status |= BM_STATUS_ERR;
+            }
+            restore_flags(flags);
+        }
+    }
+    if((req.bm_status & BM_STATUS_ERR) || (req.status & (ATA_STATUS_ERR | ATA_STATUS_DF))){
+        return -1;
+    }
+    return 0;
+}
+
+/* ata_read
+ * Description: block_dev_t read for an ATA drive
+ * Input: dev: the drive's block device
+ *        lba: first sector
+ *        count: number of sectors, at most ATA_MAX_SECTORS
+ *        buf: destination
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t ata_read(block_dev_t* dev, uint32_t lba, uint32_t count, void* buf){
+    ata_drive_t* drive = dev->data;
+    if(drive->use_dma && !((uint32_t)buf & 1)){
+        return ata_dma(drive, lba, count, buf, 0);
+    }
+    return ata_pio(drive, lba, count, buf, 0);
+}
+
+/* ata_start_read
+ * Description: block_dev_t start_read for an ATA drive: starts a DMA read and returns,
+ *              the channel's interrupt calls done. Without DMA the pages are read by PIO
+ *              before returning
+ * Input: dev: the drive's block device
+ *        lba: first sector
+ *        pages: number of pages, at most BLK_MAX_PAGES
+ *        page_bufs: destination pages
+ *        done: completion callback
+ *        arg: passed to done
+ * Output: 0 if started, -1 if the channel is busy with another transfer
+*/
+static int32_t ata_start_read(block_dev_t* dev, uint32_t lba, uint32_t pages, uint8_t* const* page_bufs,
+                              blk_done_t done, void* arg){
+    ata_drive_t* drive = dev->data;
+    ata_channel_t* chan = drive->channel;
+    uint32_t flags, i;
+    int32_t ret = 0;
+
+    if(!drive->use_dma){
+        for(i = 0; i < pages && ret == 0; i++){
+            ret = ata_pio(drive, lba + i * BLK_PAGE_SECTORS, BLK_PAGE_SECTORS, (uint16_t*)page_bufs[i], 0);
+        }
+        done(arg, ret);
+        return 0;
+    }
+    cli_and_save(flags);
+    if(chan->current != NULL){
+        restore_flags(flags);
+        return -1;
+    }
+    ata_build_prdt_pages(chan, pages, page_bufs);
+    chan->async.callback = done;
+    chan->async.arg = arg;
+    ata_dma_start(drive, lba, pages * BLK_PAGE_SECTORS, 0, &chan->async);
+    restore_flags(flags);
+    return 0;
+}
+
+/* ata_poll_dev
+ * Description: block_dev_t poll for an ATA drive: complete its channel's transfer if
+ *              the drive has finished it
+ * Input: dev: the drive's block device
+ * Output: none
+*/
+static void ata_poll_dev(block_dev_t* dev){
+    ata_drive_t* drive = dev->data;
+    uint32_t flags;
+
+    if(drive->channel->bm == 0){
+        return;
+    }
+    cli_and_save(flags);
+    ata_poll(drive->channel);
+    restore_flags(flags);
+}
+
+/* ata_write
+ * Description: block_dev_t write for an ATA drive
+ * Input: dev: the drive's block device
+ *        lba: first sector
+ *        count: number of sectors, at most ATA_MAX_SECTORS
+ *        buf: source
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t ata_write(block_dev_t* dev, uint32_t lba, uint32_t count, const void* buf){
+    ata_drive_t* drive = dev->data;
+    if(drive->use_dma && !((uint32_t)buf & 1)){
+        return ata_dma(drive, lba, count, (void*)buf, 1);
+    }
+    return ata_pio(drive, lba, count, (uint16_t*)buf, 1);
+}
+
+/* ata_identify
+ * Description: ask a drive for its identify block
+ * Input: drive: the drive, with channel and slave set
+ * Output: 0 if an ATA disk answered (identify_buf holds its data), -1 if not
+*/
+static int32_t ata_identify(ata_drive_t* drive){
+    ata_channel_t* chan = drive->channel;
+    uint32_t i;
+    uint8_t status;
+
+    outb(ATA_DRIVE_LBA | (drive->slave << 4), chan->io + ATA_REG_DRIVE);
+    ata_delay(chan);
+    outb(0, chan->io + ATA_REG_COUNT);
+    outb(0, chan->io + ATA_REG_LBA0);
+    outb(0, chan->io + ATA_REG_LBA1);
+    outb(0, chan->io + ATA_REG_LBA2);
+    outb(ATA_CMD_IDENTIFY, chan->io + ATA_REG_STATUS);
+    status = ata_delay(chan);
+    if(status == 0 || status == ATA_STATUS_NONE){
+        return -1;  //no drive
+    }
+    for(i = 0; i < ATA_TIMEOUT && (inb(chan->ctrl) & ATA_STATUS_BSY); i++);
+    if(inb(chan->io + ATA_REG_LBA1) != 0 || inb(chan->io + ATA_REG_LBA2) != 0){
+        return -1;  //ATAPI or SATA signature, not a plain ATA disk
+    }
+    if(ata_wait(chan, 1) == -1){
+        return -1;
+    }
+    for(i = 0; i < ATA_IDENTIFY_WORDS; i++){
+        identify_buf[i] = inw(chan->io + ATA_REG_DATA);
+    }
+    return 0;
+}
+
+/* ata_init
+ * Description: find the IDE controller's bus master registers, identify the four
+ *              possible drives and register each disk as hda to hdd
+ * Input: none
+ * Output: none
+ * Side effect: unmasks IRQ 14 and 15; call after i8259_init
+*/
+void ata_init (){
+    pci_addr_t ide;
+    uint32_t bar4 = 0;
+    uint32_t i;
+    ata_drive_t* drive;
+
+    if(pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &ide) == 0){
+        bar4 = pci_config_read(ide, PCI_BAR4);
+        if(bar4 & PCI_BAR_IO){
+            bar4 &= PCI_BAR_IO_MASK;
+            pci_config_write(ide, PCI_COMMAND,
+                             pci_config_read(ide, PCI_COMMAND) | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+        }else{
+            bar4 = 0;   //no bus master, PIO only
+        }
+    }
+
+    channels[0].io = ATA_PRIMARY_IO;
+    channels[0].ctrl = ATA_PRIMARY_CTRL;
+    channels[0].irq = ATA_PRIMARY_IRQ;
+    channels[0].bm = bar4;
+    channels[1].io = ATA_SECONDARY_IO;
+    channels[1].ctrl = ATA_SECONDARY_CTRL;
+    channels[1].irq = ATA_SECONDARY_IRQ;
+    channels[1].bm = bar4 ? bar4 + BM_SECONDARY : 0;
+
+    for(i = 0; i < ATA_DRIVES; i++){
+        drive = &drives[i];
+        drive->channel = &channels[i / 2];
+        drive->slave = i % 2;
+        if(inb(drive->channel->io + ATA_REG_STATUS) == ATA_STATUS_NONE || ata_identify(drive) == -1){
+            continue;
+        }
+        drive->present = 1;
+        drive->use_dma = (drive->channel->bm != 0 && (identify_buf[ATA_ID_CAPS] & ATA_ID_CAPS_DMA));
+        drive->dev.name[0] = 'h';
+        drive->dev.name[1] = 'd';
+        drive->dev.name[2] = 'a' + i;
+        drive->dev.name[3] = '\0';
+        drive->dev.sectors = identify_buf[ATA_ID_LBA_SECTORS] | (identify_buf[ATA_ID_LBA_SECTORS + 1] << 16);
+        drive->dev.max_sectors = ATA_MAX_SECTORS;
+        drive->dev.read = ata_read;
+        drive->dev.write = ata_write;
+        drive->dev.start_read = ata_start_read;
+        drive->dev.poll = ata_poll_dev;
+        drive->dev.data = drive;
+        register_block_dev(&drive->dev);
+    }
+
+    for(i = 0; i < ATA_CHANNELS; i++){
+        outb(0, channels[i].ctrl);      //clear nIEN so the drives raise interrupts
+        enable_irq(channels[i].irq);
+    }
+}
+
+/* ata_set_dma
+ * Description: choose DMA or PIO for a drive, e.g. to compare the two
+ * Input: dev: block device of an ATA drive
+ *        use_dma: 1 for DMA, which only takes effect if the controller supports it
+ * Output: none
+*/
+void ata_set_dma (block_dev_t* dev, uint32_t use_dma){
+    ata_drive_t* drive = dev->data;
+    drive->use_dma = use_dma && drive->channel->bm != 0;
+}
+
+/* ata_irq
+ * Description: complete a channel's DMA transfer if the bus master says it is over,
+ *              otherwise just acknowledge the drive
+ * Input: chan: the channel
+ * Output: none
+*/
+static void ata_irq(ata_channel_t* chan){
+    if(chan->current != NULL && !(inb(chan->bm + BM_REG_STATUS) & (BM_STATUS_IRQ | BM_STATUS_ERR))){
+        return;     //raised before the transfer finished, wait for the real one
+    }
+    ata_complete(chan);
+}
+
+/* ata_primary_handler
+ * Description: IRQ 14: complete the primary channel's transfer
+ * Input: none
+ * Output: none
+*/
+void ata_primary_handler (){
+    irq_counts[ATA_PRIMARY_IRQ]++;
+    ata_irq(&channels[0]);
+    send_eoi(ATA_PRIMARY_IRQ);
+}
+
+/* ata_secondary_handler
+ * Description: IRQ 15: complete the secondary channel's transfer
+ * Input: none
+ * Output: none
+*/
+void ata_secondary_handler (){
+    irq_counts[ATA_SECONDARY_IRQ]++;
+    ata_irq(&channels[1]);
+    send_eoi(ATA_SECONDARY_IRQ);
+}
@@ -0,0 +1,113 @@
+/* ata.h - ATA (IDE) disk driver with PIO and bus master DMA
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+#include "blkdev.h"
+
+#define ATA_PRIMARY_IO      0x1F0
+#define ATA_PRIMARY_CTRL    0x3F6
+#define ATA_PRIMARY_IRQ     14
+#define ATA_SECONDARY_IO    0x170
+#define ATA_SECONDARY_CTRL  0x376
+#define ATA_SECONDARY_IRQ   15
+#define ATA_CHANNELS        2
+#define ATA_DRIVES          4       // master and slave on each channel
+
+/* task file registers, offsets from the channel's I/O base */
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_COUNT       2
+#define ATA_REG_LBA0        3
+#define ATA_REG_LBA1        4
+#define ATA_REG_LBA2        5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7       // reads status, writes command
+
+#define ATA_STATUS_ERR      0x01
+#define ATA_STATUS_DRQ      0x08
+#define ATA_STATUS_DF       0x20
+#define ATA_STATUS_BSY      0x80
+#define ATA_STATUS_NONE     0xFF    // floating bus: no controller
+
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30
+#define ATA_CMD_READ_DMA    0xC8
+#define ATA_CMD_WRITE_DMA   0xCA
+#define ATA_CMD_FLUSH       0xE7
+#define ATA_CMD_IDENTIFY    0xEC
+
+#define ATA_DRIVE_LBA       0xE0    // drive register: LBA mode, bit 4 picks the slave
+#define ATA_CTRL_NIEN       0x02    // control register: mask the drive's interrupt
+#define ATA_IDENTIFY_WORDS  256
+#define ATA_ID_CAPS         49      // identify word: bit 8 means DMA is supported
+#define ATA_ID_CAPS_DMA     0x0100
+#define ATA_ID_LBA_SECTORS  60      // identify words 60-61: LBA28 capacity
+#define ATA_MAX_SECTORS     128     // sectors per request (64KB)
+#define ATA_TIMEOUT         0x1000000   // status polls before a request is abandoned
+
+/* bus master IDE registers, offsets from the channel's base in BAR4 */
+#define BM_SECONDARY        8       // the secondary channel's registers follow the primary's
+#define BM_REG_CMD          0
+#define BM_REG_STATUS       2
+#define BM_REG_PRDT         4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08    // transfer from the disk into memory
+#define BM_STATUS_ACTIVE    0x01
+#define BM_STATUS_ERR       0x02
+#define BM_STATUS_IRQ       0x04
+#define PRD_EOT             0x8000  // last entry of the table
+#define PRD_MAX_BYTES       0x10000 // an entry cannot cross a 64KB boundary
+#define ATA_PRD_ENTRIES     BLK_MAX_PAGES   // a start_read page each; contiguous buffers need at most 3
+
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+
+/* one entry of a bus master physical region descriptor table */
+typedef struct prd {
+    uint32_t addr;
+    uint16_t count;                 //0 means 64KB
+    uint16_t flags;
+} __attribute__((packed)) prd_t;
+
+/* a DMA transfer in flight, owned by the process waiting for it, or by the channel
+   for a start_read, which has a callback instead of a waiter */
+typedef struct ata_request {
+    volatile uint32_t done;
+    uint8_t status;                 //task file status after completion
+    uint8_t bm_status;              //bus master status after completion
+    blk_done_t callback;            //NULL when a process waits for done
+    void* arg;
+} ata_request_t;
+
+/* an IDE channel: one transfer at a time for its two drives */
+typedef struct ata_channel {
+    prd_t prdt[ATA_PRD_ENTRIES];    //first, so the table gets the struct's alignment
+    uint16_t io;
+    uint16_t ctrl;
+    uint16_t bm;                    //bus master base, 0 without DMA
+    uint32_t irq;
+    ata_request_t* volatile current;    //NULL when the channel is idle
+    ata_request_t async;            //the request of a start_read
+} __attribute__((aligned (128))) ata_channel_t;   //keeps the table within one 64KB region
+
+typedef struct ata_drive {
+    ata_channel_t* channel;
+    uint32_t slave;
+    uint32_t present;
+    uint32_t use_dma;               //transfer by DMA, otherwise by PIO
+    block_dev_t dev;
+} ata_drive_t;
+
+extern void ata_init ();
+
+extern void ata_set_dma (block_dev_t* dev, uint32_t use_dma);
+
+extern void ata_primary_handler ();
+
+extern void ata_secondary_handler ();
+
+#endif /* _ATA_H */
@@ -0,0 +1,472 @@
+/* bcache.c - buffer cache of disk blocks with LRU eviction and readahead
+ * vim:ts=4 noexpandtab
+ *
+ * Blocks are found through a hash table keyed on (device, block). A buffer nobody holds
+ * sits on one LRU list, least recently released first, and a miss takes the buffer at
+ * its head. Readers that walk a device block by block are tracked as streams; once a
+ * stream is sequential, the blocks ahead of it are read with one start_read that the
+ * reader does not wait for, and the window doubles up to BCACHE_RA_MAX each time the
+ * reader gets within half a window of its end.
+ *
+ * Everything here runs with interrupts off, since the disk interrupt completes reads.
+ * A read that is in flight marks its buffers BUF_BUSY; a reader that wants one spins
+ * until the interrupt clears it, polling the device if it has interrupts off itself.
+ * Devices without start_read are read synchronously with interrupts off, so nobody ever
+ * sees their buffers busy.
+*/
+
+#include "bcache.h"
+#include "lib.h"
+#include "buddy.h"
+
+bcache_stats_t bcache_stats;
+
+static buf_t bufs[BCACHE_BUFFERS];
+static buf_t* hash_heads[BCACHE_HASH_SIZE];
+static buf_t lru;                   //list head: lru_next is the least recently used buffer
+static ra_stream_t streams[BCACHE_STREAMS];
+static uint32_t stream_clock;
+
+/* hash_index
+ * Description: bucket of a block
+ * Input: dev: the device
+ *        block: block number
+ * Output: index into hash_heads
+*/
+static uint32_t hash_index(block_dev_t* dev, uint32_t block){
+    return (block ^ ((uint32_t)dev >> 4)) & (BCACHE_HASH_SIZE - 1);
+}
+
+/* lru_remove
+ * Description: take a buffer off the LRU list
+ * Input: b: a buffer on the list
+ * Output: none
+*/
+static void lru_remove(buf_t* b){
+    b->lru_prev->lru_next = b->lru_next;
+    b->lru_next->lru_prev = b->lru_prev;
+}
+
+/* lru_insert
+ * Description: put a buffer on the LRU list
+ * Input: b: a buffer not on the list
+ *        recent: 1 to make it the last one evicted, 0 for the first (a buffer with no data)
+ * Output: none
+*/
+static void lru_insert(buf_t* b, uint32_t recent){
+    buf_t* prev = recent ? lru.lru_prev : &lru;
+
+    b->lru_prev = prev;
+    b->lru_next = prev->lru_next;
+    prev->lru_next->lru_prev = b;
+    prev->lru_next = b;
+}
+
+/* lookup
+ * Description: find a block in the hash table
+ * Input: dev: the device
+ *        block: block number
+ * Output: the buffer, NULL if the block is not cached
+*/
+static buf_t* lookup(block_dev_t* dev, uint32_t block){
+    buf_t* b;
+
+    for(b = hash_heads[hash_index(dev, block)]; b != NULL; b = b->hash_next){
+        if(b->dev == dev && b->block == block){
+            return b;
+        }
+    }
+    return NULL;
+}
+
+/* hash_remove
+ * Description: take a buffer out of the hash table, after which it holds no block
+ * Input: b: a hashed buffer
+ * Output: none
+*/
+static void hash_remove(buf_t* b){
+    buf_t** link = &hash_heads[hash_index(b->dev, b->block)];
+
+    while(*link != b){
+        link = &(*link)->hash_next;
+    }
+    *link = b->hash_next;
+    b->hash_next = NULL;
+    b->flags = 0;
+}
+
+/* alloc_buf
+ * Description: take the least recently used buffer for a block that is not cached
+ * Input: dev: the device
+ *        block: block number
+ * Output: the buffer, hashed with no flags or references; NULL if every buffer is held
+*/
+static buf_t* alloc_buf(block_dev_t* dev, uint32_t block){
+    buf_t* b = lru.lru_next;
+    uint32_t index;
+
+    if(b == &lru){
+        return NULL;
+    }
+    lru_remove(b);
+    if(b->flags & BUF_VALID){
+        hash_remove(b);
+        bcache_stats.evictions++;
+    }
+    b->dev = dev;
+    b->block = block;
+    b->refs = 0;
+    b->io_next = NULL;
+    index = hash_index(dev, block);
+    b->hash_next = hash_heads[index];
+    hash_heads[index] = b;
+    return b;
+}
+
+/* bcache_done
+ * Description: blk_done_t for the cache's reads: mark the buffers of a read valid, or
+ *              drop them if it failed, and list the ones nobody waits for
+ * Input: arg: first buffer of the read, linked through io_next
+ *        status: 0 for success, -1 for fail
+ * Output: none
+*/
+static void bcache_done(void* arg, int32_t status){
+    buf_t* b = arg;
+    buf_t* next;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for(; b != NULL; b = next){
+        next = b->io_next;
+        b->io_next = NULL;
+        if(status == 0){
+            b->flags = (b->flags & ~BUF_BUSY) | BUF_VALID;
+        }else{
+            hash_remove(b);
+        }
+        if(b->refs == 0){
+            lru_insert(b, status == 0);
+        }
+    }
+    restore_flags(flags);
+}
+
+/* readahead
+ * Description: start reading the blocks of a range that are not cached yet, without
+ *              waiting; stops at the first cached block after the start of the range
+ * Input: dev: the device, with interrupts off
+ *        first: first block
+ *        count: number of blocks
+ * Output: blocks of the range dealt with (already cached or now being read), 0 if the
+ *         device cannot read ahead or is busy
+*/
+static uint32_t readahead(block_dev_t* dev, uint32_t first, uint32_t count){
+    uint8_t* pages[BCACHE_RA_MAX];
+    buf_t* chain = NULL;
+    buf_t** tail = &chain;
+    buf_t* b;
+    uint32_t skipped, n;
+    uint32_t dev_blocks = dev->sectors / BCACHE_SECTORS;
+
+    if(dev->start_read == NULL || first >= dev_blocks){
+        return 0;
+    }
+    if(count > dev_blocks - first){
+        count = dev_blocks - first;
+    }
+    if(count > dev->max_sectors / BCACHE_SECTORS){
+        count = dev->max_sectors / BCACHE_SECTORS;
+    }
+    for(skipped = 0; skipped < count && lookup(dev, first + skipped) != NULL; skipped++);
+    for(n = 0; skipped + n < count && lookup(dev, first + skipped + n) == NULL; n++){
+        if((b = alloc_buf(dev, first + skipped + n)) == NULL){
+            break;
+        }
+        b->flags = BUF_BUSY | BUF_READAHEAD;
+        pages[n] = b->data;
+        *tail = b;
+        tail = &b->io_next;
+    }
+    if(n == 0){
+        return skipped;
+    }
+    if(blk_start_read(dev, (first + skipped) * BCACHE_SECTORS, n, pages, bcache_done, chain) == -1){
+        for(b = chain; b != NULL; b = chain){
+            chain = b->io_next;
+            b->io_next = NULL;
+            hash_remove(b);
+            lru_insert(b, 0);
+        }
+        return 0;
+    }
+    bcache_stats.ra_blocks += n;
+    return skipped + n;
+}
+
+/* advance_stream
+ * Description: note a read of a block, and read ahead if it continues a sequential stream
+ *              that is close to the end of what was read ahead for it
+ * Input: dev: the device, with interrupts off
+ *        block: block just read
+ * Output: none
+*/
+static void advance_stream(block_dev_t* dev, uint32_t block){
+    ra_stream_t* s = NULL;
+    uint32_t i, done;
+
+    for(i = 0; i < BCACHE_STREAMS; i++){
+        if(streams[i].dev == dev && (streams[i].next == block || streams[i].next == block + 1)){
+            s = &streams[i];
+            break;
+        }
+    }
+    if(s == NULL){      //a new reader takes the slot used longest ago
+        s = &streams[0];
+        for(i = 1; i < BCACHE_STREAMS; i++){
+            if(streams[i].last_use < s->last_use){
+                s = &streams[i];
+            }
+        }
+        s->dev = dev;
+        s->next = block + 1;
+        s->ra_end = block + 1;
+        s->window = BCACHE_RA_MIN;
+        s->last_use = ++stream_clock;
+        return;
+    }
+    s->last_use = ++stream_clock;
+    if(s->next == block + 1){
+        return;         //another read within the same block
+    }
+    s->next = block + 1;
+    if(s->ra_end < s->next){
+        s->ra_end = s->next;
+    }
+    if(s->ra_end - s->next > s->window / 2){
+        return;         //still well ahead of the reader
+    }
+    done = readahead(dev, s->ra_end, s->window);
+    s->ra_end += done;
+    if(done > 0 && s->window < BCACHE_RA_MAX){
+        s->window *= 2;
+    }
+}
+
+/* get_block
+ * Description: get a block, reading it from the disk on a miss unless the caller is
+ *              about to overwrite it
+ * Input: dev: the device
+ *        block: block number
+ *        read: 0 to take a zeroed buffer on a miss instead of reading the disk
+ * Output: the buffer, held until bcache_release; NULL if the block is past the end of
+ *         the device, the read failed or every buffer is held
+*/
+static buf_t* get_block(block_dev_t* dev, uint32_t block, uint32_t read){
+    uint8_t* pages[1];
+    buf_t* b;
+    uint32_t flags;
+    int32_t status;
+
+    if(dev == NULL || block >= dev->sectors / BCACHE_SECTORS || dev->max_sectors < BCACHE_SECTORS){
+        return NULL;
+    }
+    cli_and_save(flags);
+    if(lru.lru_next == NULL){
+        restore_flags(flags);
+        return NULL;    //bcache_init failed
+    }
+    if((b = lookup(dev, block)) != NULL){
+        if(b->refs == 0 && !(b->flags & BUF_BUSY)){
+            lru_remove(b);
+        }
+        b->refs++;
+        if(b->flags & BUF_READAHEAD){
+            b->flags &= ~BUF_READAHEAD;
+            bcache_stats.ra_hits++;
+        }
+        if(b->flags & BUF_BUSY){
+            bcache_stats.waits++;
+        }else{
+            bcache_stats.hits++;
+        }
+    }else{
+        if((b = alloc_buf(dev, block)) == NULL){
+            restore_flags(flags);
+            return NULL;
+        }
+        b->refs = 1;
+        if(!read){
+            memset(b->data, 0, BCACHE_BLOCK_SIZE);
+            b->flags = BUF_VALID;
+            restore_flags(flags);
+            return b;
+        }
+        bcache_stats.misses++;
+        b->flags = BUF_BUSY;
+        if(dev->start_read == NULL){
+            status = blk_read(dev, block * BCACHE_SECTORS, BCACHE_SECTORS, b->data);
+            bcache_done(b, status);
+        }else{
+            restore_flags(flags);
+            pages[0] = b->data;
+            while(blk_start_read(dev, block * BCACHE_SECTORS, 1, pages, bcache_done, b) == -1){
+                if(dev->poll != NULL){
+                    dev->poll(dev);     //busy with another transfer, which may need us to finish it
+                }
+            }
+            cli_and_save(flags);
+        }
+    }
+    restore_flags(flags);
+
+    while(b->flags & BUF_BUSY){
+        if(dev->poll != NULL){
+            dev->poll(dev);
+        }
+    }
+    if(!(b->flags & BUF_VALID)){
+        bcache_release(b);
+        return NULL;
+    }
+
+    if(read){
+        cli_and_save(flags);
+        advance_stream(dev, block);
+        restore_flags(flags);
+    }
+    return b;
+}
+
+/* bcache_init
+ * Description: take the buffers' memory from the buddy allocator, one frame each, and put
+ *              every buffer on the LRU list
+ * Input: none
+ * Output: 0 for success, -1 if memory is out, which leaves every read failing
+*/
+int32_t bcache_init (){
+    uint32_t i, data;
+
+    if(lru.lru_next != NULL){
+        return 0;
+    }
+    if((data = buddy_alloc(BCACHE_ORDER)) == 0){
+        return -1;
+    }
+    lru.lru_next = &lru;
+    lru.lru_prev = &lru;
+    for(i = 0; i < BCACHE_BUFFERS; i++){
+        bufs[i].data = (uint8_t*)(data + i * BCACHE_BLOCK_SIZE);
+        lru_insert(&bufs[i], 1);
+    }
+    return 0;
+}
+
+/* bcache_read
+ * Description: get a block with its data, reading it from the disk on a miss
+ * Input: dev: the device
+ *        block: block number, in BCACHE_BLOCK_SIZE units
+ * Output: the buffer, held until bcache_release; NULL if the block is past the end of
+ *         the device, the read failed or every buffer is held
+*/
+buf_t* bcache_read (block_dev_t* dev, uint32_t block){
+    return get_block(dev, block, 1);
+}
+
+/* bcache_release
+ * Description: give back a buffer from bcache_read
+ * Input: b: the buffer
+ * Output: none
+*/
+void bcache_release (buf_t* b){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(--b->refs == 0 && !(b->flags & BUF_BUSY)){
+        lru_insert(b, (b->flags & BUF_VALID) != 0);     //a failed read already left the hash table
+    }
+    restore_flags(flags);
+}
+
+/* bcache_pin
+ * Description: get a block and keep it cached until bcache_unpin, e.g. for metadata or
+ *              for blocks whose only copy of new data is the buffer
+ * Input: dev: the device
+ *        block: block number
+ *        read: 0 for a block about to be overwritten, which is not read from the disk
+ * Output: the buffer, NULL if the read failed or pins already hold all but
+ *         BCACHE_RESERVE buffers
+*/
+buf_t* bcache_pin (block_dev_t* dev, uint32_t block, uint32_t read){
+    buf_t* b;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(bcache_stats.pinned >= BCACHE_BUFFERS - BCACHE_RESERVE){
+        restore_flags(flags);
+        return NULL;
+    }
+    bcache_stats.pinned++;
+    restore_flags(flags);
+    if((b = get_block(dev, block, read)) == NULL){
+        cli_and_save(flags);
+        bcache_stats.pinned--;
+        restore_flags(flags);
+    }
+    return b;
+}
+
+/* bcache_unpin
+ * Description: let a pinned buffer be evicted again
+ * Input: b: buffer from bcache_pin
+ * Output: none
+*/
+void bcache_unpin (buf_t* b){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    bcache_stats.pinned--;
+    restore_flags(flags);
+    bcache_release(b);
+}
+
+/* bcache_invalidate
+ * Description: forget the cached blocks of a device nobody holds, so the next reads
+ *              see the disk again, and its readahead streams
+ * Input: dev: the device
+ * Output: none
+*/
+void bcache_invalidate (block_dev_t* dev){
+    uint32_t i, flags;
+
+    cli_and_save(flags);
+    for(i = 0; i < BCACHE_BUFFERS; i++){
+        if(bufs[i].dev == dev && bufs[i].refs == 0 && (bufs[i].flags & BUF_VALID)){
+            hash_remove(&bufs[i]);
+            lru_remove(&bufs[i]);
+            lru_insert(&bufs[i], 0);
+        }
+    }
+    for(i = 0; i < BCACHE_STREAMS; i++){
+        if(streams[i].dev == dev){
+            streams[i].dev = NULL;
+        }
+    }
+    restore_flags(flags);
+}
+
+/* bcache_cached
+ * Description: count the buffers that hold a block
+ * Input: none
+ * Output: number of valid buffers
+*/
+uint32_t bcache_cached (){
+    uint32_t i, flags;
+    uint32_t count = 0;
+
+    cli_and_save(flags);
+    for(i = 0; i < BCACHE_BUFFERS; i++){
+        count += (bufs[i].flags & BUF_VALID) != 0;
+    }
+    restore_flags(flags);
+    return count;
+}
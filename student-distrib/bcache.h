@@ -0,0 +1,73 @@
+/* bcache.h - buffer cache of disk blocks with LRU eviction and readahead
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include "types.h"
+#include "blkdev.h"
+
+#define BCACHE_BLOCK_SIZE   BLK_PAGE_SIZE
+#define BCACHE_SECTORS      BLK_PAGE_SECTORS
+#define BCACHE_BUFFERS      256     // 1MB of cached blocks
+#define BCACHE_ORDER        8       // buddy order of one block holding every buffer
+#define BCACHE_HASH_SIZE    128     // buckets, a power of two
+#define BCACHE_RESERVE      32      // buffers pins cannot take, so reads always find one
+#define BCACHE_STREAMS      4       // sequential readers tracked at once
+#define BCACHE_RA_MIN       2       // first readahead window, in blocks
+#define BCACHE_RA_MAX       BLK_MAX_PAGES
+
+#define BUF_VALID           0x1     // data matches the disk (or a pinned write)
+#define BUF_BUSY            0x2     // a read into the buffer is in flight
+#define BUF_READAHEAD       0x4     // read ahead and not asked for yet
+
+/* one cached block; a buffer with no references is on the LRU list */
+typedef struct buf {
+    block_dev_t* dev;
+    uint32_t block;                 //device block number, in BCACHE_BLOCK_SIZE units
+    volatile uint32_t flags;        //changed by the disk interrupt
+    uint32_t refs;
+    struct buf* hash_next;
+    struct buf* lru_prev;
+    struct buf* lru_next;
+    struct buf* io_next;            //next buffer of the same read
+    uint8_t* data;
+} buf_t;
+
+/* a reader walking a device block by block */
+typedef struct ra_stream {
+    block_dev_t* dev;               //NULL for an unused slot
+    uint32_t next;                  //block a sequential reader asks for next
+    uint32_t ra_end;                //first block not read ahead yet
+    uint32_t window;                //blocks read ahead at a time
+    uint32_t last_use;
+} ra_stream_t;
+
+typedef struct bcache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t waits;                 //hits on a block still being read
+    uint32_t ra_blocks;             //blocks read ahead
+    uint32_t ra_hits;               //read ahead blocks that were then asked for
+    uint32_t evictions;
+    uint32_t pinned;
+} bcache_stats_t;
+
+extern bcache_stats_t bcache_stats;
+
+extern int32_t bcache_init ();
+
+extern buf_t* bcache_read (block_dev_t* dev, uint32_t block);
+
+extern void bcache_release (buf_t* b);
+
+extern buf_t* bcache_pin (block_dev_t* dev, uint32_t block, uint32_t read);
+
+extern void bcache_unpin (buf_t* b);
+
+extern void bcache_invalidate (block_dev_t* dev);
+
+extern uint32_t bcache_cached ();
+
+#endif /* _BCACHE_H */
@@ -0,0 +1,133 @@
+/* blkdev.c - block device registry and sector I/O
+ * vim:ts=4 noexpandtab
+ */
+
+#include "blkdev.h"
+#include "lib.h"
+
+static block_dev_t* block_devs[MAX_BLOCK_DEVS];
+static uint32_t num_block_devs;
+
+/* register_block_dev
+ * Description: make a disk available to find_block_dev and the filesystems
+ * Input: dev: the device, filled in by its driver
+ * Output: 0 for success, -1 if the table is full or the name is taken
+*/
+int32_t register_block_dev (block_dev_t* dev){
+    if(num_block_devs == MAX_BLOCK_DEVS || find_block_dev(dev->name) != NULL){
+        return -1;
+    }
+    dev->reads = 0;
+    dev->writes = 0;
+    dev->sectors_read = 0;
+    dev->sectors_written = 0;
+    block_devs[num_block_devs++] = dev;
+    return 0;
+}
+
+/* find_block_dev
+ * Description: look a disk up by name, e.g. "hdb"
+ * Input: name: device name
+ * Output: the device, NULL if there is none
+*/
+block_dev_t* find_block_dev (const int8_t* name){
+    uint32_t i;
+    for(i = 0; i < num_block_devs; i++){
+        if(strncmp(block_devs[i]->name, name, BLOCK_DEV_NAME_LEN) == 0){
+            return block_devs[i];
+        }
+    }
+    return NULL;
+}
+
+/* block_dev_at
+ * Description: walk the registered disks in registration order
+ * Input: index: 0 for the first disk
+ * Output: the device, NULL past the last one
+*/
+block_dev_t* block_dev_at (uint32_t index){
+    return (index < num_block_devs) ? block_devs[index] : NULL;
+}
+
+/* blk_read
+ * Description: read sectors, split into transfers the driver can take
+ * Input: dev: the disk
+ *        lba: first sector
+ *        count: number of sectors
+ *        buf: count * SECTOR_SIZE bytes of kernel memory
+ * Output: 0 for success, -1 if the range is past the end of the disk or the driver fails
+*/
+int32_t blk_read (block_dev_t* dev, uint32_t lba, uint32_t count, void* buf){
+    uint32_t chunk;
+
+    if(dev == NULL || buf == NULL || lba + count < lba || lba + count > dev->sectors){
+        return -1;
+    }
+    dev->reads++;
+    while(count > 0){
+        chunk = (count < dev->max_sectors) ? count : dev->max_sectors;
+        if(dev->read(dev, lba, chunk, buf) == -1){
+            return -1;
+        }
+        dev->sectors_read += chunk;
+        lba += chunk;
+        count -= chunk;
+        buf = (uint8_t*)buf + chunk * SECTOR_SIZE;
+    }
+    return 0;
+}
+
+/* blk_start_read
+ * Description: begin reading whole pages without waiting for the data
+ * Input: dev: the disk
+ *        lba: first sector
+ *        pages: number of pages, at most BLK_MAX_PAGES
+ *        page_bufs: one BLK_PAGE_SIZE aligned buffer per page, only used during the call
+ *        done: called with arg once the data is in or the read failed
+ *        arg: passed to done
+ * Output: 0 if the read was started (done will be called), -1 if the device cannot
+ *         take it now or the range is bad (done will not be called)
+*/
+int32_t blk_start_read (block_dev_t* dev, uint32_t lba, uint32_t pages, uint8_t* const* page_bufs,
+                        blk_done_t done, void* arg){
+    uint32_t count = pages * BLK_PAGE_SECTORS;
+
+    if(dev == NULL || dev->start_read == NULL || pages == 0 || pages > BLK_MAX_PAGES ||
+       count > dev->max_sectors || lba + count < lba || lba + count > dev->sectors){
+        return -1;
+    }
+    if(dev->start_read(dev, lba, pages, page_bufs, done, arg) == -1){
+        return -1;
+    }
+    dev->reads++;
+    dev->sectors_read += count;
+    return 0;
+}
+
+/* blk_write
+ * Description: write sectors, split into transfers the driver can take
+ * Input: dev: the disk
+ *        lba: first sector
+ *        count: number of sectors
+ *        buf: count * SECTOR_SIZE bytes of kernel memory
+ * Output: 0 for success, -1 if the range is past the end of the disk or the driver fails
+*/
+int32_t blk_write (block_dev_t* dev, uint32_t lba, uint32_t count, const void* buf){
+    uint32_t chunk;
+
+    if(dev == NULL || buf == NULL || dev->write == NULL || lba + count < lba || lba + count > dev->sectors){
+        return -1;
+    }
+    dev->writes++;
+    while(count > 0){
+        chunk = (count < dev->max_sectors) ? count : dev->max_sectors;
+        if(dev->write(dev, lba, chunk, buf) == -1){
+            return -1;
+        }
+        dev->sectors_written += chunk;
+        lba += chunk;
+        count -= chunk;
+        buf = (const uint8_t*)buf + chunk * SECTOR_SIZE;
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+/* blkdev.h - block device registry and sector I/O
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BLKDEV_H
+#define _BLKDEV_H
+
+#include "types.h"
+
+#define SECTOR_SIZE         512
+#define MAX_BLOCK_DEVS      8
+#define BLOCK_DEV_NAME_LEN  8
+#define BLK_PAGE_SIZE       4096    // unit of start_read's buffers
+#define BLK_PAGE_SECTORS    (BLK_PAGE_SIZE / SECTOR_SIZE)
+#define BLK_MAX_PAGES       16      // most pages one start_read takes
+
+/* called when a start_read finishes, possibly from an interrupt handler;
+   status is 0 for success, -1 for fail */
+typedef void (*blk_done_t) (void* arg, int32_t status);
+
+/* a disk as drivers register it; read and write move whole sectors and are never
+   handed more than max_sectors at once. start_read and poll are optional: start_read
+   begins a read into separate pages and returns without waiting, -1 if the device is
+   busy; poll completes finished transfers for callers that have interrupts off */
+typedef struct block_dev {
+    int8_t name[BLOCK_DEV_NAME_LEN];
+    uint32_t sectors;               //capacity
+    uint32_t max_sectors;           //largest single transfer the driver takes
+    int32_t (*read) (struct block_dev* dev, uint32_t lba, uint32_t count, void* buf);
+    int32_t (*write) (struct block_dev* dev, uint32_t lba, uint32_t count, const void* buf);
+    int32_t (*start_read) (struct block_dev* dev, uint32_t lba, uint32_t pages, uint8_t* const* page_bufs,
+                           blk_done_t done, void* arg);
+    void (*poll) (struct block_dev* dev);
+    void* data;                     //private to the driver
+    uint32_t reads;                 //requests and sectors since boot
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+} block_dev_t;
+
+extern int32_t register_block_dev (block_dev_t* dev);
+
+extern block_dev_t* find_block_dev (const int8_t* name);
+
+extern block_dev_t* block_dev_at (uint32_t index);
+
+extern int32_t blk_read (block_dev_t* dev, uint32_t lba, uint32_t count, void* buf);
+
+extern int32_t blk_start_read (block_dev_t* dev, uint32_t lba, uint32_t pages, uint8_t* const* page_bufs,
+                               blk_done_t done, void* arg);
+
+extern int32_t blk_write (block_dev_t* dev, uint32_t lba, uint32_t count, const void* buf);
+
+#endif /* _BLKDEV_H */
@@ -0,0 +1,219 @@
+/* buddy.c - buddy allocator of physical page frames
+ * vim:ts=4 noexpandtab
+ *
+ * Free memory is kept as blocks of 2^order frames, each aligned to its own size, on one
+ * free list per order. An allocation takes a block from the smallest order that has one
+ * and splits it down, putting the unused halves back; a free merges the block with its
+ * buddy (the other half of the block one order up) for as long as that buddy is free.
+ * Both walk at most BUDDY_ORDERS lists, so they are O(log n) in the size of memory.
+ *
+ * The lists are linked through arrays indexed by frame rather than through the free
+ * frames themselves, so the allocator never touches memory the kernel has not mapped.
+ * buddy_init frees every RAM frame of the multiboot memory map between BUDDY_MIN_ADDR
+ * and BUDDY_MAX_ADDR, except those holding boot modules, and the frees merge them into
+ * blocks as large as their alignment allows.
+*/
+
+#include "buddy.h"
+#include "lib.h"
+
+buddy_stats_t buddy_stats;
+
+static uint16_t free_head[BUDDY_ORDERS];
+static uint16_t free_next[BUDDY_FRAMES];
+static uint16_t free_prev[BUDDY_FRAMES];
+static uint8_t free_order[BUDDY_FRAMES];    //order of the free block a frame heads, or BUDDY_NOT_FREE
+
+/* list_push
+ * Description: put a free block on the list of its order
+ * Input: frame: first frame of the block
+ *        order: order of the block
+ * Output: none
+*/
+static void list_push(uint32_t frame, uint32_t order){
+    free_prev[frame] = BUDDY_NONE;
+    free_next[frame] = free_head[order];
+    if(free_head[order] != BUDDY_NONE){
+        free_prev[free_head[order]] = frame;
+    }
+    free_head[order] = frame;
+    free_order[frame] = order;
+    buddy_stats.free_blocks[order]++;
+}
+
+/* list_remove
+ * Description: take a free block off its list
+ * Input: frame: first frame of the block
+ * Output: none
+*/
+static void list_remove(uint32_t frame){
+    uint32_t order = free_order[frame];
+
+    if(free_prev[frame] != BUDDY_NONE){
+        free_next[free_prev[frame]] = free_next[frame];
+    }else{
+        free_head[order] = free_next[frame];
+    }
+    if(free_next[frame] != BUDDY_NONE){
+        free_prev[free_next[frame]] = free_prev[frame];
+    }
+    free_order[frame] = BUDDY_NOT_FREE;
+    buddy_stats.free_blocks[order]--;
+}
+
+/* free_block
+ * Description: return a block, merging it with its buddy while the buddy is free too
+ * Input: frame: first frame of the block, aligned to its size
+ *        order: order of the block
+ * Output: none
+*/
+static void free_block(uint32_t frame, uint32_t order){
+    uint32_t buddy;
+
+    buddy_stats.free_frames += 1 << order;
+    while(order < ORDER_4MB){
+        buddy = frame ^ (1 << order);
+        if(buddy >= BUDDY_FRAMES || free_order[buddy] != order){
+            break;
+        }
+        list_remove(buddy);
+        frame &= ~(1 << order);
+        order++;
+        buddy_stats.merges++;
+    }
+    list_push(frame, order);
+}
+
+/* in_module
+ * Description: check whether a frame holds part of a boot module
+ * Input: mbi: multiboot info
+ *        addr: physical address of the frame
+ * Output: 1 if it does, 0 if not
+*/
+static uint32_t in_module(multiboot_info_t* mbi, uint32_t addr){
+    module_t* mod = (module_t*)mbi->mods_addr;
+    uint32_t i;
+
+    if(!(mbi->flags & MULTIBOOT_INFO_MODS)){
+        return 0;
+    }
+    for(i = 0; i < mbi->mods_count; i++, mod++){
+        if(addr + FRAME_SIZE > mod->mod_start && addr < mod->mod_end){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* add_range
+ * Description: give the allocator the frames of a RAM range that lie in
+ *              [BUDDY_MIN_ADDR, BUDDY_MAX_ADDR) and hold no boot module
+ * Input: mbi: multiboot info
+ *        start: first byte of the range
+ *        end: byte after the range
+ * Output: none
+*/
+static void add_range(multiboot_info_t* mbi, uint32_t start, uint32_t end){
+    uint32_t addr;
+
+    if(end < start){
+        end = BUDDY_MAX_ADDR;   //the range runs past 4GB
+    }
+    if(start < BUDDY_MIN_ADDR){
+        start = BUDDY_MIN_ADDR;
+    }
+    if(end > BUDDY_MAX_ADDR){
+        end = BUDDY_MAX_ADDR;
+    }
+    start = (start + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+    end &= ~(FRAME_SIZE - 1);
+    for(addr = start; addr < end; addr += FRAME_SIZE){
+        if(!in_module(mbi, addr) && free_order[addr >> FRAME_SHIFT] == BUDDY_NOT_FREE){
+            free_block(addr >> FRAME_SHIFT, ORDER_4KB);
+            buddy_stats.total_frames++;
+        }
+    }
+}
+
+/* buddy_init
+ * Description: seed the allocator from the multiboot memory map, or from mem_upper if
+ *              the boot loader gave no map
+ * Input: mbi: multiboot info
+ * Output: none
+*/
+void buddy_init (multiboot_info_t* mbi){
+    memory_map_t* mmap;
+    uint32_t i;
+
+    for(i = 0; i < BUDDY_ORDERS; i++){
+        free_head[i] = BUDDY_NONE;
+    }
+    memset(free_order, BUDDY_NOT_FREE, sizeof(free_order));
+
+    if(mbi->flags & MULTIBOOT_INFO_MEM_MAP){
+        for(mmap = (memory_map_t*)mbi->mmap_addr;
+            (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+            mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+            if(mmap->type == MMAP_TYPE_RAM && mmap->base_addr_high == 0){
+                add_range(mbi, mmap->base_addr_low, mmap->base_addr_low + mmap->length_low);
+            }
+        }
+    }else if(mbi->flags & MULTIBOOT_INFO_MEMORY){
+        add_range(mbi, MEM_UPPER_BASE, MEM_UPPER_BASE + mbi->mem_upper * 1024);
+    }
+}
+
+/* buddy_alloc
+ * Description: allocate a block of 2^order frames aligned to its size
+ * Input: order: ORDER_4KB for one frame, ORDER_4MB for a large page, or any in between
+ * Output: physical address of the block, 0 if no block is free
+*/
+uint32_t buddy_alloc (uint32_t order){
+    uint32_t frame, curr, flags;
+
+    if(order >= BUDDY_ORDERS){
+        return 0;
+    }
+    cli_and_save(flags);
+    for(curr = order; curr < BUDDY_ORDERS && free_head[curr] == BUDDY_NONE; curr++);
+    if(curr == BUDDY_ORDERS){
+        buddy_stats.failures++;
+        restore_flags(flags);
+        return 0;
+    }
+    frame = free_head[curr];
+    list_remove(frame);
+    while(curr > order){
+        curr--;
+        list_push(frame + (1 << curr), curr);  //upper half stays free
+        buddy_stats.splits++;
+    }
+    buddy_stats.free_frames -= 1 << order;
+    buddy_stats.allocs[order]++;
+    restore_flags(flags);
+    return frame << FRAME_SHIFT;
+}
+
+/* buddy_free
+ * Description: free a block from buddy_alloc
+ * Input: addr: physical address buddy_alloc returned
+ *        order: order it was allocated with
+ * Output: none
+ * Side effect: a block that cannot have come from buddy_alloc, or whose first frame already
+ *              heads a free block, is ignored
+*/
+void buddy_free (uint32_t addr, uint32_t order){
+    uint32_t frame = addr >> FRAME_SHIFT;
+    uint32_t flags;
+
+    if(order >= BUDDY_ORDERS || addr < BUDDY_MIN_ADDR || addr >= BUDDY_MAX_ADDR ||
+       (frame & ((1 << order) - 1)) != 0){
+        return;
+    }
+    cli_and_save(flags);
+    if(free_order[frame] == BUDDY_NOT_FREE){
+        free_block(frame, order);
+        buddy_stats.frees[order]++;
+    }
+    restore_flags(flags);
+}
@@ -0,0 +1,43 @@
+/* buddy.h - buddy allocator of physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BUDDY_H
+#define _BUDDY_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE          4096
+#define FRAME_SHIFT         12
+#define BUDDY_ORDERS        11      // blocks of 4KB << 0 through 4KB << 10
+#define ORDER_4KB           0
+#define ORDER_4MB           10
+#define BUDDY_MIN_ADDR      0x800000    // below is the kernel: low memory, then its 4MB page
+#define BUDDY_MAX_ADDR      0x8000000   // from 128MB up the address space belongs to user pages
+#define BUDDY_FRAMES        (BUDDY_MAX_ADDR >> FRAME_SHIFT)
+#define BUDDY_NONE          0xFFFF      // end of a free list
+#define BUDDY_NOT_FREE      0xFF        // free_order of a frame that heads no free block
+#define MMAP_TYPE_RAM       1
+#define MEM_UPPER_BASE      0x100000    // mem_upper counts KB from 1MB
+
+typedef struct buddy_stats {
+    uint32_t total_frames;          //frames the memory map gave the allocator
+    uint32_t free_frames;
+    uint32_t free_blocks[BUDDY_ORDERS];
+    uint32_t allocs[BUDDY_ORDERS];
+    uint32_t frees[BUDDY_ORDERS];
+    uint32_t splits;
+    uint32_t merges;
+    uint32_t failures;
+} buddy_stats_t;
+
+extern buddy_stats_t buddy_stats;
+
+extern void buddy_init (multiboot_info_t* mbi);
+
+extern uint32_t buddy_alloc (uint32_t order);
+
+extern void buddy_free (uint32_t addr, uint32_t order);
+
+#endif /* _BUDDY_H */
@@ -1,87 +1,1437 @@
 #include "filesystem.h"
 #include "system_calls.h"
+#include "vfs.h"
+#include "RTC.h"
+#include "bcache.h"
+
+/* dentry index: open-addressed hash table of dentries keyed on (directory, filename) */
+static uint16_t dentry_hash[DENTRY_HASH_SIZE];
+static dentry_index_t dentry_index[MAX_INDEXED_DENTRIES];
+static uint32_t dentry_index_count;
+static uint32_t dentry_index_full;  //some dentries are not indexed, so misses must scan
+
+/* name table: the index stored in the image, used instead of dentry_hash until the
+   first change to a directory. NULL if the image has none */
+static name_table_t* name_table;
+
+/* directory walk: breadth first queue of directories and the directories already seen */
+static uint32_t dir_queue[MAX_INODES];
+static uint32_t dir_seen[MAX_INODES / BITMAP_BITS];
+
+/* extent table: contiguous block runs of every inode, built at mount */
+static extent_t extents[MAX_EXTENTS];
+static extent_map_t extent_maps[MAX_EXTENT_INODES];
+
+/* allocation bitmaps: a set bit means the data block or inode is in use */
+static uint32_t block_bitmap[MAX_DATA_BLOCKS / BITMAP_BITS];
+static uint32_t inode_bitmap[MAX_INODES / BITMAP_BITS];
+static uint32_t block_cursor;   //bitmap word where the next free block search starts
+static uint32_t inode_cursor;   //bitmap word where the next free inode search starts
+static uint32_t data_block_limit;   //number of data blocks covered by block_bitmap
+static uint32_t indirect_blocks;    //nonzero for version 2 images
+static uint8_t block_shares[MAX_DATA_BLOCKS];   //files using a block besides its first owner
+
+/* disk images: the boot block and inodes are read at mount into disk_meta, data blocks
+   through the buffer cache. Blocks the filesystem keeps pointers into (directories,
+   indirect tables, the name table) and blocks it has written are pinned there, since
+   writes are not sent to the disk; file data is only held while it is copied */
+static block_dev_t* disk_dev;           //device of the mounted disk image, NULL if none
+static block_dev_t* active_disk;        //disk_dev while the disk image is the one in use
+static uint32_t disk_first_block;       //cache block number of data block 0
+static uint8_t disk_meta[(1 + FS_DISK_MAX_INODES) * BLOCK_SIZE] __attribute__((aligned (BLOCK_SIZE)));
+static buf_t* disk_pins[MAX_DATA_BLOCKS];
+static uint32_t disk_pin_failed;        //a block could not be pinned since the last mount
+static uint8_t lost_block[BLOCK_SIZE];  //stands in for a block that could not be pinned
+
+/* compressed files: decompressed lengths, and a cache of decompressed chunks */
+static uint32_t compressed_bitmap[MAX_INODES / BITMAP_BITS];
+static uint32_t raw_lengths[MAX_INODES];
+static chunk_cache_t chunk_cache[CHUNK_CACHE_SIZE];
+static uint32_t chunk_cache_next;   //slot replaced on the next miss
+static uint8_t chunk_buf[BLOCK_SIZE];   //compressed bytes of the chunk being decoded
+
+/* bitmap_test
+ * Description: check one bit of an allocation bitmap
+ * Input: bitmap: bitmap to check
+ *        n: bit number
+ * Output: nonzero if the bit is set
+*/
+static uint32_t bitmap_test(uint32_t* bitmap, uint32_t n){
+    return bitmap[n / BITMAP_BITS] & (1 << (n % BITMAP_BITS));
+}
+
+/* bitmap_set
+ * Description: mark one bit of an allocation bitmap as in use
+ * Input: bitmap: bitmap to update
+ *        n: bit number
+ * Output: none
+*/
+static void bitmap_set(uint32_t* bitmap, uint32_t n){
+    bitmap[n / BITMAP_BITS] |= (1 << (n % BITMAP_BITS));
+}
+
+/* bitmap_clear
+ * Description: mark one bit of an allocation bitmap as free
+ * Input: bitmap: bitmap to update
+ *        n: bit number
+ * Output: none
+*/
+static void bitmap_clear(uint32_t* bitmap, uint32_t n){
+    bitmap[n / BITMAP_BITS] &= ~(1 << (n % BITMAP_BITS));
+}
+
+/* max_file_blocks
+ * Description: largest number of blocks one inode can address
+ * Input: none
+ * Output: DATA_BLOCK_NUM for version 1 images, more with indirect blocks (capped so the
+ *         length still fits in inode_t.length)
+*/
+static uint32_t max_file_blocks(){
+    if(!indirect_blocks){
+        return DATA_BLOCK_NUM;
+    }
+    return 0x7FFFFFFF / BLOCK_SIZE;
+}
+
+/* pin_block
+ * Description: keep a data block of the disk image in the buffer cache until it is freed
+ * Input: block_num: data block number, below data_block_limit
+ *        read: 0 for a block about to be overwritten, whose old contents are not needed
+ * Output: 0 for success, -1 if the block could not be read or too many are pinned
+*/
+static int32_t pin_block(uint32_t block_num, uint32_t read){
+    if(disk_pins[block_num] == NULL){
+        disk_pins[block_num] = bcache_pin(active_disk, disk_first_block + block_num, read);
+    }
+    return (disk_pins[block_num] != NULL) ? 0 : -1;
+}
+
+/* unpin_block
+ * Description: let the cache evict a data block of the disk image again
+ * Input: block_num: data block number
+ * Output: none
+*/
+static void unpin_block(uint32_t block_num){
+    if(block_num < MAX_DATA_BLOCKS && disk_pins[block_num] != NULL){
+        bcache_unpin(disk_pins[block_num]);
+        disk_pins[block_num] = NULL;
+    }
+}
+
+/* unpin_all
+ * Description: unpin every data block of the disk image, before it is mounted again
+ * Input: none
+ * Output: none
+*/
+static void unpin_all(){
+    uint32_t i;
+    for(i = 0; i < MAX_DATA_BLOCKS; i++){
+        unpin_block(i);
+    }
+}
+
+/* data_block
+ * Description: find a data block in memory; for disk images the block is pinned, so
+ *              the pointer stays good, which is what directories, indirect tables and
+ *              writes need
+ * Input: block_num: data block number, below data_count
+ * Output: pointer to the block
+ * Side effect: a disk block that cannot be pinned reads as zeros and sets disk_pin_failed
+*/
+static uint8_t* data_block(uint32_t block_num){
+    if(active_disk == NULL){
+        return block_ptr + BLOCK_SIZE * block_num;
+    }
+    if(block_num < MAX_DATA_BLOCKS && pin_block(block_num, 1) == 0){
+        return disk_pins[block_num]->data;
+    }
+    disk_pin_failed = 1;
+    memset(lost_block, 0, BLOCK_SIZE);
+    return lost_block;
+}
+
+/* hold_block
+ * Description: get a data block to read file data from, without pinning it
+ * Input: block_num: data block number, below data_count
+ *        held: set to the buffer to pass to drop_block, NULL if there is none
+ * Output: pointer to the block, NULL if a disk read failed
+*/
+static uint8_t* hold_block(uint32_t block_num, buf_t** held){
+    *held = NULL;
+    if(active_disk == NULL){
+        return block_ptr + BLOCK_SIZE * block_num;
+    }
+    if(block_num < MAX_DATA_BLOCKS && disk_pins[block_num] != NULL){
+        return disk_pins[block_num]->data;
+    }
+    *held = bcache_read(active_disk, disk_first_block + block_num);
+    return (*held != NULL) ? (*held)->data : NULL;
+}
+
+/* drop_block
+ * Description: let go of a block from hold_block
+ * Input: held: the buffer hold_block returned
+ * Output: none
+*/
+static void drop_block(buf_t* held){
+    if(held != NULL){
+        bcache_release(held);
+    }
+}
+
+/* block_table
+ * Description: find the indirect block that holds the number of a file block, for
+ *              blocks past the direct entries of a version 2 inode
+ * Input: curr_inode_ptr: inode of the file
+ *        block_index: index of the block within the file, at least DIRECT_BLOCK_NUM
+ *        first: set to 1 if block_index is the first entry of the table
+ * Output: data block number of the indirect block, BLOCK_NONE if it is out of range
+*/
+static uint32_t block_table(inode_t* curr_inode_ptr, uint32_t block_index, uint32_t* first){
+    uint32_t double_block;
+    uint32_t* table;
+
+    block_index -= DIRECT_BLOCK_NUM;
+    *first = (block_index % PTRS_PER_BLOCK == 0);
+    if(block_index < PTRS_PER_BLOCK){
+        return curr_inode_ptr->data_block_num[SINGLE_INDIRECT];
+    }
+    block_index -= PTRS_PER_BLOCK;
+    double_block = curr_inode_ptr->data_block_num[DOUBLE_INDIRECT];
+    if(double_block >= boot_block_ptr->data_count){
+        return BLOCK_NONE;
+    }
+    table = (uint32_t*)data_block(double_block);
+    return table[block_index / PTRS_PER_BLOCK];
+}
+
+/* inode_block_num
+ * Description: translate a block index within a file into a data block number; the direct
+ *              entries cover every file of a version 1 image and small files of version 2
+ * Input: curr_inode_ptr: inode of the file
+ *        block_index: index of the block within the file
+ * Output: data block number, BLOCK_NONE if an indirect block number is out of range
+*/
+static uint32_t inode_block_num(inode_t* curr_inode_ptr, uint32_t block_index){
+    uint32_t table_block, first;
+
+    if(!indirect_blocks || block_index < DIRECT_BLOCK_NUM){
+        return curr_inode_ptr->data_block_num[block_index];
+    }
+    table_block = block_table(curr_inode_ptr, block_index, &first);
+    if(table_block >= boot_block_ptr->data_count){
+        return BLOCK_NONE;
+    }
+    return ((uint32_t*)data_block(table_block))[(block_index - DIRECT_BLOCK_NUM) % PTRS_PER_BLOCK];
+}
+
+/* is_subdir
+ * Description: check whether a dentry is a subdirectory with its own dentries
+ * Input: dentry: dentry to check
+ * Output: 1 if it is, 0 if not
+*/
+static int32_t is_subdir(const dentry_t* dentry){
+    return dentry->file_type == DIR_TYPE && (dentry->flags & DENTRY_DIR_INODE) &&
+           dentry->inode_num != ROOT_DIR_INODE && dentry->inode_num < inode_count;
+}
+
+/* dir_entry_count
+ * Description: number of dentries in a directory
+ * Input: dir: directory id
+ * Output: dentry count
+*/
+static uint32_t dir_entry_count(uint32_t dir){
+    if(dir == ROOT_DIR_INODE){
+        return (boot_block_ptr->dir_count < DENTRY_NUM - 1) ? boot_block_ptr->dir_count : DENTRY_NUM - 1;
+    }
+    return inode_ptr[dir].length / sizeof(dentry_t);
+}
+
+/* dir_entry_ptr
+ * Description: find one dentry of a directory in the image
+ * Input: dir: directory id
+ *        index: index of the dentry within the directory
+ * Output: pointer to the dentry, NULL if index is past the end or the block list is corrupt
+*/
+static dentry_t* dir_entry_ptr(uint32_t dir, uint32_t index){
+    uint32_t block_num;
+    if(index >= dir_entry_count(dir)){
+        return NULL;
+    }
+    if(dir == ROOT_DIR_INODE){
+        return &dentry_ptr[index];
+    }
+    block_num = inode_block_num(inode_ptr + dir, index / DENTRIES_PER_BLOCK);
+    if(block_num >= boot_block_ptr->data_count){
+        return NULL;
+    }
+    return (dentry_t*)data_block(block_num) + index % DENTRIES_PER_BLOCK;
+}
+
+/* walk_dentries
+ * Description: call visit on every dentry of every directory, breadth first from the root
+ * Input: visit: function called with the directory id and the dentry
+ * Output: none
+ * Side effect: a directory reachable more than once is only walked the first time
+*/
+static void walk_dentries(void (*visit)(uint32_t dir, dentry_t* dentry)){
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t dir, i, count;
+    dentry_t* dentry;
+
+    memset(dir_seen, 0, sizeof(dir_seen));
+    dir_queue[tail++] = ROOT_DIR_INODE;
+    while(head < tail){
+        dir = dir_queue[head++];
+        count = dir_entry_count(dir);
+        for(i = 0; i < count; i++){
+            dentry = dir_entry_ptr(dir, i);
+            if(dentry == NULL){
+                break;  //corrupt block list
+            }
+            visit(dir, dentry);
+            if(is_subdir(dentry) && dentry->inode_num < MAX_INODES &&
+               !(dir_seen[dentry->inode_num / BITMAP_BITS] & (1 << (dentry->inode_num % BITMAP_BITS)))){
+                dir_seen[dentry->inode_num / BITMAP_BITS] |= 1 << (dentry->inode_num % BITMAP_BITS);
+                dir_queue[tail++] = dentry->inode_num;
+            }
+        }
+    }
+}
+
+/* filename_hash
+ * Description: FNV-1a hash of a filename, stopping at the first '\0' or FILENAME_LEN bytes
+ * Input: fname: name to hash
+ * Output: 32-bit hash value
+*/
+static uint32_t filename_hash(const uint8_t* fname){
+    uint32_t hash = 2166136261U;    //FNV offset basis
+    int i;
+    for(i = 0; i < FILENAME_LEN && fname[i] != '\0'; i++){
+        hash ^= fname[i];
+        hash *= 16777619U;          //FNV prime
+    }
+    return hash;
+}
+
+/* dentry_slot_hash
+ * Description: hash of a (directory, filename) pair
+ * Input: dir: directory id
+ *        fname: name, at most FILENAME_LEN bytes
+ * Output: hash value
+*/
+static uint32_t dentry_slot_hash(uint32_t dir, const uint8_t* fname){
+    return filename_hash(fname) ^ (dir * 2654435761U);  //Knuth's multiplicative hash
+}
+
+/* index_dentry
+ * Description: add one dentry to the dentry index
+ * Input: dir: directory holding the dentry
+ *        dentry: the dentry
+ * Output: none
+ * Side effect: sets dentry_index_full when the index has no room
+*/
+static void index_dentry(uint32_t dir, dentry_t* dentry){
+    uint8_t fname[FILENAME_LEN + 1];
+    uint32_t slot;
+
+    if(dentry_index_count >= MAX_INDEXED_DENTRIES){
+        dentry_index_full = 1;
+        return;
+    }
+    strncpy((int8_t*)fname, dentry->filename, FILENAME_LEN);
+    fname[FILENAME_LEN] = '\0';
+    slot = dentry_slot_hash(dir, fname) & (DENTRY_HASH_SIZE - 1);
+    while(dentry_hash[slot] != DENTRY_HASH_EMPTY){  //linear probing
+        slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+    }
+    dentry_index[dentry_index_count].dir = dir;
+    dentry_index[dentry_index_count].dentry = dentry;
+    dentry_hash[slot] = dentry_index_count++;
+}
+
+/* build_dentry_index
+ * Description: hash every dentry of every directory into dentry_hash
+ * Input: none
+ * Output: none
+ * Side effect: overwrites dentry_hash and dentry_index
+*/
+static void build_dentry_index(){
+    memset(dentry_hash, 0xFF, sizeof(dentry_hash));
+    dentry_index_count = 0;
+    dentry_index_full = 0;
+    walk_dentries(index_dentry);
+}
+
+/* build_extents
+ * Description: coalesce each inode's data_block_num list into runs of contiguous blocks
+ * Input: none
+ * Output: none
+ * Side effect: overwrites extents and extent_maps; inodes that are invalid or do not
+ *              fit in the table get an empty map and fall back to read_data_by_block
+*/
+static void build_extents(){
+    uint32_t i, j, num_blocks, block_num;
+    uint32_t used = 0;
+    inode_t* curr_inode_ptr;
+    extent_t* curr_extent;
+
+    memset(extent_maps, 0, sizeof(extent_maps));
+    for(i = 0; i < inode_count && i < MAX_EXTENT_INODES; i++){
+        curr_inode_ptr = inode_ptr + i;
+        if(curr_inode_ptr->length <= 0){
+            continue;   //empty or unused inode
+        }
+        num_blocks = (curr_inode_ptr->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if(num_blocks > max_file_blocks()){
+            continue;
+        }
+
+        extent_maps[i].first = used;
+        curr_extent = NULL;
+        for(j = 0; j < num_blocks; j++){
+            block_num = inode_block_num(curr_inode_ptr, j);
+            if(block_num >= boot_block_ptr->data_count){
+                break;  //corrupt block list
+            }
+            if(curr_extent != NULL && curr_extent->data_block + curr_extent->count == block_num){
+                curr_extent->count++;   //continues the current run
+                continue;
+            }
+            if(used == MAX_EXTENTS){
+                break;  //table full
+            }
+            curr_extent = &extents[used++];
+            curr_extent->file_block = j;
+            curr_extent->data_block = block_num;
+            curr_extent->count = 1;
+        }
+
+        if(j < num_blocks){
+            used = extent_maps[i].first;    //drop the partial map
+            continue;
+        }
+        extent_maps[i].count = used - extent_maps[i].first;
+    }
+}
+
+/* bitmap_alloc
+ * Description: take the first free bit at or after the cursor word, skipping full words
+ * Input: bitmap: bitmap to allocate from
+ *        words: number of words in the bitmap
+ *        cursor: word to start from, updated to the word that had a free bit
+ * Output: allocated bit number, -1 if the bitmap is full
+*/
+static int32_t bitmap_alloc(uint32_t* bitmap, uint32_t words, uint32_t* cursor){
+    uint32_t i, word, bit;
+    for(i = 0; i < words; i++){
+        word = (*cursor + i) % words;
+        if(bitmap[word] == BITMAP_FULL){
+            continue;
+        }
+        for(bit = 0; bit < BITMAP_BITS; bit++){
+            if(!(bitmap[word] & (1 << bit))){
+                bitmap[word] |= (1 << bit);
+                *cursor = word;
+                return word * BITMAP_BITS + bit;
+            }
+        }
+    }
+    return -1;
+}
+
+/* alloc_block
+ * Description: take a free data block, pinning it for disk images since its new contents
+ *              will only exist in memory
+ * Input: hint: block to take if it is free, -1 for none
+ * Output: block number, -1 if the image is out of blocks or the cache cannot pin one
+*/
+static int32_t alloc_block(int32_t hint){
+    int32_t block_num;
+
+    if(hint >= 0 && hint < data_block_limit && !bitmap_test(block_bitmap, hint)){
+        bitmap_set(block_bitmap, hint);     //O(1) when the run continues
+        block_num = hint;
+    }else{
+        block_num = bitmap_alloc(block_bitmap, MAX_DATA_BLOCKS / BITMAP_BITS, &block_cursor);
+    }
+    if(block_num != -1 && active_disk != NULL && pin_block(block_num, 0) == -1){
+        bitmap_clear(block_bitmap, block_num);
+        return -1;
+    }
+    return block_num;
+}
+
+/* free_block
+ * Description: return a data block to the free pool
+ * Input: block_num: block number, below data_block_limit
+ * Output: none
+*/
+static void free_block(uint32_t block_num){
+    bitmap_clear(block_bitmap, block_num);
+    unpin_block(block_num);
+}
+
+/* name_slot
+ * Description: find one slot of a name table, which spans num_blocks data blocks
+ * Input: table: the table
+ *        slot: slot number, below num_slots
+ * Output: pointer to the slot
+*/
+static name_slot_t* name_slot(const name_table_t* table, uint32_t slot){
+    return (name_slot_t*)data_block(table->first_block + slot / NAME_SLOTS_PER_BLOCK) + slot % NAME_SLOTS_PER_BLOCK;
+}
+
+/* name_table_checksum
+ * Description: checksum of a name table's slots, as computed by tools/createfs
+ * Input: table: the table
+ *        used: set to the number of slots in use
+ * Output: checksum
+*/
+static uint32_t name_table_checksum(const name_table_t* table, uint32_t* used){
+    uint32_t i;
+    uint32_t sum = 0;
+    name_slot_t* slot;
+
+    *used = 0;
+    for(i = 0; i < table->num_slots; i++){
+        slot = name_slot(table, i);
+        sum = ((sum << 1) | (sum >> 31)) ^ slot->hash;
+        sum = ((sum << 1) | (sum >> 31)) ^ (slot->dir | (slot->index << 16));
+        if(slot->index != NAME_SLOT_EMPTY){
+            (*used)++;
+        }
+    }
+    return sum;
+}
+
+/* load_name_table
+ * Description: check the header of the name table described in the boot block and use
+ *              the table for lookups. Summing every slot would read the whole table at
+ *              each mount, so the slots are left to verify_name_table; a damaged slot
+ *              can only make a lookup miss, and probing is bounded by num_slots
+ * Input: none
+ * Output: 0 if the header is valid, -1 if the image has no table or the header is bad
+ * Side effect: sets name_table, or clears it
+*/
+static int32_t load_name_table(){
+    name_table_t* table = (name_table_t*)boot_block_ptr->reserved;
+
+    name_table = NULL;
+    if(table->magic != NAME_TABLE_MAGIC || table->num_slots == 0 ||
+       (table->num_slots & (table->num_slots - 1)) != 0 || table->num_entries >= table->num_slots ||
+       table->num_slots > table->num_blocks * NAME_SLOTS_PER_BLOCK ||
+       table->first_block >= boot_block_ptr->data_count ||
+       table->num_blocks > boot_block_ptr->data_count - table->first_block){
+        return -1;
+    }
+    name_table = table;
+    return 0;
+}
+
+/* verify_name_table
+ * Description: check the slots of the mounted image's name table against the checksum
+ *              tools/createfs stored in its header
+ * Input: none
+ * Output: 0 if the table checks out or the image has none, -1 if not
+*/
+int32_t verify_name_table(){
+    uint32_t used;
+
+    if(name_table == NULL){
+        return 0;
+    }
+    if(name_table_checksum(name_table, &used) != name_table->checksum || used != name_table->num_entries){
+        return -1;
+    }
+    return 0;
+}
+
+/* drop_name_table
+ * Description: stop using the image's name table before a directory changes, since its
+ *              dentry positions go stale, and switch to the in-memory index
+ * Input: none
+ * Output: none
+ * Side effect: frees the table's blocks and clears its magic so a remount ignores it
+*/
+static void drop_name_table(){
+    uint32_t i;
+
+    if(name_table == NULL){
+        return;
+    }
+    for(i = 0; i < name_table->num_blocks && name_table->first_block + i < data_block_limit; i++){
+        free_block(name_table->first_block + i);
+    }
+    name_table->magic = 0;
+    name_table = NULL;
+    build_dentry_index();
+}
+
+/* mark_inode_blocks
+ * Description: mark or clear the data blocks of a file, and the indirect blocks that
+ *              point to them, in block_bitmap
+ * Input: curr_inode_ptr: inode of the file
+ *        start: first file block to mark
+ *        end: one past the last file block to mark
+ *        used: 1 to mark the blocks used, 0 to mark them free
+ * Output: none
+ * Side effect: an indirect block is only touched along with its first entry, so freeing
+ *              the tail of a file keeps the tables its remaining blocks still need.
+ *              Blocks are walked from the end, so a table is freed only once every
+ *              later block has been looked up through it.
+ *              A block marked twice is shared (deduplicated images); freeing it drops
+ *              one share and leaves it in use until its last file lets go
+*/
+static void mark_inode_blocks(inode_t* curr_inode_ptr, uint32_t start, uint32_t end, uint32_t used){
+    uint32_t i, first;
+    uint32_t marks[3];  //data block, indirect block, double indirect block
+    uint32_t num_marks, j;
+
+    for(i = end; i-- > start; ){
+        num_marks = 0;
+        marks[num_marks++] = inode_block_num(curr_inode_ptr, i);
+        if(indirect_blocks && i >= DIRECT_BLOCK_NUM){
+            marks[num_marks] = block_table(curr_inode_ptr, i, &first);
+            if(first){
+                num_marks++;
+            }
+            if(i == DIRECT_BLOCK_NUM + PTRS_PER_BLOCK){
+                marks[num_marks++] = curr_inode_ptr->data_block_num[DOUBLE_INDIRECT];
+            }
+        }
+        for(j = 0; j < num_marks; j++){
+            if(marks[j] >= data_block_limit){
+                continue;   //corrupt block list
+            }
+            if(used){
+                if(bitmap_test(block_bitmap, marks[j]) && block_shares[marks[j]] < MAX_BLOCK_SHARES){
+                    block_shares[marks[j]]++;
+                }
+                bitmap_set(block_bitmap, marks[j]);
+            }else if(block_shares[marks[j]] == MAX_BLOCK_SHARES){
+                continue;   //lost count, never free it
+            }else if(block_shares[marks[j]] > 0){
+                block_shares[marks[j]]--;
+            }else{
+                free_block(marks[j]);
+            }
+        }
+    }
+}
+
+/* set_inode_block
+ * Description: store the data block number of one file block, allocating the indirect
+ *              blocks it needs when it is the first entry of a table
+ * Input: curr_inode_ptr: inode of the file
+ *        block_index: index of the block within the file, one past the current last block
+ *        block_num: data block to store
+ * Output: 0 for success, -1 if there is no block left for an indirect block
+*/
+static int32_t set_inode_block(inode_t* curr_inode_ptr, uint32_t block_index, uint32_t block_num){
+    int32_t table_block = -1;
+    int32_t double_block = -1;
+    uint32_t first;
+    uint32_t* table;
+
+    if(!indirect_blocks || block_index < DIRECT_BLOCK_NUM){
+        curr_inode_ptr->data_block_num[block_index] = block_num;
+        return 0;
+    }
+    block_index -= DIRECT_BLOCK_NUM;
+    if(block_index == PTRS_PER_BLOCK){
+        double_block = alloc_block(-1);
+        if(double_block == -1){
+            return -1;
+        }
+        curr_inode_ptr->data_block_num[DOUBLE_INDIRECT] = double_block;
+    }
+    if(block_index % PTRS_PER_BLOCK == 0){
+        table_block = alloc_block(-1);
+        if(table_block == -1){
+            if(double_block != -1){
+                free_block(double_block);
+            }
+            return -1;
+        }
+        if(block_index == 0){
+            curr_inode_ptr->data_block_num[SINGLE_INDIRECT] = table_block;
+        }else{
+            table = (uint32_t*)data_block(curr_inode_ptr->data_block_num[DOUBLE_INDIRECT]);
+            table[block_index / PTRS_PER_BLOCK - 1] = table_block;
+        }
+    }
+    block_index += DIRECT_BLOCK_NUM;
+    table_block = block_table(curr_inode_ptr, block_index, &first);
+    ((uint32_t*)data_block(table_block))[(block_index - DIRECT_BLOCK_NUM) % PTRS_PER_BLOCK] = block_num;
+    return 0;
+}
+
+/* mark_dentry_used
+ * Description: mark the inode and data blocks of a regular file or subdirectory as in use
+ * Input: dir: directory holding the dentry (unused)
+ *        dentry: the dentry
+ * Output: none
+*/
+static void mark_dentry_used(uint32_t dir, dentry_t* dentry){
+    uint32_t num_blocks;
+    inode_t* curr_inode_ptr;
+
+    if((dentry->file_type != REGULAR_TYPE && !is_subdir(dentry)) || dentry->inode_num >= inode_count){
+        return;     //the root and devices own no inode
+    }
+    bitmap_set(inode_bitmap, dentry->inode_num);
+    curr_inode_ptr = inode_ptr + dentry->inode_num;
+    num_blocks = (curr_inode_ptr->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if(num_blocks > max_file_blocks()){
+        num_blocks = max_file_blocks();
+    }
+    mark_inode_blocks(curr_inode_ptr, 0, num_blocks, 1);
+}
+
+/* build_bitmaps
+ * Description: mark every inode and data block used by a regular file or a subdirectory
+ *              as in use
+ * Input: none
+ * Output: none
+ * Side effect: overwrites block_bitmap, inode_bitmap and block_shares; blocks and inodes past the
+ *              image (or past the bitmap size) are marked used so they are never handed out.
+ *              Indirect blocks are marked along with the data blocks that need them, and the
+ *              name table's blocks while it is in use
+*/
+static void build_bitmaps(){
+    uint32_t i;
+
+    memset(block_bitmap, 0, sizeof(block_bitmap));
+    memset(inode_bitmap, 0, sizeof(inode_bitmap));
+    memset(block_shares, 0, sizeof(block_shares));
+    for(i = boot_block_ptr->data_count; i < MAX_DATA_BLOCKS; i++){
+        bitmap_set(block_bitmap, i);
+    }
+    for(i = inode_count; i < MAX_INODES; i++){
+        bitmap_set(inode_bitmap, i);
+    }
+    block_cursor = 0;
+    inode_cursor = 0;
+    data_block_limit = boot_block_ptr->data_count;
+    if(data_block_limit > MAX_DATA_BLOCKS){
+        data_block_limit = MAX_DATA_BLOCKS;
+    }
+
+    bitmap_set(inode_bitmap, ROOT_DIR_INODE);   //never handed to a subdirectory
+    walk_dentries(mark_dentry_used);
+    for(i = 0; name_table != NULL && i < name_table->num_blocks && name_table->first_block + i < data_block_limit; i++){
+        bitmap_set(block_bitmap, name_table->first_block + i);
+    }
+}
+
+/* mark_dentry_compressed
+ * Description: record the decompressed length of a compressed file
+ * Input: dir: directory holding the dentry (unused)
+ *        dentry: the dentry
+ * Output: none
+*/
+static void mark_dentry_compressed(uint32_t dir, dentry_t* dentry){
+    if(dentry->file_type != REGULAR_TYPE || !(dentry->flags & DENTRY_COMPRESSED) ||
+       dentry->inode_num >= inode_count || dentry->inode_num >= MAX_INODES){
+        return;
+    }
+    bitmap_set(compressed_bitmap, dentry->inode_num);
+    raw_lengths[dentry->inode_num] = dentry->raw_length;
+}
+
+/* build_compression_map
+ * Description: record which inodes hold compressed files and their decompressed lengths
+ * Input: none
+ * Output: none
+ * Side effect: overwrites compressed_bitmap and raw_lengths, empties the chunk cache
+*/
+static void build_compression_map(){
+    uint32_t i;
+
+    memset(compressed_bitmap, 0, sizeof(compressed_bitmap));
+    walk_dentries(mark_dentry_compressed);
+    for(i = 0; i < CHUNK_CACHE_SIZE; i++){
+        chunk_cache[i].inode = -1;
+    }
+    chunk_cache_next = 0;
+}
+
+/* find_free_run
+ * Description: find the first run of free data blocks long enough for count blocks
+ * Input: count: number of blocks wanted
+ * Output: first block of the run, -1 if there is no such run
+*/
+static int32_t find_free_run(uint32_t count){
+    uint32_t i;
+    uint32_t run = 0;
+    for(i = 0; i < data_block_limit; i++){
+        run = bitmap_test(block_bitmap, i) ? 0 : run + 1;
+        if(run == count){
+            return i - count + 1;
+        }
+    }
+    return -1;
+}
+
+/* resize_blocks
+ * Description: grow or shrink an inode's block list, placing new blocks right after the
+ *              file's last block when possible, otherwise at the start of a free run;
+ *              indirect blocks are allocated and freed as the list crosses into them
+ * Input: curr_inode_ptr: inode to resize
+ *        old_blocks: blocks currently in use
+ *        new_blocks: blocks wanted
+ * Output: 0 for success, -1 if the image is out of blocks (the inode is left unchanged)
+*/
+static int32_t resize_blocks(inode_t* curr_inode_ptr, uint32_t old_blocks, uint32_t new_blocks){
+    uint32_t i;
+    int32_t block_num;
+    int32_t hint;
+
+    if(new_blocks <= old_blocks){   //shrink
+        mark_inode_blocks(curr_inode_ptr, new_blocks, old_blocks, 0);
+        return 0;
+    }
+
+    hint = (old_blocks > 0) ? inode_block_num(curr_inode_ptr, old_blocks - 1) + 1 : -1;
+    if(hint < 0 || hint >= data_block_limit || bitmap_test(block_bitmap, hint)){
+        hint = find_free_run(new_blocks - old_blocks);
+    }
+    for(i = old_blocks; i < new_blocks; i++){
+        block_num = alloc_block(hint);
+        if(block_num != -1 && set_inode_block(curr_inode_ptr, i, block_num) == -1){
+            free_block(block_num);  //no room for the indirect block
+            block_num = -1;
+        }
+        if(block_num == -1){
+            mark_inode_blocks(curr_inode_ptr, old_blocks, i, 0);   //undo the partial allocation
+            return -1;
+        }
+        hint = block_num + 1;
+    }
+    return 0;
+}
 
 /* init_filesystem
  * Description: Initialize the file system pointers
  * Input: base_address: file system address in memory
  * Output: none
- * Side effect: initialize the file_sys_addr and where boot_block starts
+ * Side effect: initialize the file_sys_addr and where boot_block starts, and use the image's
+ *              name table or build the dentry index. Passing the boot block of the mounted
+ *              disk image switches back to it
 */
 void init_filesystem(unsigned int base_address){
     boot_block_ptr = (boot_block_t*)(base_address);
     dentry_ptr = boot_block_ptr->direntries;
     inode_ptr = (inode_t*)(boot_block_ptr + 1);
     inode_count = boot_block_ptr->inode_count;  //total inode count
-    block_ptr = (uint8_t*)(inode_ptr + inode_count);
+    if((uint8_t*)base_address == disk_meta && disk_dev != NULL){
+        active_disk = disk_dev;     //the disk image again, e.g. after a test image
+        block_ptr = NULL;           //data blocks are in the buffer cache
+    }else{
+        active_disk = NULL;
+        block_ptr = (uint8_t*)(inode_ptr + inode_count);
+    }
+    indirect_blocks = (boot_block_ptr->version == FS_VERSION_INDIRECT);
+    if(load_name_table() == -1){
+        build_dentry_index();   //no usable table in the image, index the dentries now
+    }
+    build_extents();
+    build_bitmaps();
+    build_compression_map();
+}
+
+/* valid_disk_image
+ * Description: sanity check a boot block read from a disk before trusting its counts
+ * Input: boot: the boot block
+ *        sectors: size of the disk
+ * Output: 1 if it looks like an image that fits disk_meta and the disk, 0 if not
+*/
+static int32_t valid_disk_image(const boot_block_t* boot, uint32_t sectors){
+    return boot->dir_count > 0 && boot->dir_count < DENTRY_NUM &&
+           boot->inode_count > 0 && boot->inode_count <= FS_DISK_MAX_INODES &&
+           boot->data_count > 0 && boot->data_count <= MAX_DATA_BLOCKS &&
+           (boot->version == 0 || boot->version == FS_VERSION_INDIRECT) &&
+           strncmp(boot->direntries[0].filename, ".", FILENAME_LEN) == 0 &&
+           boot->direntries[0].file_type == DIR_TYPE &&
+           (1 + boot->inode_count + boot->data_count) * SECTORS_PER_BLOCK <= sectors;
+}
+
+/* init_filesystem_disk
+ * Description: mount an image stored at the start of a disk. The boot block and inodes
+ *              are read now; data blocks are read through the buffer cache, and the
+ *              directories, indirect tables and name table get pinned while mounting
+ * Input: dev: the disk
+ * Output: 0 for success, -1 if the disk cannot be read, holds no image with at most
+ *         FS_DISK_MAX_INODES inodes, or its metadata does not fit the cache
+ * Side effect: writes stay in memory, as they do for an image loaded as a module, and
+ *              are dropped by mounting the disk again
+*/
+int32_t init_filesystem_disk(block_dev_t* dev){
+    boot_block_t* boot = (boot_block_t*)disk_meta;
+
+    if(dev == NULL || blk_read(dev, 0, SECTORS_PER_BLOCK, disk_meta) == -1 ||
+       !valid_disk_image(boot, dev->sectors) ||
+       blk_read(dev, SECTORS_PER_BLOCK, boot->inode_count * SECTORS_PER_BLOCK, disk_meta + BLOCK_SIZE) == -1){
+        return -1;
+    }
+    unpin_all();    //an earlier mount's pinned blocks, and the writes they hold
+    if(disk_dev != NULL){
+        bcache_invalidate(disk_dev);
+    }
+    disk_dev = dev;
+    disk_first_block = 1 + boot->inode_count;
+    disk_pin_failed = 0;
+    init_filesystem((unsigned int)disk_meta);
+    if(disk_pin_failed){
+        unpin_all();
+        disk_dev = NULL;
+        active_disk = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* find_in_dir
+ * Description: look a file name up in one directory, through the image's name table or
+ *              the dentry index unless scan is set or the index is incomplete
+ * Input: dir: directory id
+ *        fname: name of the file, '\0' terminated
+ *        scan: 1 to compare against every dentry of the directory instead
+ * Output: pointer to the dentry, NULL if there is none
+*/
+static dentry_t* find_in_dir(uint32_t dir, const uint8_t* fname, uint32_t scan){
+    uint32_t slot, i, count, hash;
+    uint16_t index;
+    dentry_t* dentry;
+    name_slot_t* entry;
+
+    if(strlen((int8_t*)fname) > FILENAME_LEN){
+        return NULL;    //can never match a 32-byte name
+    }
+    if(!scan && name_table != NULL){
+        hash = dentry_slot_hash(dir, fname);
+        slot = hash & (name_table->num_slots - 1);
+        //the slots are not checked at mount, so a full table must not probe forever
+        for(i = 0; i < name_table->num_slots && (entry = name_slot(name_table, slot))->index != NAME_SLOT_EMPTY;
+            i++, slot = (slot + 1) & (name_table->num_slots - 1)){
+            if(entry->hash == hash && entry->dir == dir &&
+               (dentry = dir_entry_ptr(dir, entry->index)) != NULL &&
+               strncmp((int8_t*)fname, dentry->filename, FILENAME_LEN) == 0){
+                return dentry;
+            }
+        }
+        return NULL;    //the table holds every dentry of the image
+    }
+    if(!scan){
+        slot = dentry_slot_hash(dir, fname) & (DENTRY_HASH_SIZE - 1);
+        while((index = dentry_hash[slot]) != DENTRY_HASH_EMPTY){
+            //fname is at most 32 chars, so strncmp also checks that the lengths match
+            if(dentry_index[index].dir == dir &&
+               strncmp((int8_t*)fname, dentry_index[index].dentry->filename, FILENAME_LEN) == 0){
+                return dentry_index[index].dentry;
+            }
+            slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+        }
+        if(!dentry_index_full){
+            return NULL;
+        }
+    }
+
+    count = dir_entry_count(dir);
+    for(i = 0; i < count; i++){     //traverse dentries to find matched file name
+        dentry = dir_entry_ptr(dir, i);
+        if(dentry == NULL){
+            break;
+        }
+        if(strncmp((int8_t*)fname, dentry->filename, FILENAME_LEN) == 0){
+            return dentry;
+        }
+    }
+    return NULL;
+}
+
+/* resolve_path
+ * Description: walk a '/' separated path from the root directory, one directory per
+ *              component; a leading '/' and repeated separators are ignored
+ * Input: path: path to resolve
+ *        path_len: number of bytes of path to use
+ *        scan: passed to find_in_dir
+ *        parent: set to the directory holding the final component, may be NULL
+ * Output: pointer to the dentry of the final component, NULL if the path is empty,
+ *         a component is missing or longer than FILENAME_LEN, or a non-final component
+ *         is not a subdirectory
+*/
+static dentry_t* resolve_path(const uint8_t* path, uint32_t path_len, uint32_t scan, uint32_t* parent){
+    uint8_t fname[FILENAME_LEN + 1];
+    uint32_t dir = ROOT_DIR_INODE;
+    uint32_t pos = 0;
+    uint32_t len;
+    dentry_t* dentry = NULL;
+
+    if(path == NULL){
+        return NULL;
+    }
+    while(1){
+        while(pos < path_len && path[pos] == PATH_SEPARATOR){
+            pos++;
+        }
+        if(pos >= path_len || path[pos] == '\0'){
+            break;
+        }
+        if(dentry != NULL){
+            if(!is_subdir(dentry)){
+                return NULL;
+            }
+            dir = dentry->inode_num;
+        }
+        for(len = 0; pos + len < path_len && path[pos + len] != '\0' && path[pos + len] != PATH_SEPARATOR; len++){
+            if(len == FILENAME_LEN){
+                return NULL;
+            }
+        }
+        memcpy(fname, path + pos, len);
+        fname[len] = '\0';
+        dentry = find_in_dir(dir, fname, scan);
+        if(dentry == NULL){
+            return NULL;
+        }
+        pos += len;
+    }
+    if(parent != NULL){
+        *parent = dir;
+    }
+    return dentry;
+}
+
+/* split_path
+ * Description: find the directory that a new file at path goes into
+ * Input: path: path of the new file
+ *        dir: set to the id of the parent directory
+ *        leaf: set to the final component of path
+ * Output: 0 for success, -1 if the parent is missing or is not a directory
+*/
+static int32_t split_path(const uint8_t* path, uint32_t* dir, const uint8_t** leaf){
+    uint32_t i, len;
+    dentry_t* parent;
+
+    len = strlen((int8_t*)path);
+    for(i = len; i > 0 && path[i - 1] != PATH_SEPARATOR; i--);
+    *leaf = path + i;
+    *dir = ROOT_DIR_INODE;
+
+    while(i > 0 && path[i - 1] == PATH_SEPARATOR){
+        i--;
+    }
+    if(i == 0){
+        return 0;   //in the root directory
+    }
+    parent = resolve_path(path, i, 0, NULL);
+    if(parent == NULL || !is_subdir(parent)){
+        return -1;
+    }
+    *dir = parent->inode_num;
+    return 0;
 }
 
 /* read_dentry_by_name
- * Description: load the coresponding file's name, type, inode into dentry
- * Input: file_name: name of the file
+ * Description: load the coresponding file's name, type, inode into dentry through the dentry index
+ * Input: file_name: path of the file, components separated by '/'
  *        dentry: dentry to copy data into
  * Output: 0 for success, -1 for fail
 */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
+    dentry_t* found;
+    if(fname == NULL || (found = resolve_path(fname, strlen((int8_t*)fname), 0, NULL)) == NULL){
+        return -1;
+    }
+    *dentry = *found;
+    return 0;
+}
 
-    int fname_len = strlen((int8_t*) fname);
-    int dname_len;
-    int i;
-    for(i = 0; i < boot_block_ptr->dir_count; i++){    //traverse dentries to find matched file name
-        dname_len = strlen((int8_t*)dentry_ptr[i].filename);
+/* read_dentry_by_scan
+ * Description: same as read_dentry_by_name, but scans every dentry of each directory on the
+ *              path instead of using the index
+ * Input: file_name: path of the file
+ *        dentry: dentry to copy data into
+ * Output: 0 for success, -1 for fail
+*/
+int32_t read_dentry_by_scan (const uint8_t* fname, dentry_t* dentry){
+    dentry_t* found;
+    if(fname == NULL || (found = resolve_path(fname, strlen((int8_t*)fname), 1, NULL)) == NULL){
+        return -1;
+    }
+    *dentry = *found;
+    return 0;
+}
+
+/* read_dentry_by_index
+ * Description: copy the target dentry into input dentry
+ * Input: index: index of the dentry to copy from
+ *        dentry: dentry to copy data into
+ * Output: 0 for sucess, -1 for fail
+*/
+int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry){
+    if(index < 64 - 1) {
+        *dentry = boot_block_ptr->direntries[index];
+        return 0;
+    }
+    return -1;
+}
+
+/* copy_from_disk
+ * Description: copy bytes of a run of contiguous data blocks of a disk image, one cached
+ *              block at a time
+ * Input: buf: destination
+ *        first_block: data block holding the first byte
+ *        offset: offset of the first byte within first_block
+ *        length: number of bytes
+ * Output: 0 for success, -1 if a block could not be read
+*/
+static int32_t copy_from_disk(uint8_t* buf, uint32_t first_block, uint32_t offset, uint32_t length){
+    uint32_t bytes_to_copy;
+    uint8_t* block;
+    buf_t* held;
+
+    while(length > 0){
+        if((block = hold_block(first_block, &held)) == NULL){
+            return -1;
+        }
+        bytes_to_copy = (length < BLOCK_SIZE - offset) ? length : BLOCK_SIZE - offset;
+        memcpy(buf, block + offset, bytes_to_copy);
+        drop_block(held);
+        buf += bytes_to_copy;
+        length -= bytes_to_copy;
+        first_block++;
+        offset = 0;
+    }
+    return 0;
+}
+
+/* read_stored
+ * Description: get the offset from inode, and write buff length into buf, copying each
+ *              contiguous run of blocks with a single memcpy; compressed files are read
+ *              as they are stored
+ * Input: inode: inode number that points to inode block
+ *        offset: offset from beginnging to start reading  
+ *        buf: buffer to copy data into
+ *        length: the length of data to read
+ * Output: bytes_read
+*/
+static int32_t read_stored (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    uint32_t bytes_read = 0;
+    uint32_t bytes_to_copy;
+    uint32_t block_index = offset / BLOCK_SIZE;
+    uint32_t block_offset = offset % BLOCK_SIZE;
+    inode_t* curr_inode_ptr = (inode_t*)(inode_ptr + inode);
+    extent_t* curr_extent;
+    extent_t* last_extent;
+    uint32_t low, high, mid;
+    uint32_t first_block;
+
+    if(inode >= boot_block_ptr->inode_count){
+        return -1;  //inalid inode
+    }
+    if(inode >= MAX_EXTENT_INODES || extent_maps[inode].count == 0){
+        return read_data_by_block(inode, offset, buf, length);
+    }
+    if(offset >= curr_inode_ptr->length){
+        return 0;
+    }
+    if(length > curr_inode_ptr->length - offset){
+        length = curr_inode_ptr->length - offset;   //do not read past the end of file
+    }
+
+    //binary search for the extent holding block_index
+    low = extent_maps[inode].first;
+    high = low + extent_maps[inode].count - 1;
+    while(low < high){
+        mid = (low + high + 1) / 2;
+        if(extents[mid].file_block <= block_index){
+            low = mid;
+        }else{
+            high = mid - 1;
+        }
+    }
+    curr_extent = &extents[low];
+    last_extent = &extents[extent_maps[inode].first + extent_maps[inode].count - 1];
+
+    while(bytes_read < length){
+        // bytes remaining in this run
+        bytes_to_copy = (curr_extent->file_block + curr_extent->count - block_index) * BLOCK_SIZE - block_offset;
+        if(bytes_to_copy > length - bytes_read){
+            bytes_to_copy = length - bytes_read;
+        }
+        first_block = curr_extent->data_block + block_index - curr_extent->file_block;
+        if(active_disk == NULL){
+            memcpy(buf + bytes_read, block_ptr + BLOCK_SIZE * first_block + block_offset, bytes_to_copy);
+        }else if(copy_from_disk(buf + bytes_read, first_block, block_offset, bytes_to_copy) == -1){
+            return (bytes_read > 0) ? bytes_read : -1;
+        }
+        bytes_read += bytes_to_copy;
+        if(curr_extent == last_extent){
+            break;
+        }
+        curr_extent++;
+        block_index = curr_extent->file_block;
+        block_offset = 0;
+    }
+
+    return bytes_read;
+}
+
+/* lz4_decompress
+ * Description: decode one LZ4 block
+ * Input: src: compressed bytes
+ *        src_len: number of compressed bytes
+ *        dst: buffer for the decoded bytes
+ *        dst_len: size of dst
+ * Output: number of decoded bytes, -1 if the block is corrupt or does not fit in dst
+*/
+static int32_t lz4_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len){
+    uint32_t in = 0;
+    uint32_t out = 0;
+    uint32_t token, len, extra;
+    uint32_t match_offset, match_start, piece;
+
+    while(in < src_len){
+        token = src[in++];
+
+        len = token >> 4;   //literal run
+        if(len == 15){
+            do{
+                if(in >= src_len){
+                    return -1;
+                }
+                extra = src[in++];
+                len += extra;
+            }while(extra == 255);
+        }
+        if(len > src_len - in || len > dst_len - out){
+            return -1;
+        }
+        memcpy(dst + out, src + in, len);
+        in += len;
+        out += len;
+        if(in == src_len){
+            break;  //the last sequence has no match
+        }
+
+        if(src_len - in < 2){
+            return -1;
+        }
+        match_offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        if(match_offset == 0 || match_offset > out){
+            return -1;
+        }
+        len = (token & 0xF) + 4;    //match length, at least 4
+        if((token & 0xF) == 15){
+            do{
+                if(in >= src_len){
+                    return -1;
+                }
+                extra = src[in++];
+                len += extra;
+            }while(extra == 255);
+        }
+        if(len > dst_len - out){
+            return -1;
+        }
+        //an overlapping match repeats the last match_offset bytes, so copy the pattern
+        //in non-overlapping pieces that double in size
+        match_start = out - match_offset;
+        while(len > 0){
+            piece = (len < out - match_start) ? len : out - match_start;
+            memcpy(dst + out, dst + match_start, piece);
+            out += piece;
+            len -= piece;
+        }
+    }
+    return out;
+}
+
+/* is_compressed
+ * Description: check whether an inode holds a compressed file
+ * Input: inode: inode number
+ * Output: nonzero if it does
+*/
+static uint32_t is_compressed(uint32_t inode){
+    return inode < MAX_INODES && bitmap_test(compressed_bitmap, inode);
+}
+
+/* drop_cached_chunks
+ * Description: forget every cached chunk of an inode
+ * Input: inode: inode number
+ * Output: none
+*/
+static void drop_cached_chunks(uint32_t inode){
+    uint32_t i;
+    for(i = 0; i < CHUNK_CACHE_SIZE; i++){
+        if(chunk_cache[i].inode == inode){
+            chunk_cache[i].inode = -1;
+        }
+    }
+}
+
+/* load_chunk
+ * Description: find a decompressed chunk in the cache, decompressing it into the next
+ *              slot (round robin) on a miss
+ * Input: inode: inode of a compressed file
+ *        chunk: chunk index, i.e. decompressed offset / BLOCK_SIZE
+ * Output: the cache entry, NULL if the chunk is corrupt
+*/
+static chunk_cache_t* load_chunk(uint32_t inode, uint32_t chunk){
+    uint32_t i;
+    uint32_t bounds[2];     //offset of this chunk and of the next one
+    uint32_t raw_size;
+    chunk_cache_t* entry;
+
+    for(i = 0; i < CHUNK_CACHE_SIZE; i++){
+        if(chunk_cache[i].inode == inode && chunk_cache[i].chunk == chunk){
+            return &chunk_cache[i];
+        }
+    }
+
+    entry = &chunk_cache[chunk_cache_next];
+    chunk_cache_next = (chunk_cache_next + 1) % CHUNK_CACHE_SIZE;
+    entry->inode = -1;
+
+    raw_size = raw_lengths[inode] - chunk * BLOCK_SIZE;
+    if(raw_size > BLOCK_SIZE){
+        raw_size = BLOCK_SIZE;
+    }
+    if(read_stored(inode, chunk * sizeof(uint32_t), (uint8_t*)bounds, sizeof(bounds)) != sizeof(bounds) ||
+       bounds[1] < bounds[0] || bounds[1] - bounds[0] > raw_size){
+        return NULL;
+    }
+    if(bounds[1] - bounds[0] == raw_size){   //stored uncompressed
+        if(read_stored(inode, bounds[0], entry->data, raw_size) != raw_size){
+            return NULL;
+        }
+    }else{
+        if(read_stored(inode, bounds[0], chunk_buf, bounds[1] - bounds[0]) != bounds[1] - bounds[0] ||
+           lz4_decompress(chunk_buf, bounds[1] - bounds[0], entry->data, raw_size) != raw_size){
+            return NULL;
+        }
+    }
+    entry->inode = inode;
+    entry->chunk = chunk;
+    return entry;
+}
+
+/* read_compressed
+ * Description: read decompressed bytes of a compressed file through the chunk cache
+ * Input: inode: inode of a compressed file
+ *        offset: decompressed offset to start reading
+ *        buf: buffer to copy data into
+ *        length: the length of data to read
+ * Output: bytes read, -1 if a chunk is corrupt
+ * Side effect: bytes go through a COPY_CHUNK stack buffer, since a fault on buf loads a
+ *              page through read_data and may evict the chunk being copied from
+*/
+static int32_t read_compressed (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    uint32_t flags;
+    uint32_t bytes_read = 0;
+    uint32_t bytes_to_copy;
+    uint32_t block_offset;
+    chunk_cache_t* entry;
+    uint8_t staged[COPY_CHUNK];
+
+    if(offset >= raw_lengths[inode]){
+        return 0;
+    }
+    if(length > raw_lengths[inode] - offset){
+        length = raw_lengths[inode] - offset;
+    }
 
-        if(dname_len > FILENAME_LEN){   //check file name length
-            dname_len = FILENAME_LEN;
+    while(bytes_read < length){
+        block_offset = (offset + bytes_read) % BLOCK_SIZE;
+        bytes_to_copy = BLOCK_SIZE - block_offset;
+        if(bytes_to_copy > length - bytes_read){
+            bytes_to_copy = length - bytes_read;
         }
-
-        if(dname_len == fname_len){ //if file name matched, copy to the dentry 
-            if(strncmp((int8_t*)fname,(int8_t*) dentry_ptr[i].filename, FILENAME_LEN) == 0){
-                read_dentry_by_index(i, dentry);
-                return 0;
-            }
+        if(bytes_to_copy > COPY_CHUNK){
+            bytes_to_copy = COPY_CHUNK;
+        }
+        cli_and_save(flags);    //the cache is shared by every process
+        entry = load_chunk(inode, (offset + bytes_read) / BLOCK_SIZE);
+        if(entry == NULL){
+            restore_flags(flags);
+            return -1;
         }
+        memcpy(staged, entry->data + block_offset, bytes_to_copy);
+        restore_flags(flags);
+        memcpy(buf + bytes_read, staged, bytes_to_copy);
+        bytes_read += bytes_to_copy;
     }
-    return -1;
+    return bytes_read;
 }
 
-/* read_dentry_by_index
- * Description: copy the target dentry into input dentry
- * Input: index: index of the dentry to copy from
- *        dentry: dentry to copy data into
- * Output: 0 for sucess, -1 for fail
+/* read_data
+ * Description: read a file's contents, decompressing compressed files
+ * Input: inode: inode number that points to inode block
+ *        offset: offset from beginnging to start reading
+ *        buf: buffer to copy data into
+ *        length: the length of data to read
+ * Output: bytes_read, -1 for fail
 */
-int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry){
-    if(index < 64 - 1) {
-        *dentry = boot_block_ptr->direntries[index];
+int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    if(inode >= boot_block_ptr->inode_count){
+        return -1;  //inalid inode
+    }
+    if(is_compressed(inode)){
+        return read_compressed(inode, offset, buf, length);
+    }
+    return read_stored(inode, offset, buf, length);
+}
+
+/* file_length
+ * Description: length of a file as read_data sees it
+ * Input: inode: inode number of the file
+ * Output: length in bytes, the decompressed length for compressed files
+*/
+uint32_t file_length (uint32_t inode){
+    if(inode >= inode_count){
         return 0;
     }
-    return -1;
+    return is_compressed(inode) ? raw_lengths[inode] : inode_ptr[inode].length;
 }
 
-/* read_data
- * Description: get the offset from inode, and write buff length into buf
+/* read_data_by_block
+ * Description: same as read_data, but walks data_block_num one block at a time and
+ *              reads compressed files as they are stored
  * Input: inode: inode number that points to inode block
  *        offset: offset from beginnging to start reading  
  *        buf: buffer to copy data into
  *        length: the length of data to read
  * Output: bytes_read
 */
-int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+int32_t read_data_by_block (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
     uint32_t block_num;
     uint8_t* curr_block_ptr;
+    buf_t* held;
     uint32_t bytes_read = 0;
     uint32_t block_index = offset / BLOCK_SIZE;
     uint32_t block_offset = offset % BLOCK_SIZE;
     inode_t* curr_inode_ptr = (inode_t*)(inode_ptr + inode);
     uint32_t N = boot_block_ptr->inode_count;
 
-    if(inode >= N || inode < 0){
+    if(inode >= N){
         return -1;  //inalid inode
     }
 
     while ((bytes_read < length && bytes_read + offset < curr_inode_ptr->length))
     {
-        block_num = curr_inode_ptr->data_block_num[block_index];    //get corresponding block number
-        curr_block_ptr = (uint8_t*)(block_ptr + BLOCK_SIZE * block_num + block_offset);
+        block_num = inode_block_num(curr_inode_ptr, block_index);   //get corresponding block number
+        if(block_num >= boot_block_ptr->data_count){
+            break;  //corrupt block list
+        }
+        if((curr_block_ptr = hold_block(block_num, &held)) == NULL){
+            break;  //disk read failed
+        }
+        curr_block_ptr += block_offset;
         uint32_t bytes_to_copy = BLOCK_SIZE - block_offset; // bytes remaining in this block
 
         //do not read more than requested
@@ -92,6 +1442,7 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
             bytes_to_copy = curr_inode_ptr->length - offset - bytes_read;
         }
         memcpy(buf + bytes_read, curr_block_ptr, bytes_to_copy);
+        drop_block(held);
         bytes_read += bytes_to_copy;
         block_index++;
         block_offset = 0;
@@ -100,21 +1451,401 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
     return bytes_read;
 }
 
+/* file_block_ptr
+ * Description: find where one block of a file sits in the image
+ * Input: inode: inode number of the file
+ *        block_index: index of the block within the file
+ * Output: pointer to the data block, NULL if the block is past the end of the file, the
+ *         file is compressed, or the image is on a disk, where a cached block can be
+ *         evicted once nobody holds it
+*/
+uint8_t* file_block_ptr (uint32_t inode, uint32_t block_index){
+    uint32_t block_num;
+    inode_t* curr_inode_ptr = inode_ptr + inode;
+    if(inode >= inode_count || block_index >= (curr_inode_ptr->length + BLOCK_SIZE - 1) / BLOCK_SIZE){
+        return NULL;
+    }
+    if(is_compressed(inode) || active_disk != NULL){
+        return NULL;    //the blocks do not hold the file's bytes, or may not stay put
+    }
+    block_num = inode_block_num(curr_inode_ptr, block_index);
+    if(block_num >= boot_block_ptr->data_count){
+        return NULL;
+    }
+    return data_block(block_num);
+}
+
+/* unshare_blocks
+ * Description: give a file its own copy of every shared block in a byte range, so a
+ *              write does not show through in the files it was deduplicated with
+ * Input: curr_inode_ptr: inode about to be written
+ *        offset: first byte to be written
+ *        length: number of bytes, all within the blocks the inode already has
+ * Output: 0 for success, -1 if the image is out of blocks
+ * Side effect: rebuilds the extent table when a block moves
+*/
+static int32_t unshare_blocks(inode_t* curr_inode_ptr, uint32_t offset, uint32_t length){
+    uint32_t block_index, end, first;
+    uint32_t old_block;
+    int32_t new_block;
+    uint32_t moved = 0;
+    uint8_t* old_ptr;
+    buf_t* held;
+
+    if(length == 0){
+        return 0;
+    }
+    end = (offset + length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for(block_index = offset / BLOCK_SIZE; block_index < end; block_index++){
+        old_block = inode_block_num(curr_inode_ptr, block_index);
+        if(old_block >= data_block_limit || block_shares[old_block] == 0){
+            continue;
+        }
+        new_block = alloc_block(-1);
+        if(new_block == -1){
+            if(moved){
+                build_extents();
+            }
+            return -1;
+        }
+        if((old_ptr = hold_block(old_block, &held)) == NULL){
+            free_block(new_block);
+            if(moved){
+                build_extents();
+            }
+            return -1;
+        }
+        memcpy(data_block(new_block), old_ptr, BLOCK_SIZE);
+        drop_block(held);
+        if(!indirect_blocks || block_index < DIRECT_BLOCK_NUM){
+            curr_inode_ptr->data_block_num[block_index] = new_block;
+        }else{
+            ((uint32_t*)data_block(block_table(curr_inode_ptr, block_index, &first)))
+                [(block_index - DIRECT_BLOCK_NUM) % PTRS_PER_BLOCK] = new_block;
+        }
+        if(block_shares[old_block] < MAX_BLOCK_SHARES){
+            block_shares[old_block]--;
+        }
+        moved = 1;
+    }
+    if(moved){
+        build_extents();
+    }
+    return 0;
+}
+
+/* pin_range
+ * Description: pin the blocks a disk image file already has in a byte range before they
+ *              are written, so the write cannot run out of cache halfway through
+ * Input: curr_inode_ptr: inode about to be written
+ *        offset: first byte to be written
+ *        length: number of bytes, all within the blocks the inode already has
+ * Output: 0 for success, -1 if a block could not be read or too many are pinned
+*/
+static int32_t pin_range(inode_t* curr_inode_ptr, uint32_t offset, uint32_t length){
+    uint32_t block_index, end, block_num;
+
+    if(active_disk == NULL || length == 0){
+        return 0;
+    }
+    end = (offset + length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for(block_index = offset / BLOCK_SIZE; block_index < end; block_index++){
+        block_num = inode_block_num(curr_inode_ptr, block_index);
+        if(block_num < data_block_limit && pin_block(block_num, 1) == -1){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* copy_to_blocks
+ * Description: copy bytes into the data blocks of an inode that already has enough blocks
+ * Input: curr_inode_ptr: inode to write
+ *        offset: offset in the file to start writing
+ *        buf: data to write, NULL to write zeros
+ *        length: number of bytes to write
+ * Output: none
+*/
+static void copy_to_blocks(inode_t* curr_inode_ptr, uint32_t offset, const uint8_t* buf, uint32_t length){
+    uint32_t bytes_written = 0;
+    uint32_t bytes_to_copy;
+    uint32_t block_index = offset / BLOCK_SIZE;
+    uint32_t block_offset = offset % BLOCK_SIZE;
+    uint8_t* curr_block_ptr;
+
+    while(bytes_written < length){
+        curr_block_ptr = data_block(inode_block_num(curr_inode_ptr, block_index)) + block_offset;
+        bytes_to_copy = BLOCK_SIZE - block_offset;
+        if(bytes_to_copy > length - bytes_written){
+            bytes_to_copy = length - bytes_written;
+        }
+        if(buf == NULL){
+            memset(curr_block_ptr, 0, bytes_to_copy);
+        }else{
+            memcpy(curr_block_ptr, buf + bytes_written, bytes_to_copy);
+        }
+        bytes_written += bytes_to_copy;
+        block_index++;
+        block_offset = 0;
+    }
+}
+
+/* set_length
+ * Description: resize a file, allocating or freeing blocks and zero-filling any new bytes
+ * Input: inode: inode number of the file
+ *        length: new length in bytes
+ * Output: 0 for success, -1 if the image is out of blocks
+ * Side effect: rebuilds the extent table when the block list changes
+*/
+static int32_t set_length(uint32_t inode, uint32_t length){
+    inode_t* curr_inode_ptr = inode_ptr + inode;
+    uint32_t old_length = curr_inode_ptr->length;
+    uint32_t old_blocks = (old_length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t new_blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    if(length > old_length && old_length % BLOCK_SIZE != 0 &&
+       (unshare_blocks(curr_inode_ptr, old_length, 1) == -1 || pin_range(curr_inode_ptr, old_length, 1) == -1)){
+        return -1;  //the zero fill starts in a shared block, or one that cannot be pinned
+    }
+    if(resize_blocks(curr_inode_ptr, old_blocks, new_blocks) == -1){
+        return -1;
+    }
+    curr_inode_ptr->length = length;
+    if(length > old_length){
+        copy_to_blocks(curr_inode_ptr, old_length, NULL, length - old_length);
+    }
+    if(new_blocks != old_blocks){
+        build_extents();
+    }
+    return 0;
+}
+
+/* valid_file_inode
+ * Description: check that an inode number belongs to an existing regular file
+ * Input: inode: inode number
+ * Output: 1 if valid, 0 if not
+*/
+static int32_t valid_file_inode(uint32_t inode){
+    return inode < inode_count && inode < MAX_INODES && bitmap_test(inode_bitmap, inode);
+}
+
+/* write_data
+ * Description: write bytes into a file at offset, growing it as needed; any gap between
+ *              the old end of file and offset reads back as zeros
+ * Input: inode: inode number of the file
+ *        offset: offset from beginning to start writing
+ *        buf: data to write
+ *        length: number of bytes to write
+ * Output: bytes written, short if the file is cut shorter meanwhile, -1 for fail,
+ *         including for the program of a running process, whose pages load on first touch
+ * Side effect: blocks are allocated with interrupts off, but buf is read with them on,
+ *              a COPY_CHUNK at a time, since touching it may fault and load a page
+*/
+int32_t write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length){
+    uint32_t flags;
+    uint32_t overlap, done, chunk;
+    uint8_t staged[COPY_CHUNK];
+    inode_t* curr_inode_ptr = inode_ptr + inode;
+
+    if(buf == NULL || !valid_file_inode(inode) || is_compressed(inode)){
+        return -1;  //compressed files are read only
+    }
+    if(offset + length < offset || offset + length > max_file_blocks() * BLOCK_SIZE){
+        return -1;  //larger than an inode can hold
+    }
+
+    cli_and_save(flags);
+    if(file_busy(&file_fop, inode, FILE_BUSY_PROGRAM)){
+        restore_flags(flags);
+        return -1;
+    }
+    overlap = 0;    //bytes overwritten within the current length
+    if(offset < curr_inode_ptr->length){
+        overlap = (length < curr_inode_ptr->length - offset) ? length : curr_inode_ptr->length - offset;
+    }
+    if(unshare_blocks(curr_inode_ptr, offset, overlap) == -1 || pin_range(curr_inode_ptr, offset, overlap) == -1){
+        restore_flags(flags);
+        return -1;
+    }
+    if(offset + length > curr_inode_ptr->length && set_length(inode, offset + length) == -1){
+        restore_flags(flags);
+        return -1;
+    }
+    restore_flags(flags);
+
+    for(done = 0; done < length; done += chunk){
+        chunk = (length - done < COPY_CHUNK) ? length - done : COPY_CHUNK;
+        memcpy(staged, buf + done, chunk);
+        cli_and_save(flags);
+        if(!valid_file_inode(inode) || offset + done + chunk > curr_inode_ptr->length){
+            restore_flags(flags);
+            break;  //truncated while interrupts were on
+        }
+        copy_to_blocks(curr_inode_ptr, offset + done, staged, chunk);
+        restore_flags(flags);
+    }
+    return done;
+}
+
+/* fs_truncate
+ * Description: set a file's length, freeing blocks past the end or zero-filling new bytes
+ * Input: inode: inode number of the file
+ *        length: new length in bytes
+ * Output: 0 for success, -1 for fail, including for a program running or a file mapped
+*/
+int32_t fs_truncate (uint32_t inode, uint32_t length){
+    uint32_t flags;
+    int32_t ret;
+
+    if(!valid_file_inode(inode) || is_compressed(inode) || length > max_file_blocks() * BLOCK_SIZE){
+        return -1;
+    }
+    cli_and_save(flags);
+    if(file_busy(&file_fop, inode, FILE_BUSY_PROGRAM | FILE_BUSY_MAPPED)){
+        restore_flags(flags);
+        return -1;
+    }
+    ret = set_length(inode, length);
+    restore_flags(flags);
+    return ret;
+}
+
+/* create_entry
+ * Description: add an empty regular file or subdirectory to a directory
+ * Input: dir: id of the directory
+ *        fname: name of the new entry, 1 to 32 characters
+ *        file_type: REGULAR_TYPE or DIR_TYPE
+ *        dentry_flags: dentry_t.flags of the new entry
+ * Output: 0 for success, -1 if the name is invalid or taken, or the image is full
+*/
+static int32_t create_entry(uint32_t dir, const uint8_t* fname, uint32_t file_type, uint32_t dentry_flags){
+    uint32_t flags;
+    int32_t inode;
+    uint32_t count;
+    uint32_t fname_len = strlen((int8_t*)fname);
+    dentry_t* new_dentry;
+
+    if(fname_len == 0 || fname_len > FILENAME_LEN){
+        return -1;
+    }
+
+    cli_and_save(flags);
+    count = dir_entry_count(dir);
+    if(find_in_dir(dir, fname, 0) != NULL || (dir == ROOT_DIR_INODE && count >= DENTRY_NUM - 1)){
+        restore_flags(flags);
+        return -1;  //already exists or no free dentry
+    }
+    inode = bitmap_alloc(inode_bitmap, MAX_INODES / BITMAP_BITS, &inode_cursor);
+    if(inode == -1){
+        restore_flags(flags);
+        return -1;
+    }
+    inode_ptr[inode].length = 0;
+    drop_name_table();
+
+    if(dir == ROOT_DIR_INODE){
+        boot_block_ptr->dir_count++;
+    }else if(set_length(dir, (count + 1) * sizeof(dentry_t)) == -1){
+        bitmap_clear(inode_bitmap, inode);  //no block left for the directory to grow
+        restore_flags(flags);
+        return -1;
+    }
+    new_dentry = dir_entry_ptr(dir, count);
+    memset(new_dentry, 0, sizeof(dentry_t));
+    strncpy(new_dentry->filename, (int8_t*)fname, FILENAME_LEN);
+    new_dentry->file_type = file_type;
+    new_dentry->inode_num = inode;
+    new_dentry->flags = dentry_flags;
+    index_dentry(dir, new_dentry);
+    restore_flags(flags);
+    return 0;
+}
+
+/* fs_create
+ * Description: add an empty regular file
+ * Input: fname: path of the new file; the parent must exist and the name is 1 to 32 characters
+ * Output: 0 for success, -1 if the name is invalid or taken, or the image is full
+*/
+int32_t fs_create (const uint8_t* fname){
+    uint32_t dir;
+    const uint8_t* leaf;
+
+    if(fname == NULL || split_path(fname, &dir, &leaf) == -1){
+        return -1;
+    }
+    return create_entry(dir, leaf, REGULAR_TYPE, 0);
+}
+
+/* fs_mkdir
+ * Description: add an empty subdirectory
+ * Input: path: path of the new directory; the parent must exist and the name is 1 to 32 characters
+ * Output: 0 for success, -1 if the name is invalid or taken, or the image is full
+*/
+int32_t fs_mkdir (const uint8_t* path){
+    uint32_t dir;
+    const uint8_t* leaf;
+
+    if(path == NULL || split_path(path, &dir, &leaf) == -1){
+        return -1;
+    }
+    return create_entry(dir, leaf, DIR_TYPE, DENTRY_DIR_INODE);
+}
+
+/* fs_delete
+ * Description: remove a regular file or an empty subdirectory and free its inode and blocks
+ * Input: fname: path of the file
+ * Output: 0 for success, -1 for fail, including for a file a process has open, runs or maps
+*/
+int32_t fs_delete (const uint8_t* fname){
+    uint32_t flags;
+    uint32_t dir, count;
+    uint32_t inode;
+    dentry_t* dentry;
+
+    if(fname == NULL){
+        return -1;
+    }
+    cli_and_save(flags);
+    dentry = resolve_path(fname, strlen((int8_t*)fname), 0, &dir);
+    if(dentry == NULL || !valid_file_inode(dentry->inode_num) ||
+       (dentry->file_type != REGULAR_TYPE && !is_subdir(dentry)) ||
+       (is_subdir(dentry) && inode_ptr[dentry->inode_num].length != 0) ||
+       file_busy(is_subdir(dentry) ? &dir_fop : &file_fop, dentry->inode_num,
+                 FILE_BUSY_PROGRAM | FILE_BUSY_OPEN | FILE_BUSY_MAPPED)){
+        restore_flags(flags);
+        return -1;
+    }
+    inode = dentry->inode_num;
+    drop_name_table();
+    set_length(inode, 0);   //frees every block
+    bitmap_clear(inode_bitmap, inode);
+    if(is_compressed(inode)){
+        bitmap_clear(compressed_bitmap, inode);
+        drop_cached_chunks(inode);
+    }
+
+    count = dir_entry_count(dir);
+    if(dir == ROOT_DIR_INODE){
+        //keep the directory order by shifting the later dentries down
+        memmove(dentry, dentry + 1, (count - (dentry - dentry_ptr) - 1) * sizeof(dentry_t));
+        boot_block_ptr->dir_count--;
+    }else{
+        //subdirectories are unordered, so the last dentry fills the hole
+        *dentry = *dir_entry_ptr(dir, count - 1);
+        set_length(dir, (count - 1) * sizeof(dentry_t));
+    }
+    build_dentry_index();
+    restore_flags(flags);
+    return 0;
+}
+
 /* file_open
  * Description: open the file and set up file descriptor (only for check point 2)
  * Input: fname: name of file to open
  * Output: 0 for sucess, -1 for fail
 */
 int32_t file_open(const uint8_t* fname){
-    /*Invalid file name if length > 32*/
-	// if(strlen((int8_t*)fname) > FILENAME_LEN){
-    //     return -1;
-    // }
-    uint8_t truncated_fname[FILENAME_LEN + 1];
-    strncpy((int8_t*)truncated_fname, (int8_t*)fname, FILENAME_LEN);
-    truncated_fname[FILENAME_LEN] = '\0';
-
-    if(read_dentry_by_name (truncated_fname, &curr_dentry) || curr_dentry.file_type != 2){
+    if(read_dentry_by_name (fname, &curr_dentry) || curr_dentry.file_type != 2){
         return -1;
     }
 	
@@ -133,14 +1864,30 @@ int32_t file_close(int32_t fd){
 }
 
 /* file_write
- * Description: write file
- * Input: fd 
- *        buf 
- *        nbytes 
- * Output: -1
+ * Description: write to the file at the current file position, growing it as needed
+ * Input: fd: index of file to write in file descriptor array
+ *        buf: data to write
+ *        nbytes: number of bytes to write
+ * Output: number of bytes written if success, -1 if failed
 */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes){
-    return -1;
+    int32_t bytes_written;
+
+    if(buf == NULL || nbytes < 0){
+        return -1;
+    }
+
+    PCB* pcb_ptr = get_curr_pcb();
+
+    bytes_written = write_data(pcb_ptr->fda[fd].inode, pcb_ptr->fda[fd].file_position, (const uint8_t*)buf, nbytes);
+
+    if(bytes_written == -1){
+        return -1;
+    }else{
+        pcb_ptr->fda[fd].file_position += bytes_written;
+    }
+
+    return bytes_written;
 }
 
 /* file_read
@@ -189,14 +1936,32 @@ int32_t dir_close (int32_t fd){
 }
 
 /* dir_write
- * Description: write to directory 
+ * Description: write a file name to the directory, which creates an empty regular file in it
  * Input: fd
- * 		  buf
- * 		  nbytes
- * Output: -1
+ * 		  buf: name of the new file (not necessarily null terminated)
+ * 		  nbytes: length of the name
+ * Output: nbytes for success, -1 for fail, including for a name with a '/' or a NUL in it
 */
 int32_t dir_write (int32_t fd,const void* buf, int32_t nbytes){
-    return -1;
+    uint8_t fname[FILENAME_LEN + 1];
+    int32_t i;
+
+    if(buf == NULL || nbytes <= 0 || nbytes > FILENAME_LEN){
+        return -1;
+    }
+    memcpy(fname, buf, nbytes);
+    fname[nbytes] = '\0';
+    // such a name could never be looked up again
+    for(i = 0; i < nbytes; i++){
+        if(fname[i] == '\0' || fname[i] == PATH_SEPARATOR){
+            return -1;
+        }
+    }
+
+    if(create_entry(get_curr_pcb()->fda[fd].inode, fname, REGULAR_TYPE, 0) == -1){
+        return -1;
+    }
+    return nbytes;
 }
 
 /* dir_read
@@ -213,10 +1978,12 @@ int32_t dir_read (int32_t fd, void* buf, int32_t nbytes){
     char temp_filename[FILENAME_LEN + 1]; // +1 for the null terminator
     PCB* curr_pcb = get_curr_pcb();
     int32_t dir_location = curr_pcb->fda[fd].file_position; // get the position of the starting file
+    dentry_t* entry = dir_entry_ptr(curr_pcb->fda[fd].inode, dir_location);
 
-    if(read_dentry_by_index(dir_location, &dt) == -1){  // check for invalid read
+    if(entry == NULL){  // check for invalid read
         return 0;
     }
+    dt = *entry;
 
     for (i = 0; i < FILENAME_LEN; i ++){
         temp_filename[i] = dt.filename[i];
@@ -233,3 +2000,220 @@ int32_t dir_read (int32_t fd, void* buf, int32_t nbytes){
 
     return filename_len;
 }
+
+/* fs_stat
+ * Description: fill in the type, inode and size of a file
+ * Input: dentry: dentry of the file
+ * 		  buf: stat_t to fill
+ * Output: 0 for success, -1 for fail
+*/
+int32_t fs_stat (const dentry_t* dentry, stat_t* buf){
+    if(dentry == NULL || buf == NULL){
+        return -1;
+    }
+    buf->file_type = dentry->file_type;
+    buf->inode_num = dentry->inode_num;
+    buf->size = (dentry->file_type == REGULAR_TYPE) ? file_length(dentry->inode_num) : 0;
+    return 0;
+}
+
+/* dir_getdents
+ * Description: fill buf with as many packed dirent_t entries as fit, starting at the
+ *              directory's file position
+ * Input: fd: index of the directory in file descriptor array
+ * 		  buf: buffer to fill
+ * 		  nbytes: size of buf
+ * Output: number of bytes filled, 0 at the end of the directory, -1 if buf cannot hold one entry
+*/
+int32_t dir_getdents (int32_t fd, void* buf, int32_t nbytes){
+    dirent_t* entry = (dirent_t*)buf;
+    dentry_t* dentry;
+    dentry_t dt;
+    int32_t count = 0;
+    PCB* curr_pcb = get_curr_pcb();
+    int32_t dir_location = curr_pcb->fda[fd].file_position;
+
+    if(buf == NULL || nbytes < (int32_t)sizeof(dirent_t)){
+        return -1;
+    }
+
+    while((count + 1) * (int32_t)sizeof(dirent_t) <= nbytes){
+        dentry = dir_entry_ptr(curr_pcb->fda[fd].inode, dir_location);
+        if(dentry == NULL){
+            break;
+        }
+        dt = *dentry;
+        memcpy(entry[count].filename, dt.filename, FILENAME_LEN);
+        entry[count].file_type = dt.file_type;
+        entry[count].inode_num = dt.inode_num;
+        entry[count].size = (dt.file_type == REGULAR_TYPE) ? file_length(dt.inode_num) : 0;
+        count++;
+        dir_location++;
+    }
+
+    curr_pcb->fda[fd].file_position = dir_location; // next call continues after the last entry
+    return count * sizeof(dirent_t);
+}
+
+/* file_stat
+ * Description: fill in the type, inode and size of an open regular file
+ * Input: fd: index of the file in file descriptor array
+ * 		  buf: stat_t to fill
+ * Output: 0
+*/
+int32_t file_stat (int32_t fd, stat_t* buf){
+    uint32_t inode = get_curr_pcb()->fda[fd].inode;
+    buf->file_type = REGULAR_TYPE;
+    buf->inode_num = inode;
+    buf->size = file_length(inode);
+    return 0;
+}
+
+/* file_truncate
+ * Description: set the length of an open regular file
+ * Input: fd: index of the file in file descriptor array
+ * 		  length: new length in bytes
+ * Output: 0 for success, -1 for fail
+*/
+int32_t file_truncate (int32_t fd, uint32_t length){
+    return fs_truncate(get_curr_pcb()->fda[fd].inode, length);
+}
+
+/* file_pread
+ * Description: read an open regular file at offset without moving its file position
+ * Input: fd: index of the file in file descriptor array
+ * 		  buf: buffer to read into
+ * 		  nbytes: number of bytes to read
+ * 		  offset: position in the file to read from
+ * Output: number of bytes read, -1 for fail
+*/
+int32_t file_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+    return read_data(get_curr_pcb()->fda[fd].inode, offset, (uint8_t*)buf, nbytes);
+}
+
+/* file_page
+ * Description: find one page of an open regular file in the image for mmap
+ * Input: fd: index of the file in file descriptor array
+ * 		  page_index: index of the page within the file
+ * Output: pointer to the page, NULL if it is past the end, compressed, or not page aligned
+*/
+uint8_t* file_page (int32_t fd, uint32_t page_index){
+    uint8_t* block = file_block_ptr(get_curr_pcb()->fda[fd].inode, page_index);
+    if(((uint32_t)block & (BLOCK_SIZE - 1)) != 0){
+        return NULL;    //the image was not loaded page aligned
+    }
+    return block;
+}
+
+/* dir_stat
+ * Description: fill in the type and directory id of an open directory
+ * Input: fd: index of the directory in file descriptor array
+ * 		  buf: stat_t to fill
+ * Output: 0
+*/
+int32_t dir_stat (int32_t fd, stat_t* buf){
+    buf->file_type = DIR_TYPE;
+    buf->inode_num = get_curr_pcb()->fda[fd].inode;
+    buf->size = 0;
+    return 0;
+}
+
+/* file operation tables of the boot image */
+file_ops file_fop = {file_open, file_read, file_write, file_close, file_stat, file_truncate, NULL, file_pread, file_page};
+file_ops dir_fop = {dir_open, dir_read, dir_write, dir_close, dir_stat, NULL, dir_getdents, NULL, NULL};
+
+/* image_mount
+ * Description: mount the boot module image; there is a single image, so mounting it
+ *              again switches every mount of it to the new base
+ * Input: mnt: the mount
+ *        base_address: address of the image in memory
+ * Output: 0
+*/
+static int32_t image_mount (mount_t* mnt, uint32_t base_address){
+    init_filesystem(base_address);
+    mnt->data = (void*)base_address;
+    return 0;
+}
+
+/* image_lookup
+ * Description: find a file in the image and pick its file operation table by dentry type
+ * Input: mnt: the mount
+ *        path: path inside the image
+ *        vnode: filled in for open
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t image_lookup (mount_t* mnt, const uint8_t* path, vnode_t* vnode){
+    dentry_t dentry;
+
+    if(read_dentry_by_name(path, &dentry) == -1){
+        return -1;
+    }
+    vnode->file_type = dentry.file_type;
+    vnode->size = 0;
+    switch(dentry.file_type){
+    case RTC_TYPE:
+        vnode->fops = &RTC_fop;
+        vnode->inode = 0;   // RTC has no inode
+        break;
+    case DIR_TYPE:
+        vnode->fops = &dir_fop;
+        // the directory id: its inode for subdirectories, ROOT_DIR_INODE for the root
+        vnode->inode = (dentry.flags & DENTRY_DIR_INODE) ? dentry.inode_num : ROOT_DIR_INODE;
+        break;
+    case REGULAR_TYPE:
+        vnode->fops = &file_fop;
+        vnode->inode = dentry.inode_num;
+        vnode->size = file_length(dentry.inode_num);
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+/* image_create
+ * Description: create an empty regular file in the image
+ * Input: mnt: the mount
+ *        path: path inside the image
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t image_create (mount_t* mnt, const uint8_t* path){
+    return fs_create(path);
+}
+
+/* image_mkdir
+ * Description: create an empty directory in the image
+ * Input: mnt: the mount
+ *        path: path inside the image
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t image_mkdir (mount_t* mnt, const uint8_t* path){
+    return fs_mkdir(path);
+}
+
+/* image_unlink
+ * Description: remove a regular file or an empty directory from the image
+ * Input: mnt: the mount
+ *        path: path inside the image
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t image_unlink (mount_t* mnt, const uint8_t* path){
+    return fs_delete(path);
+}
+
+/* disk_mount
+ * Description: mount the image stored on a disk
+ * Input: mnt: the mount
+ *        dev: block_dev_t of the disk
+ * Output: 0 for success, -1 if the disk holds no usable image
+*/
+static int32_t disk_mount (mount_t* mnt, uint32_t dev){
+    if(init_filesystem_disk((block_dev_t*)dev) == -1){
+        return -1;
+    }
+    mnt->data = disk_meta;
+    return 0;
+}
+
+fs_type_t image_fs_type = {"image", image_mount, image_lookup, image_create, image_mkdir, image_unlink};
+fs_type_t disk_fs_type = {"disk", disk_mount, image_lookup, image_create, image_mkdir, image_unlink};
@@ -3,18 +3,49 @@
 
 #include "types.h"
 #include "lib.h"
+#include "blkdev.h"
 
 #define FILENAME_LEN            32
-#define DENTRY_RESERVED         24
-#define BOOT_BLOCK_RESERVED     52
+#define DENTRY_RESERVED         16
+#define BOOT_BLOCK_RESERVED     48
 #define DENTRY_NUM              64 
 #define BLOCK_SIZE              4096
 #define DATA_BLOCK_NUM          1023
+#define FS_VERSION_INDIRECT     2       // boot_block_t.version of images whose inodes have indirect blocks
+#define DIRECT_BLOCK_NUM        1021    // direct entries of a version 2 inode
+#define SINGLE_INDIRECT         1021    // data_block_num index of the single indirect block
+#define DOUBLE_INDIRECT         1022    // data_block_num index of the double indirect block
+#define PTRS_PER_BLOCK          (BLOCK_SIZE / 4)    // block numbers held by one indirect block
+#define BLOCK_NONE              0xFFFFFFFF
+#define DENTRY_HASH_SIZE        8192    // power of two, at least twice MAX_INDEXED_DENTRIES
+#define DENTRY_HASH_EMPTY       0xFFFF  // marks an unused slot in the dentry index
+#define MAX_INDEXED_DENTRIES    4096    // dentries of every directory; past this lookups scan
+#define DENTRIES_PER_BLOCK      (BLOCK_SIZE / sizeof(dentry_t))
+#define ROOT_DIR_INODE          0       // directory id of the boot block directory
+#define PATH_SEPARATOR          '/'
+#define MAX_EXTENTS             1024    // contiguous block runs tracked across all inodes
+#define MAX_EXTENT_INODES       256     // inodes past this always use the per-block read path
+#define MAX_DATA_BLOCKS         8192    // data blocks tracked by the block bitmap (32MB)
+#define MAX_INODES              4096    // inodes tracked by the inode bitmap
+#define BITMAP_BITS             32      // bits per bitmap word
+#define BITMAP_FULL             0xFFFFFFFF
+#define DENTRY_COMPRESSED       0x1     // dentry_t.flags: the file is stored as LZ4 chunks
+#define DENTRY_DIR_INODE        0x2     // dentry_t.flags: a directory whose dentries are in its inode
+#define MAX_BLOCK_SHARES        255     // block_shares saturates here and the block is never freed
+#define NAME_TABLE_MAGIC        0x4E4D5442  // name_table_t.magic of images with a name table
+#define NAME_SLOT_EMPTY         0xFFFF      // name_slot_t.index of an unused slot
+#define NAME_SLOTS_PER_BLOCK    (BLOCK_SIZE / sizeof(name_slot_t))
+#define FS_DISK_MAX_INODES      64      // inodes of the largest image init_filesystem_disk mounts
+#define SECTORS_PER_BLOCK       (BLOCK_SIZE / SECTOR_SIZE)
+#define CHUNK_CACHE_SIZE        8       // decompressed blocks kept by read_data
+#define COPY_CHUNK              256     // bytes staged on the kernel stack between a user buffer and a file
 
 typedef struct dentry{
     int8_t filename[FILENAME_LEN];
     int32_t file_type;
     int32_t inode_num;
+    int32_t flags;          //DENTRY_COMPRESSED or DENTRY_DIR_INODE, 0 in original images
+    int32_t raw_length;     //decompressed length of a compressed file
     int8_t reserved[DENTRY_RESERVED];
 }dentry_t;
 
@@ -23,15 +54,89 @@ typedef struct boot_block
     int32_t dir_count;
     int32_t inode_count;
     int32_t data_count;
+    int32_t version;        //0 in original images, FS_VERSION_INDIRECT for indirect blocks
     int8_t reserved[BOOT_BLOCK_RESERVED];
     dentry_t direntries[DENTRY_NUM - 1];
 }boot_block_t;
 
+/* precomputed dentry index written by tools/createfs, kept at the start of
+   boot_block_t.reserved. The table is num_slots name_slot_t in num_blocks data blocks
+   starting at first_block, open addressed with linear probing on the same
+   (directory, filename) hash as the in-memory index. Original images leave reserved
+   zeroed, so magic does not match and the kernel builds its own index at mount */
+typedef struct name_table {
+    uint32_t magic;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    uint32_t num_slots;     //power of two, more than num_entries
+    uint32_t num_entries;
+    uint32_t checksum;      //of the slots, see name_table_checksum
+} name_table_t;
+
+/* one slot of the on-image name table */
+typedef struct name_slot {
+    uint32_t hash;          //full (directory, filename) hash, compared before the name
+    uint16_t dir;           //directory id
+    uint16_t index;         //index of the dentry in the directory, NAME_SLOT_EMPTY if unused
+} name_slot_t;
+
+/* one slot of the dentry index */
+typedef struct dentry_index {
+    uint32_t dir;                   //directory id: ROOT_DIR_INODE or a DENTRY_DIR_INODE inode
+    dentry_t* dentry;
+} dentry_index_t;
+
+/* a subdirectory is a DIR_TYPE dentry with DENTRY_DIR_INODE set. Its inode holds a packed
+   array of dentry_t, DENTRIES_PER_BLOCK per data block, and its length is the number of
+   entries times sizeof(dentry_t). Inode ROOT_DIR_INODE is never given to a subdirectory */
+
+/* one decompressed chunk of a compressed file */
+typedef struct chunk_cache {
+    int32_t inode;                  //-1 for an empty slot
+    uint32_t chunk;
+    uint8_t data[BLOCK_SIZE];
+} chunk_cache_t;
+
+/* a compressed file stores raw_length bytes as one chunk per BLOCK_SIZE bytes. Its data
+   starts with (chunks + 1) uint32_t offsets from the start of the file, and chunk i spans
+   [offset i, offset i + 1). A chunk as long as its raw data is stored uncompressed,
+   otherwise it is an LZ4 block */
+
+/* in version 2 images the last two entries of data_block_num are the single and
+   double indirect blocks instead of direct blocks */
 typedef struct inode {
     int32_t length;
     int32_t data_block_num [DATA_BLOCK_NUM];
 } inode_t;
 
+/* one packed entry returned by getdents */
+typedef struct dirent {
+    int8_t filename[FILENAME_LEN];  //not null terminated if the name is 32 chars long
+    int32_t file_type;
+    int32_t inode_num;
+    int32_t size;                   //length in bytes for regular files, 0 otherwise
+} dirent_t;
+
+/* file information returned by stat and fstat */
+typedef struct stat {
+    int32_t file_type;
+    int32_t inode_num;
+    int32_t size;                   //length in bytes for regular files, 0 otherwise
+} stat_t;
+
+/* a run of physically contiguous data blocks in one file */
+typedef struct extent {
+    uint32_t file_block;    // index of the first block within the file
+    uint32_t data_block;    // data block number of the first block in the image
+    uint32_t count;         // number of blocks in the run
+} extent_t;
+
+/* extents of one inode, stored consecutively in the extent table */
+typedef struct extent_map {
+    uint16_t first;         // index of the first extent
+    uint16_t count;         // number of extents, 0 if the inode has no extent map
+} extent_map_t;
+
 dentry_t* dentry_ptr;
 boot_block_t* boot_block_ptr;
 inode_t* inode_ptr;
@@ -41,6 +146,8 @@ dentry_t curr_dentry;
 
 extern void init_filesystem(unsigned int base_address);
 
+extern int32_t init_filesystem_disk(block_dev_t* dev);
+
 extern int32_t file_open(const uint8_t* fname);
 
 extern int32_t file_close(int32_t fd);
@@ -57,10 +164,44 @@ extern int32_t dir_write (int32_t fd,const void* buf, int32_t nbytes);
 
 extern int32_t dir_read (int32_t fd, void* buf, int32_t nbytes);
 
+extern int32_t fs_stat (const dentry_t* dentry, stat_t* buf);
+
+extern int32_t dir_getdents (int32_t fd, void* buf, int32_t nbytes);
+
 extern int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 
+extern int32_t read_dentry_by_scan (const uint8_t* fname, dentry_t* dentry);
+
 extern int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 
 extern int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
+extern int32_t read_data_by_block (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+
+extern uint32_t file_length (uint32_t inode);
+
+extern uint8_t* file_block_ptr (uint32_t inode, uint32_t block_index);
+
+extern int32_t write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
+extern int32_t fs_create (const uint8_t* fname);
+
+extern int32_t fs_delete (const uint8_t* fname);
+
+extern int32_t fs_mkdir (const uint8_t* path);
+
+extern int32_t file_stat (int32_t fd, stat_t* buf);
+
+extern int32_t file_truncate (int32_t fd, uint32_t length);
+
+extern int32_t file_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+extern uint8_t* file_page (int32_t fd, uint32_t page_index);
+
+extern int32_t dir_stat (int32_t fd, stat_t* buf);
+
+extern int32_t fs_truncate (uint32_t inode, uint32_t length);
+
+extern int32_t verify_name_table ();
+
 #endif
@@ -30,6 +30,11 @@
  * to declare the interrupt finished */
 #define PIC_EOI             0x60
 
+#define NUM_IRQS            16
+
+/* interrupts taken on each IRQ line since boot */
+uint32_t irq_counts[NUM_IRQS];
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
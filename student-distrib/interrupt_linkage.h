@@ -5,6 +5,13 @@
     extern void keyboard_irq_handler_linkage();
     extern void RTC_linkage();
     extern void PIT_linkage();
+    extern void ata_primary_linkage();
+    extern void ata_secondary_linkage();
+    extern void pci_irq5_linkage();
+    extern void pci_irq9_linkage();
+    extern void pci_irq10_linkage();
+    extern void pci_irq11_linkage();
+    extern void page_fault_linkage();
 #endif
 
 #endif
@@ -16,6 +16,15 @@
 #include "filesystem.h"
 #include "system_calls.h"
 #include "PIT.h"
+#include "vfs.h"
+#include "tmpfs.h"
+#include "procfs.h"
+#include "ata.h"
+#include "pci.h"
+#include "virtio_blk.h"
+#include "buddy.h"
+#include "slab.h"
+#include "bcache.h"
 
 #define RUN_TESTS
 
@@ -28,6 +37,9 @@
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    uint32_t fs_module = 0;     //filesystem image loaded as a module, 0 if there is none
+    block_dev_t* disk;
+    uint32_t i;
 
     /* Clear the screen. */
     clear();
@@ -61,7 +73,7 @@ void entry(unsigned long magic, unsigned long addr) {
         int i;
         module_t* mod = (module_t*)mbi->mods_addr;
         
-        init_filesystem(mod->mod_start);    //initiate filesystem
+        fs_module = mod->mod_start;
 
         while (mod_count < mbi->mods_count) {
             printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
@@ -106,6 +118,11 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->length_low);
     }
 
+    /* hand the page frames above the kernel to the buddy allocator while the
+     * multiboot info in low memory is still mapped */
+    buddy_init(mbi);
+    printf("buddy allocator: %uKB free\n", buddy_stats.free_frames * (FRAME_SIZE / 1024));
+
     /* Construct an LDT entry in the GDT */
     {
         seg_desc_t the_ldt_desc;
@@ -160,12 +177,34 @@ void entry(unsigned long magic, unsigned long addr) {
 
     /* Initial paging */
     init_paging();
+    slab_init();                //kernel heap, on frames paging now maps
+    bcache_init();              //disk block buffers, also from those frames
 
     // initial terminal
     terminal_init();
     
     init_PIT();
 
+    /* mount the filesystem image from the first disk holding one, else the module */
+    pci_init();
+    ata_init();
+    virtio_blk_init();
+    register_fs_type(&image_fs_type);
+    register_fs_type(&disk_fs_type);
+    for (i = 0; (disk = block_dev_at(i)) != NULL; i++) {
+        if (vfs_mount("/", "disk", (uint32_t)disk) == 0) {
+            printf("filesystem on %s\n", disk->name);
+            break;
+        }
+    }
+    if (disk == NULL && fs_module != 0) {
+        vfs_mount("/", "image", fs_module);
+    }
+    register_fs_type(&tmpfs_fs_type);
+    vfs_mount("/tmp", "tmpfs", 0);              //scratch space for temporary output
+    register_fs_type(&procfs_fs_type);
+    vfs_mount("/proc", "proc", 0);              //kernel statistics
+
 
     
 
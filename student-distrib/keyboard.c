@@ -80,6 +80,7 @@ void keyboard_init(){
  */
 void keyboard_irq_handler(){
     // still need irq_num to send the signal
+    irq_counts[IRQ_NUM]++;
     send_eoi(IRQ_NUM);
     uint8_t scancode;
     scancode = inb(0x60) & 0xFF;   //get scancode from port 0x60
@@ -96,17 +96,39 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
     );                                  \
 } while (0)
 
+/* Reads the low 32 bits of the time-stamp counter, which is enough
+ * to time anything shorter than about a second */
+static inline uint32_t rdtsc(void) {
+    uint32_t low;
+    asm volatile ("rdtsc"
+            : "=a"(low)
+            :
+            : "edx"
+    );
+    return low;
+}
+
+/* tools/fsbench builds kernel sources into a Linux process, where cli and sti
+ * fault; nothing can interrupt it there, so they become no-ops */
+#ifdef HOST_BUILD
+#define CLI_INSN "nop"
+#define STI_INSN "nop"
+#else
+#define CLI_INSN "cli"
+#define STI_INSN "sti"
+#endif
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
-    asm volatile ("cli"                 \
+    asm volatile (CLI_INSN              \
             :                           \
             :                           \
             : "memory", "cc"            \
@@ -121,7 +143,7 @@ do {                                    \
     asm volatile ("                   \n\
             pushfl                    \n\
             popl %0                   \n\
-            cli                       \n\
+            " CLI_INSN "              \n\
             "                           \
             : "=r"(flags)               \
             :                           \
@@ -132,7 +154,7 @@ do {                                    \
 /* Set interrupt flag - enable interrupts on this processor */
 #define sti()                           \
 do {                                    \
-    asm volatile ("sti"                 \
+    asm volatile (STI_INSN              \
             :                           \
             :                           \
             : "memory", "cc"            \
@@ -1,5 +1,16 @@
 #include "paging.h"
 #include "types.h"
+#include "system_calls.h"
+#include "buddy.h"
+#include "lib.h"
+#include "tlb.h"
+
+uint32_t mapped_user_pid = 0;   // process whose page directory is in cr3
+uint32_t user_frames[USER_PT_NUM];  // 4mb physical frame of each process slot, 0 if none
+uint32_t user_brk[USER_PT_NUM];     // end of each process's heap, from ANON_ADDR up
+uint32_t anon_frames = 0;           // frames backing touched anonymous pages of all processes
+
+static PTE_t* anon_tables[USER_PT_NUM][ANON_PDES];  // page tables of the anonymous area, from the buddy allocator
 
  /* init_paging
  *   DESCIRPTION: Initialize page table and page directory
@@ -22,6 +33,10 @@ void init_paging(){
             set_pde_vidmap_kb(index, 1);
         }
 
+        else if(index >= BUDDY_MIN_ADDR >> 22 && index < BUDDY_MAX_ADDR >> 22){
+            set_pde_mb_frames(index, 1);  //kernel access to frames from the buddy allocator
+        }
+
         else{
             set_pde_mb_unused(index, 0);  //for others mark not present
         }
@@ -54,6 +69,7 @@ void init_paging(){
     : "r"(page_directory)
     : "eax"  
     );
+    tlb_enable_global();    //kernel pdes and ptes are marked global, keep them across cr3 loads
 }
 
  /* set_pde_kb
@@ -118,6 +134,28 @@ void set_pde_mb(int index, int present){
     page_directory[index].MB.table_address = 1;
 }
 
+ /* set_pde_mb_frames
+ *   DESCIRPTION: identity map a 4mb page of the buddy allocator's range for the kernel only
+ *   INPUT: index: index in the PDE
+ *          present: whther this entry is present in pythical memory
+ *   OUTPUT: none
+ */
+void set_pde_mb_frames(int index, int present){
+    page_directory[index].MB.present = present;
+    page_directory[index].MB.read_write = 1;
+    page_directory[index].MB.user_supervisor = 0;
+    page_directory[index].MB.write_through = 0;
+    page_directory[index].MB.cache_disabled = 0;
+    page_directory[index].MB.accessed = 0;
+    page_directory[index].MB.dirty = 0;
+    page_directory[index].MB.page_size = 1; //set to 1 for 4mb aligned
+    page_directory[index].MB.global = 1;    //kernel only, the same in every directory
+    page_directory[index].MB.available = 0;
+    page_directory[index].MB.attribute_index = 0;
+    page_directory[index].MB.reserved = 0;
+    page_directory[index].MB.table_address = index;
+}
+
  /* set_pde_mb_unused
  *   DESCIRPTION: set the other pde with 4mb pages and mark not present
  *   INPUT: index: index in the PDE
@@ -155,7 +193,7 @@ void set_pte(int index, int present){
     page_table[index].accessed = 0;
     page_table[index].dirty = 0;
     page_table[index].attribute_index = 0;
-    page_table[index].global = 0;
+    page_table[index].global = present;   //kernel low memory, the same in every directory
     page_table[index].available = 0;
     page_table[index].page_address = index;
 }
@@ -175,7 +213,301 @@ void set_pte_video_mem(int index, int present){
     page_table_vidmap[index].accessed = 0;
     page_table_vidmap[index].dirty = 0;
     page_table_vidmap[index].attribute_index = 0;
-    page_table_vidmap[index].global = present;
+    page_table_vidmap[index].global = 0;    //user page, remapped on every terminal switch
     page_table_vidmap[index].available = 0;
     page_table_vidmap[index].page_address = page_table[index].page_address;
 }
+
+ /* reset_user_pages
+ *   DESCIRPTION: mark every 4kb page of a process's user region not present, so the
+ *                program image is loaded page by page on first touch, and drop its mmaps
+ *   INPUT: pid: process whose page table to reset
+ *   OUTPUT: none
+ */
+void reset_user_pages(uint32_t pid){
+    int index;
+    for(index = 0; index < PTE_SIZE; index++){
+        page_table_user[pid][index].present = 0;
+        page_table_user[pid][index].read_write = 1;
+        page_table_user[pid][index].user_supervisor = 1;
+        page_table_user[pid][index].write_through = 0;
+        page_table_user[pid][index].cache_disabled = 0;
+        page_table_user[pid][index].accessed = 0;
+        page_table_user[pid][index].dirty = 0;
+        page_table_user[pid][index].attribute_index = 0;
+        page_table_user[pid][index].global = 0;
+        page_table_user[pid][index].available = 0;
+        page_table_user[pid][index].page_address = (user_frames[pid] >> 12) + index;
+        set_pte_mmap(pid, index, 0, 0);
+    }
+}
+
+ /* init_user_directory
+ *   DESCIRPTION: build a process's page directory: the kernel pdes are copied from the
+ *                kernel directory, so every process shares them, and the user region and
+ *                mmap window point at the process's own page tables
+ *   INPUT: pid: process slot
+ *   OUTPUT: none
+ */
+void init_user_directory(uint32_t pid){
+    memcpy(page_directory_user[pid], page_directory, sizeof(page_directory));
+    set_pde_user(pid, USR_ADDR >> 22, page_table_user[pid]);    //shift 22 to get pde index
+    set_pde_user(pid, MMAP_ADDR >> 22, page_table_mmap[pid]);
+    user_brk[pid] = ANON_ADDR;  //anonymous area tables come with the first sbrk or mmap
+}
+
+ /* set_pde_user
+ *   DESCIRPTION: point a pde of a process's own directory at a user page table
+ *   INPUT: pid: process slot
+ *          index: index in the PDE
+ *          table: 4kb page table of user pages
+ *   OUTPUT: none
+ */
+void set_pde_user(uint32_t pid, int index, PTE_t* table){
+    PDE_t* pde = &page_directory_user[pid][index];
+    pde->KB.present = 1;
+    pde->KB.read_write = 1;
+    pde->KB.user_supervisor = 1;
+    pde->KB.write_through = 0;
+    pde->KB.cache_disabled = 0;
+    pde->KB.accessed = 0;
+    pde->KB.reserved = 0;
+    pde->KB.page_size = 0;
+    pde->KB.global = 0;
+    pde->KB.available = 0;
+    pde->KB.table_address = ((uint32_t) table >> 12);
+}
+
+ /* switch_page_directory
+ *   DESCIRPTION: run on a process's page directory; loading cr3 drops its user entries
+ *                from the tlb while the global kernel ones stay
+ *   INPUT: pid: process whose directory to load
+ *   OUTPUT: none
+ */
+void switch_page_directory(uint32_t pid){
+    mapped_user_pid = pid;
+    tlb_load_cr3(page_directory_user[pid]);
+}
+
+ /* set_pte_mmap
+ *   DESCIRPTION: set a read-only user page in a process's mmap window
+ *   INPUT: pid: process owning the window
+ *          index: page index in the window
+ *          phys_addr: 4kb aligned physical address to map
+ *          present: whether the page is mapped
+ *   OUTPUT: none
+ */
+void set_pte_mmap(uint32_t pid, int index, uint32_t phys_addr, int present){
+    page_table_mmap[pid][index].present = present;
+    page_table_mmap[pid][index].read_write = 0;
+    page_table_mmap[pid][index].user_supervisor = 1;
+    page_table_mmap[pid][index].write_through = 0;
+    page_table_mmap[pid][index].cache_disabled = 0;
+    page_table_mmap[pid][index].accessed = 0;
+    page_table_mmap[pid][index].dirty = 0;
+    page_table_mmap[pid][index].attribute_index = 0;
+    page_table_mmap[pid][index].global = 0;
+    page_table_mmap[pid][index].available = 0;
+    page_table_mmap[pid][index].page_address = phys_addr >> 12;
+}
+
+ /* find_mmap_pages
+ *   DESCIRPTION: find the first run of unmapped pages in a process's mmap window
+ *   INPUT: pid: process owning the window
+ *          count: number of pages wanted
+ *   OUTPUT: index of the first page of the run, -1 if no run is long enough
+ */
+int32_t find_mmap_pages(uint32_t pid, uint32_t count){
+    uint32_t index;
+    uint32_t run = 0;
+    for(index = 0; index < PTE_SIZE && count > 0; index++){
+        run = page_table_mmap[pid][index].present ? 0 : run + 1;
+        if(run == count){
+            return index - count + 1;
+        }
+    }
+    return -1;
+}
+
+ /* alloc_user_frame
+ *   DESCIRPTION: get a process slot a 4mb physical frame for its user region from the
+ *                buddy allocator, 4mb aligned
+ *   INPUT: pid: process slot
+ *   OUTPUT: 0 for success, -1 if no 4mb block is free
+ */
+int32_t alloc_user_frame(uint32_t pid){
+    if(user_frames[pid] == 0){
+        user_frames[pid] = buddy_alloc(ORDER_4MB);
+    }
+    return (user_frames[pid] != 0) ? 0 : -1;
+}
+
+ /* free_user_frame
+ *   DESCIRPTION: give a process slot's user frame back to the buddy allocator
+ *   INPUT: pid: process slot
+ *   OUTPUT: none
+ */
+void free_user_frame(uint32_t pid){
+    if(user_frames[pid] != 0){
+        buddy_free(user_frames[pid], ORDER_4MB);
+        user_frames[pid] = 0;
+    }
+}
+
+ /* anon_pte
+ *   DESCIRPTION: find the pte of a page in a process's anonymous area, optionally making
+ *                the page table that holds it
+ *   INPUT: pid: process slot
+ *          addr: address in [ANON_ADDR, ANON_END)
+ *          create: 1 to make a missing page table, 0 to return NULL for it
+ *   OUTPUT: the pte, NULL if its table is missing and not made
+ */
+static PTE_t* anon_pte(uint32_t pid, uint32_t addr, int create){
+    uint32_t table = (addr - ANON_ADDR) >> 22;
+    if(anon_tables[pid][table] == NULL){
+        if(!create || (anon_tables[pid][table] = (PTE_t*)buddy_alloc(ORDER_4KB)) == NULL){
+            return NULL;
+        }
+        memset(anon_tables[pid][table], 0, PAGE_SIZE);
+        set_pde_user(pid, addr >> 22, anon_tables[pid][table]);    //was not present, nothing to flush
+    }
+    return &anon_tables[pid][table][(addr >> 12) & (PTE_SIZE - 1)];
+}
+
+ /* anon_range_free
+ *   DESCIRPTION: check that no page of a range of the anonymous area is in use
+ *   INPUT: pid: process slot
+ *          addr: page aligned start, at least ANON_ADDR
+ *          count: number of pages, ending by ANON_END
+ *   OUTPUT: 1 if all are free, 0 if not
+ */
+int32_t anon_range_free(uint32_t pid, uint32_t addr, uint32_t count){
+    PTE_t* pte;
+    for(; count > 0; count--, addr += PAGE_SIZE){
+        if((pte = anon_pte(pid, addr, 0)) != NULL && (pte->present || pte->available)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+ /* anon_find
+ *   DESCIRPTION: find the highest run of free pages between a process's heap and ANON_END,
+ *                so mappings grow down towards the heap
+ *   INPUT: pid: process slot
+ *          count: number of pages wanted
+ *   OUTPUT: address of the run, 0 if none is long enough
+ */
+uint32_t anon_find(uint32_t pid, uint32_t count){
+    uint32_t low = (user_brk[pid] + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t addr, run = 0;
+    PTE_t* pte;
+
+    for(addr = ANON_END; addr > low && count > 0; ){
+        addr -= PAGE_SIZE;
+        pte = anon_pte(pid, addr, 0);
+        run = (pte != NULL && (pte->present || pte->available)) ? 0 : run + 1;
+        if(run == count){
+            return addr;
+        }
+    }
+    return 0;
+}
+
+ /* anon_reserve
+ *   DESCIRPTION: let a process touch a range of its anonymous area; each page gets a
+ *                zeroed frame on its first fault, so untouched pages cost nothing
+ *   INPUT: pid: process slot
+ *          addr: page aligned start of a free range
+ *          count: number of pages
+ *   OUTPUT: 0 for success, -1 if a page table could not be made
+ */
+int32_t anon_reserve(uint32_t pid, uint32_t addr, uint32_t count){
+    uint32_t i;
+    PTE_t* pte;
+
+    for(i = 0; i < count; i++){
+        if((pte = anon_pte(pid, addr + i * PAGE_SIZE, 1)) == NULL){
+            anon_release(pid, addr, i);
+            return -1;
+        }
+        pte->val = 0;
+        pte->available = PTE_ANON;
+    }
+    return 0;
+}
+
+ /* anon_release
+ *   DESCIRPTION: take a range of a process's anonymous area away from it, giving the
+ *                frames of touched pages back to the buddy allocator
+ *   INPUT: pid: process slot
+ *          addr: page aligned start
+ *          count: number of pages
+ *   OUTPUT: none
+ */
+void anon_release(uint32_t pid, uint32_t addr, uint32_t count){
+    uint32_t flags;
+    PTE_t* pte;
+
+    cli_and_save(flags);
+    for(; count > 0; count--, addr += PAGE_SIZE){
+        if((pte = anon_pte(pid, addr, 0)) == NULL){
+            continue;
+        }
+        if(pte->present){
+            buddy_free(pte->page_address << 12, ORDER_4KB);
+            anon_frames--;
+            tlb_batch_add(addr);
+        }
+        pte->val = 0;
+    }
+    tlb_batch_flush();
+    restore_flags(flags);
+}
+
+ /* anon_fault
+ *   DESCIRPTION: page fault handler for the anonymous area, backs a reserved page with a
+ *                zeroed frame
+ *   INPUT: pid: process whose directory is loaded
+ *          addr: faulting address in [ANON_ADDR, ANON_END)
+ *   OUTPUT: 0 if the page was mapped, -1 if it is not reserved or memory is out
+ */
+int32_t anon_fault(uint32_t pid, uint32_t addr){
+    PTE_t* pte = anon_pte(pid, addr, 0);
+    uint32_t frame;
+
+    if(pte == NULL || pte->present || !(pte->available & PTE_ANON)){
+        return -1;
+    }
+    if((frame = buddy_alloc(ORDER_4KB)) == 0){
+        return -1;
+    }
+    memset((void*)frame, 0, PAGE_SIZE);    //frames are identity mapped for the kernel
+    pte->page_address = frame >> 12;
+    pte->user_supervisor = 1;
+    pte->read_write = 1;
+    pte->present = 1;   //not present entries are never cached, so no flush
+    anon_frames++;
+    return 0;
+}
+
+ /* free_anon_pages
+ *   DESCIRPTION: give every frame and page table of a process's anonymous area back to
+ *                the buddy allocator
+ *   INPUT: pid: process slot
+ *   OUTPUT: none
+ */
+void free_anon_pages(uint32_t pid){
+    uint32_t table;
+
+    for(table = 0; table < ANON_PDES; table++){
+        if(anon_tables[pid][table] == NULL){
+            continue;
+        }
+        anon_release(pid, ANON_ADDR + (table << 22), PTE_SIZE);
+        page_directory_user[pid][(ANON_ADDR >> 22) + table].KB.present = 0;
+        buddy_free((uint32_t)anon_tables[pid][table], ORDER_4KB);
+        anon_tables[pid][table] = NULL;
+    }
+    user_brk[pid] = ANON_ADDR;
+}
@@ -7,6 +7,13 @@
 #define PTE_SIZE    1024
 #define VIDEO_ADDR  0xB8000
 #define _132MB      0x8400000
+#define USER_PT_NUM 6           // one user page table per process slot
+#define MMAP_ADDR   0x08800000  // 4MB window for mmap, right after the vidmap page table
+#define PAGE_SIZE   4096
+#define ANON_ADDR   0x09000000  // heap from here up, anonymous mmaps from ANON_END down
+#define ANON_END    0x10000000
+#define ANON_PDES   ((ANON_END - ANON_ADDR) >> 22)
+#define PTE_ANON    1           // available bits of a not present pte the process may touch
 
 typedef union PDE_4MB_t {
     uint32_t val;
@@ -70,13 +77,36 @@ typedef union PTE_t {
 PDE_t page_directory[PDE_SIZE] __attribute__((aligned (4096)));
 PTE_t page_table[PTE_SIZE] __attribute__((aligned (4096)));
 PTE_t page_table_vidmap[PTE_SIZE] __attribute__((aligned (4096)));
+PTE_t page_table_user[USER_PT_NUM][PTE_SIZE] __attribute__((aligned (4096)));
+PTE_t page_table_mmap[USER_PT_NUM][PTE_SIZE] __attribute__((aligned (4096)));
+PDE_t page_directory_user[USER_PT_NUM][PDE_SIZE] __attribute__((aligned (4096)));
+
+extern uint32_t mapped_user_pid;
+extern uint32_t user_frames[USER_PT_NUM];
+extern uint32_t user_brk[USER_PT_NUM];
+extern uint32_t anon_frames;
 
 extern void init_paging();
 void set_pde_kb(int index, int present);
 void set_pde_vidmap_kb(int index, int present);
 void set_pde_mb(int index, int present);
+void set_pde_mb_frames(int index, int present);
 void set_pde_mb_unused(int index, int present);
 void set_pte_video_mem(int index, int present);
 void set_pte(int index, int present);
+void reset_user_pages(uint32_t pid);
+void init_user_directory(uint32_t pid);
+void set_pde_user(uint32_t pid, int index, PTE_t* table);
+void switch_page_directory(uint32_t pid);
+void set_pte_mmap(uint32_t pid, int index, uint32_t phys_addr, int present);
+int32_t find_mmap_pages(uint32_t pid, uint32_t count);
+int32_t alloc_user_frame(uint32_t pid);
+void free_user_frame(uint32_t pid);
+int32_t anon_range_free(uint32_t pid, uint32_t addr, uint32_t count);
+uint32_t anon_find(uint32_t pid, uint32_t count);
+int32_t anon_reserve(uint32_t pid, uint32_t addr, uint32_t count);
+void anon_release(uint32_t pid, uint32_t addr, uint32_t count);
+int32_t anon_fault(uint32_t pid, uint32_t addr);
+void free_anon_pages(uint32_t pid);
 
 #endif
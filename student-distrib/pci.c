@@ -0,0 +1,188 @@
+/* pci.c - PCI configuration space access through the 0xCF8/0xCFC mechanism
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pci.h"
+#include "lib.h"
+#include "i8259.h"
+
+pci_dev_t pci_devices[PCI_MAX_FOUND];
+uint32_t pci_num_devices;
+
+static pci_irq_handler_t irq_handlers[NUM_IRQS][PCI_IRQ_HANDLERS];
+static void* irq_data[NUM_IRQS][PCI_IRQ_HANDLERS];
+
+/* pci_config_read
+ * Description: read one dword of a function's configuration space
+ * Input: addr: the function
+ *        offset: byte offset, a multiple of 4
+ * Output: the dword, all ones if there is no such function
+*/
+uint32_t pci_config_read (pci_addr_t addr, uint32_t offset){
+    outl(PCI_ENABLE | (addr.bus << 16) | (addr.device << 11) | (addr.function << 8) | (offset & 0xFC),
+         PCI_CONFIG_ADDRESS);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/* pci_config_write
+ * Description: write one dword of a function's configuration space
+ * Input: addr: the function
+ *        offset: byte offset, a multiple of 4
+ *        value: dword to write
+ * Output: none
+*/
+void pci_config_write (pci_addr_t addr, uint32_t offset, uint32_t value){
+    outl(PCI_ENABLE | (addr.bus << 16) | (addr.device << 11) | (addr.function << 8) | (offset & 0xFC),
+         PCI_CONFIG_ADDRESS);
+    outl(value, PCI_CONFIG_DATA);
+}
+
+/* pci_init
+ * Description: enumerate every bus, device and function and record what is there
+ * Input: none
+ * Output: none
+ * Side effect: fills pci_devices; functions past PCI_MAX_FOUND are ignored
+*/
+void pci_init (){
+    pci_addr_t curr;
+    pci_dev_t* found;
+    uint32_t bus, device, function, id, class_reg;
+
+    pci_num_devices = 0;
+    for(bus = 0; bus < PCI_MAX_BUSES; bus++){
+        for(device = 0; device < PCI_MAX_DEVICES; device++){
+            for(function = 0; function < PCI_MAX_FUNCTIONS; function++){
+                curr.bus = bus;
+                curr.device = device;
+                curr.function = function;
+                id = pci_config_read(curr, PCI_VENDOR_ID);
+                if((id & 0xFFFF) == PCI_VENDOR_NONE){
+                    if(function == 0){
+                        break;  //empty slot
+                    }
+                    continue;
+                }
+                if(pci_num_devices < PCI_MAX_FOUND){
+                    class_reg = pci_config_read(curr, PCI_CLASS);
+                    found = &pci_devices[pci_num_devices++];
+                    found->addr = curr;
+                    found->vendor_id = id & 0xFFFF;
+                    found->device_id = id >> 16;
+                    found->class_code = class_reg >> 24;
+                    found->subclass = (class_reg >> 16) & 0xFF;
+                    found->prog_if = (class_reg >> 8) & 0xFF;
+                    found->irq = pci_config_read(curr, PCI_INTERRUPT_LINE) & 0xFF;
+                    if(found->irq >= NUM_IRQS){
+                        found->irq = PCI_IRQ_NONE;
+                    }
+                }
+                if(function == 0 && !((pci_config_read(curr, PCI_HEADER_TYPE) >> 16) & PCI_MULTIFUNCTION)){
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* pci_find_class
+ * Description: find the first function with a class and subclass
+ * Input: class_code: base class, e.g. 0x01 for mass storage
+ *        subclass: subclass, e.g. 0x01 for IDE
+ *        addr: set to the function found
+ * Output: 0 if one was found, -1 if not
+*/
+int32_t pci_find_class (uint32_t class_code, uint32_t subclass, pci_addr_t* addr){
+    uint32_t i;
+
+    for(i = 0; i < pci_num_devices; i++){
+        if(pci_devices[i].class_code == class_code && pci_devices[i].subclass == subclass){
+            *addr = pci_devices[i].addr;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* pci_find_device
+ * Description: find a function by vendor and device id
+ * Input: vendor_id: vendor, e.g. 0x1AF4 for virtio
+ *        device_id: device
+ *        index: 0 for the first match, 1 for the second, ...
+ * Output: the function, NULL if there are not that many
+*/
+pci_dev_t* pci_find_device (uint32_t vendor_id, uint32_t device_id, uint32_t index){
+    uint32_t i;
+
+    for(i = 0; i < pci_num_devices; i++){
+        if(pci_devices[i].vendor_id == vendor_id && pci_devices[i].device_id == device_id && index-- == 0){
+            return &pci_devices[i];
+        }
+    }
+    return NULL;
+}
+
+/* pci_request_irq
+ * Description: have an interrupt line call a driver; PCI lines can be shared, so every
+ *              handler on the line is called on each interrupt
+ * Input: irq: line from pci_dev_t.irq, one of 5, 9, 10 and 11
+ *        handler: called with data on each interrupt of the line
+ *        data: passed to handler
+ * Output: 0 for success, -1 if the line has no linkage or too many handlers
+ * Side effect: unmasks the line
+*/
+int32_t pci_request_irq (uint32_t irq, pci_irq_handler_t handler, void* data){
+    uint32_t i, flags;
+
+    if(irq >= NUM_IRQS || (irq != 5 && irq != 9 && irq != 10 && irq != 11)){
+        return -1;
+    }
+    cli_and_save(flags);
+    for(i = 0; i < PCI_IRQ_HANDLERS && irq_handlers[irq][i] != NULL; i++);
+    if(i == PCI_IRQ_HANDLERS){
+        restore_flags(flags);
+        return -1;
+    }
+    irq_data[irq][i] = data;
+    irq_handlers[irq][i] = handler;
+    restore_flags(flags);
+    enable_irq(irq);
+    return 0;
+}
+
+/* pci_irq
+ * Description: run every handler of a shared line, then acknowledge the PIC. The PIC
+ *              only sees edges, so stopping at the first device that claims the
+ *              interrupt could leave another one's request unserviced for good
+ * Input: irq: the line
+ * Output: none
+*/
+static void pci_irq(uint32_t irq){
+    uint32_t i;
+
+    irq_counts[irq]++;
+    for(i = 0; i < PCI_IRQ_HANDLERS && irq_handlers[irq][i] != NULL; i++){
+        irq_handlers[irq][i](irq_data[irq][i]);
+    }
+    send_eoi(irq);
+}
+
+/* pci_irq5_handler, pci_irq9_handler, pci_irq10_handler, pci_irq11_handler
+ * Description: the lines the firmware may route PCI interrupts to
+ * Input: none
+ * Output: none
+*/
+void pci_irq5_handler (){
+    pci_irq(5);
+}
+
+void pci_irq9_handler (){
+    pci_irq(9);
+}
+
+void pci_irq10_handler (){
+    pci_irq(10);
+}
+
+void pci_irq11_handler (){
+    pci_irq(11);
+}
@@ -0,0 +1,80 @@
+/* pci.h - PCI configuration space access
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PCI_H
+#define _PCI_H
+
+#include "types.h"
+
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_ENABLE          0x80000000  // CONFIG_ADDRESS bit that starts a configuration cycle
+#define PCI_MAX_BUSES       256
+#define PCI_MAX_DEVICES     32          // per bus
+#define PCI_MAX_FUNCTIONS   8           // per device
+#define PCI_VENDOR_NONE     0xFFFF      // vendor id read back from an empty slot
+#define PCI_MAX_FOUND       32          // functions pci_init records
+#define PCI_IRQ_HANDLERS    4           // drivers sharing one interrupt line
+#define PCI_IRQ_NONE        0xFF        // interrupt line of a function without one
+
+/* configuration space offsets */
+#define PCI_VENDOR_ID       0x00
+#define PCI_COMMAND         0x04
+#define PCI_CLASS           0x08        // revision, prog if, subclass, class
+#define PCI_HEADER_TYPE     0x0C        // byte 2 of the dword
+#define PCI_BAR0            0x10
+#define PCI_BAR4            0x20
+#define PCI_INTERRUPT_LINE  0x3C
+
+#define PCI_COMMAND_IO      0x0001      // respond to I/O space accesses
+#define PCI_COMMAND_MASTER  0x0004      // allow the device to do DMA
+#define PCI_MULTIFUNCTION   0x80        // header type bit: functions 1-7 may exist
+#define PCI_BAR_IO          0x1         // BAR bit 0: an I/O port range rather than memory
+#define PCI_BAR_IO_MASK     0xFFFFFFFC
+
+/* location of one function on the bus */
+typedef struct pci_addr {
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+} pci_addr_t;
+
+/* a function found by pci_init */
+typedef struct pci_dev {
+    pci_addr_t addr;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq;                    //PIC line the firmware routed INTx to, PCI_IRQ_NONE if none
+} pci_dev_t;
+
+/* a driver's interrupt handler; returns nonzero if its device raised the interrupt */
+typedef uint32_t (*pci_irq_handler_t) (void* data);
+
+extern pci_dev_t pci_devices[PCI_MAX_FOUND];
+extern uint32_t pci_num_devices;
+
+extern uint32_t pci_config_read (pci_addr_t addr, uint32_t offset);
+
+extern void pci_config_write (pci_addr_t addr, uint32_t offset, uint32_t value);
+
+extern void pci_init ();
+
+extern int32_t pci_find_class (uint32_t class_code, uint32_t subclass, pci_addr_t* addr);
+
+extern pci_dev_t* pci_find_device (uint32_t vendor_id, uint32_t device_id, uint32_t index);
+
+extern int32_t pci_request_irq (uint32_t irq, pci_irq_handler_t handler, void* data);
+
+extern void pci_irq5_handler ();
+
+extern void pci_irq9_handler ();
+
+extern void pci_irq10_handler ();
+
+extern void pci_irq11_handler ();
+
+#endif /* _PCI_H */
@@ -0,0 +1,543 @@
+#include "procfs.h"
+#include "system_calls.h"
+#include "scheduler.h"
+#include "terminal.h"
+#include "i8259.h"
+#include "IDT.h"
+#include "PIT.h"
+#include "tmpfs.h"
+#include "bcache.h"
+#include "buddy.h"
+#include "slab.h"
+#include "tlb.h"
+#include "paging.h"
+#include "lib.h"
+
+/* snapshots are per (pid, fd) so every open file reads a text that does not change under it;
+ * they come from snapshot_cache on the first read and go back on close */
+static proc_snapshot_t* snapshots[MAX_PROCESS][MAX_FILES];
+static slab_cache_t* snapshot_cache;
+
+/* names of the IRQ lines with a driver, NULL for the others */
+static const int8_t* irq_names[NUM_IRQS] = {"pit", "keyboard", NULL, NULL, NULL, NULL, NULL, NULL, "rtc"};
+
+/* one row of the processes file, copied out of the PCB */
+typedef struct proc_row {
+    uint32_t pid;
+    uint32_t parent;
+    uint32_t term;
+    uint32_t fds;
+    uint32_t exe_inode;
+    uint32_t exe_length;
+    int8_t arg[FILENAME_LEN + 1];
+} proc_row_t;
+
+/* snap_puts
+ * Description: append a string to a snapshot, dropping what does not fit
+ * Input: snap: the snapshot
+ *        s: string to append
+ * Output: none
+*/
+static void snap_puts(proc_snapshot_t* snap, const int8_t* s){
+    while(*s != '\0' && snap->length < PROC_BUF_SIZE){
+        snap->text[snap->length++] = *s++;
+    }
+}
+
+/* snap_putu
+ * Description: append an unsigned number to a snapshot, right aligned
+ * Input: snap: the snapshot
+ *        value: number to append
+ *        width: columns to pad to, 0 for none
+ * Output: none
+*/
+static void snap_putu(proc_snapshot_t* snap, uint32_t value, uint32_t width){
+    int8_t num[PROC_NUM_WIDTH + 2];
+    uint32_t len;
+
+    itoa(value, num, 10);
+    for(len = strlen(num); len < width; len++){
+        snap_puts(snap, " ");
+    }
+    snap_puts(snap, num);
+}
+
+/* gen_processes
+ * Description: write the process table, one row per running process
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_processes(proc_snapshot_t* snap){
+    proc_row_t rows[MAX_PROCESS];
+    uint32_t i, j, count = 0, flags;
+    PCB* pcb;
+
+    cli_and_save(flags);    //copy only, format with interrupts back on
+    for(i = 0; i < MAX_PROCESS; i++){
+        if(pid_array[i] == 0){
+            continue;
+        }
+        pcb = get_pcb(i);
+        rows[count].pid = i;
+        rows[count].parent = pcb->parent_process_ID;
+        rows[count].term = pcb->term_ID;
+        rows[count].exe_inode = pcb->exe_inode;
+        rows[count].exe_length = pcb->exe_length;
+        rows[count].fds = 0;
+        for(j = 0; j < MAX_FILES; j++){
+            rows[count].fds += (pcb->fda[j].flag != 0);
+        }
+        memcpy(rows[count].arg, pcb->arg, FILENAME_LEN);
+        rows[count].arg[FILENAME_LEN] = '\0';
+        count++;
+    }
+    restore_flags(flags);
+
+    snap_puts(snap, "       pid    parent      term       fds     inode    length args\n");
+    for(i = 0; i < count; i++){
+        snap_putu(snap, rows[i].pid, PROC_NUM_WIDTH);
+        snap_putu(snap, rows[i].parent, PROC_NUM_WIDTH);
+        snap_putu(snap, rows[i].term, PROC_NUM_WIDTH);
+        snap_putu(snap, rows[i].fds, PROC_NUM_WIDTH);
+        snap_putu(snap, rows[i].exe_inode, PROC_NUM_WIDTH);
+        snap_putu(snap, rows[i].exe_length, PROC_NUM_WIDTH);
+        snap_puts(snap, " ");
+        snap_puts(snap, rows[i].arg);
+        snap_puts(snap, "\n");
+    }
+}
+
+/* gen_terminals
+ * Description: write the state of each terminal; '*' marks the one on screen
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_terminals(proc_snapshot_t* snap){
+    terminal_t terms[NUM_TERMS];
+    uint32_t ticks[NUM_TERMS];
+    int32_t shown, i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(terms, terminals, sizeof(terms));
+    memcpy(ticks, term_ticks, sizeof(ticks));
+    shown = curr_term_index;
+    restore_flags(flags);
+
+    snap_puts(snap, "      term       pid     shell  cursor_x  cursor_y  line_len     ticks\n");
+    for(i = 0; i < NUM_TERMS; i++){
+        snap_putu(snap, i, PROC_NUM_WIDTH);
+        snap_putu(snap, terms[i].active_pid, PROC_NUM_WIDTH);
+        snap_putu(snap, terms[i].shell_on, PROC_NUM_WIDTH);
+        snap_putu(snap, terms[i].cursor_x, PROC_NUM_WIDTH);
+        snap_putu(snap, terms[i].cursor_y, PROC_NUM_WIDTH);
+        snap_putu(snap, terms[i].buf_index, PROC_NUM_WIDTH);
+        snap_putu(snap, ticks[i], PROC_NUM_WIDTH);
+        snap_puts(snap, (i == shown) ? " *\n" : "\n");
+    }
+}
+
+/* gen_interrupts
+ * Description: write the interrupt count of every IRQ line with a driver or any
+ *              interrupts, then the page fault count
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_interrupts(proc_snapshot_t* snap){
+    uint32_t counts[NUM_IRQS];
+    uint32_t faults, i, flags;
+
+    cli_and_save(flags);
+    memcpy(counts, irq_counts, sizeof(counts));
+    faults = page_fault_count;
+    restore_flags(flags);
+
+    for(i = 0; i < NUM_IRQS; i++){
+        if(irq_names[i] == NULL && counts[i] == 0){
+            continue;
+        }
+        snap_puts(snap, "irq");
+        snap_putu(snap, i, 0);
+        snap_puts(snap, (i < 10) ? "  " : " ");
+        snap_putu(snap, counts[i], PROC_NUM_WIDTH);
+        snap_puts(snap, " ");
+        snap_puts(snap, (irq_names[i] != NULL) ? irq_names[i] : "");
+        snap_puts(snap, "\n");
+    }
+    snap_puts(snap, "page_fault");
+    snap_putu(snap, faults, PROC_NUM_WIDTH);
+    snap_puts(snap, "\n");
+}
+
+/* gen_sched
+ * Description: write the scheduler tick counts, then the tlb flushes behind them
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_sched(proc_snapshot_t* snap){
+    uint32_t ticks[NUM_TERMS];
+    uint32_t total, i, flags;
+    int32_t running;
+    tlb_stats_t tlb;
+
+    cli_and_save(flags);
+    memcpy(ticks, term_ticks, sizeof(ticks));
+    total = sched_ticks;
+    running = curr_index;
+    tlb = tlb_stats;
+    restore_flags(flags);
+
+    snap_puts(snap, "hz ");
+    snap_putu(snap, PIT_FREQ, 0);
+    snap_puts(snap, "\nticks ");
+    snap_putu(snap, total, 0);
+    snap_puts(snap, "\nrunning ");
+    snap_putu(snap, running, 0);
+    for(i = 0; i < NUM_TERMS; i++){
+        snap_puts(snap, "\nterm");
+        snap_putu(snap, i, 0);
+        snap_puts(snap, " ");
+        snap_putu(snap, ticks[i], 0);
+    }
+    snap_puts(snap, "\ntlb_cr3_loads ");
+    snap_putu(snap, tlb.cr3_loads, 0);
+    snap_puts(snap, "\ntlb_page_flushes ");
+    snap_putu(snap, tlb.page_flushes, 0);
+    snap_puts(snap, "\ntlb_global_flushes ");
+    snap_putu(snap, tlb.global_flushes, 0);
+    snap_puts(snap, "\n");
+}
+
+/* gen_meminfo
+ * Description: write how much of each memory pool is in use
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_meminfo(proc_snapshot_t* snap){
+    buddy_stats_t frames;
+    uint32_t procs = 0, tmpfs_used, anon, i, flags;
+
+    cli_and_save(flags);
+    for(i = 0; i < MAX_PROCESS; i++){
+        procs += (pid_array[i] != 0);
+    }
+    tmpfs_used = tmpfs_pages_used();
+    frames = buddy_stats;
+    anon = anon_frames;
+    restore_flags(flags);
+
+    snap_puts(snap, "process_slots ");
+    snap_putu(snap, procs, 0);
+    snap_puts(snap, " of ");
+    snap_putu(snap, MAX_PROCESS, 0);
+    snap_puts(snap, "\nprocess_kb ");
+    snap_putu(snap, procs * (_4MB / 1024), 0);
+    snap_puts(snap, "\ntmpfs_pages ");
+    snap_putu(snap, tmpfs_used, 0);
+    snap_puts(snap, "\nanon_pages ");    //heap and anonymous mmap pages touched so far
+    snap_putu(snap, anon, 0);
+    snap_puts(snap, "\nframes_free ");
+    snap_putu(snap, frames.free_frames, 0);
+    snap_puts(snap, " of ");
+    snap_putu(snap, frames.total_frames, 0);
+    snap_puts(snap, "\nfree_blocks");     //per order, 4KB first
+    for(i = 0; i < BUDDY_ORDERS; i++){
+        snap_puts(snap, " ");
+        snap_putu(snap, frames.free_blocks[i], 0);
+    }
+    snap_puts(snap, "\nallocs");
+    for(i = 0; i < BUDDY_ORDERS; i++){
+        snap_puts(snap, " ");
+        snap_putu(snap, frames.allocs[i], 0);
+    }
+    snap_puts(snap, "\nsplits ");
+    snap_putu(snap, frames.splits, 0);
+    snap_puts(snap, "\nmerges ");
+    snap_putu(snap, frames.merges, 0);
+    snap_puts(snap, "\nalloc_failures ");
+    snap_putu(snap, frames.failures, 0);
+    snap_puts(snap, "\n");
+}
+
+/* gen_bcache
+ * Description: write the buffer cache counters, then the requests each disk has served
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_bcache(proc_snapshot_t* snap){
+    bcache_stats_t stats;
+    block_dev_t* dev;
+    uint32_t cached, i, flags;
+
+    cli_and_save(flags);
+    stats = bcache_stats;
+    restore_flags(flags);
+    cached = bcache_cached();
+
+    snap_puts(snap, "hits ");
+    snap_putu(snap, stats.hits, 0);
+    snap_puts(snap, "\nmisses ");
+    snap_putu(snap, stats.misses, 0);
+    snap_puts(snap, "\nwaits ");
+    snap_putu(snap, stats.waits, 0);
+    snap_puts(snap, "\nreadahead_blocks ");
+    snap_putu(snap, stats.ra_blocks, 0);
+    snap_puts(snap, "\nreadahead_hits ");
+    snap_putu(snap, stats.ra_hits, 0);
+    snap_puts(snap, "\nevictions ");
+    snap_putu(snap, stats.evictions, 0);
+    snap_puts(snap, "\ncached ");
+    snap_putu(snap, cached, 0);
+    snap_puts(snap, " of ");
+    snap_putu(snap, BCACHE_BUFFERS, 0);
+    snap_puts(snap, "\npinned ");
+    snap_putu(snap, stats.pinned, 0);
+    snap_puts(snap, "\n");
+    for(i = 0; (dev = block_dev_at(i)) != NULL; i++){
+        snap_puts(snap, dev->name);
+        snap_puts(snap, " reads ");
+        snap_putu(snap, dev->reads, 0);
+        snap_puts(snap, " sectors ");
+        snap_putu(snap, dev->sectors_read, 0);
+        snap_puts(snap, "\n");
+    }
+}
+
+/* gen_slabinfo
+ * Description: write the counters of each slab cache, then those of large kmalloc blocks
+ * Input: snap: snapshot to fill
+ * Output: none
+*/
+static void gen_slabinfo(proc_snapshot_t* snap){
+    slab_cache_t caches[SLAB_MAX_CACHES];
+    kmalloc_stats_t large;
+    uint32_t count, i, flags;
+
+    cli_and_save(flags);
+    count = slab_num_caches;
+    memcpy(caches, slab_caches, count * sizeof(slab_cache_t));
+    large = kmalloc_stats;
+    restore_flags(flags);
+
+    snap_puts(snap, "      size    active     slabs    allocs     frees  failures name\n");
+    for(i = 0; i < count; i++){
+        snap_putu(snap, caches[i].obj_size, PROC_NUM_WIDTH);
+        snap_putu(snap, caches[i].active, PROC_NUM_WIDTH);
+        snap_putu(snap, caches[i].slabs, PROC_NUM_WIDTH);
+        snap_putu(snap, caches[i].allocs, PROC_NUM_WIDTH);
+        snap_putu(snap, caches[i].frees, PROC_NUM_WIDTH);
+        snap_putu(snap, caches[i].failures, PROC_NUM_WIDTH);
+        snap_puts(snap, " ");
+        snap_puts(snap, caches[i].name);
+        snap_puts(snap, "\n");
+    }
+    snap_puts(snap, "large_allocs ");
+    snap_putu(snap, large.large_allocs, 0);
+    snap_puts(snap, "\nlarge_frees ");
+    snap_putu(snap, large.large_frees, 0);
+    snap_puts(snap, "\nlarge_frames ");
+    snap_putu(snap, large.large_frames, 0);
+    snap_puts(snap, "\n");
+}
+
+/* the files of the directory; ids are index + 1 */
+static proc_file_t proc_files[] = {
+    {"processes", gen_processes},
+    {"terminals", gen_terminals},
+    {"interrupts", gen_interrupts},
+    {"sched", gen_sched},
+    {"meminfo", gen_meminfo},
+    {"bcache", gen_bcache},
+    {"slabinfo", gen_slabinfo},
+};
+#define NUM_PROC_FILES  (sizeof(proc_files) / sizeof(proc_files[0]))
+
+/* proc_open
+ * Description: open a proc file; the text is made on the first read
+ * Input: filename
+ * Output: 0
+*/
+int32_t proc_open (const uint8_t* filename){
+    return 0;
+}
+
+/* proc_close
+ * Description: close a proc file and drop its snapshot
+ * Input: fd
+ * Output: 0
+*/
+int32_t proc_close (int32_t fd){
+    proc_snapshot_t** snap = &snapshots[get_curr_pcb()->process_ID][fd];
+
+    slab_free(snapshot_cache, *snap);
+    *snap = NULL;
+    return 0;
+}
+
+/* proc_read
+ * Description: read a proc file. A read at position 0 takes a new snapshot, so reading
+ *              the file through from the start always sees one consistent text
+ * Input: fd: index of file to read in file descriptor array
+ *        buf: buffer to read data into
+ *        nbytes: number of bytes to read
+ * Output: number of bytes read, 0 at the end of the text, -1 for fail
+*/
+int32_t proc_read (int32_t fd, void* buf, int32_t nbytes){
+    PCB* pcb_ptr = get_curr_pcb();
+    fd_table* file = &pcb_ptr->fda[fd];
+    proc_snapshot_t* snap = snapshots[pcb_ptr->process_ID][fd];
+    uint32_t pos = file->file_position;
+
+    if(buf == NULL || nbytes < 0 || file->inode <= PROC_ROOT || file->inode > NUM_PROC_FILES){
+        return -1;
+    }
+    if(snap == NULL){   //halt closes no files, so the next file in a slot reuses what it left
+        if((snap = slab_alloc(snapshot_cache)) == NULL){
+            return -1;
+        }
+        snap->file = -1;
+        snapshots[pcb_ptr->process_ID][fd] = snap;
+    }
+    if(pos == 0 || snap->file != file->inode){
+        snap->file = file->inode;
+        snap->length = 0;
+        proc_files[file->inode - 1].generate(snap);
+    }
+    if(pos >= snap->length){
+        return 0;
+    }
+    if((uint32_t)nbytes > snap->length - pos){
+        nbytes = snap->length - pos;
+    }
+    memcpy(buf, snap->text + pos, nbytes);
+    file->file_position += nbytes;
+    return nbytes;
+}
+
+/* proc_write
+ * Description: proc files are read only
+ * Input: fd, buf, nbytes
+ * Output: -1
+*/
+int32_t proc_write (int32_t fd, const void* buf, int32_t nbytes){
+    return -1;
+}
+
+/* proc_stat
+ * Description: fill in the type and id of an open proc file or the directory; proc files
+ *              have no length until they are read
+ * Input: fd: index of the file in file descriptor array
+ *        buf: stat_t to fill
+ * Output: 0
+*/
+int32_t proc_stat (int32_t fd, stat_t* buf){
+    buf->inode_num = get_curr_pcb()->fda[fd].inode;
+    buf->file_type = (buf->inode_num == PROC_ROOT) ? DIR_TYPE : REGULAR_TYPE;
+    buf->size = 0;
+    return 0;
+}
+
+/* proc_dir_read
+ * Description: read the name of the next file of the directory
+ * Input: fd: index of the directory in file descriptor array
+ *        buf: buffer for the name
+ *        nbytes: size of buf
+ * Output: length of the name, 0 at the end of the directory, -1 for fail
+*/
+int32_t proc_dir_read (int32_t fd, void* buf, int32_t nbytes){
+    fd_table* file = &get_curr_pcb()->fda[fd];
+    uint32_t len;
+
+    if(buf == NULL || nbytes < 0){
+        return -1;
+    }
+    if(file->file_position >= NUM_PROC_FILES){
+        return 0;
+    }
+    len = strlen(proc_files[file->file_position].name);
+    if(len > (uint32_t)nbytes){
+        len = nbytes;
+    }
+    memcpy(buf, proc_files[file->file_position].name, len);
+    file->file_position++;
+    return len;
+}
+
+/* proc_getdents
+ * Description: fill buf with as many packed dirent_t entries as fit, starting at the
+ *              directory's file position
+ * Input: fd: index of the directory in file descriptor array
+ *        buf: buffer to fill
+ *        nbytes: size of buf
+ * Output: number of bytes filled, 0 at the end of the directory, -1 if buf cannot hold one entry
+*/
+int32_t proc_getdents (int32_t fd, void* buf, int32_t nbytes){
+    dirent_t* entry = (dirent_t*)buf;
+    fd_table* file = &get_curr_pcb()->fda[fd];
+    int32_t count = 0;
+
+    if(buf == NULL || nbytes < (int32_t)sizeof(dirent_t)){
+        return -1;
+    }
+    while((count + 1) * (int32_t)sizeof(dirent_t) <= nbytes && file->file_position < NUM_PROC_FILES){
+        memset(entry[count].filename, 0, FILENAME_LEN);
+        strncpy(entry[count].filename, proc_files[file->file_position].name, FILENAME_LEN);
+        entry[count].file_type = REGULAR_TYPE;
+        entry[count].inode_num = file->file_position + 1;
+        entry[count].size = 0;
+        file->file_position++;
+        count++;
+    }
+    return count * sizeof(dirent_t);
+}
+
+/* file operation tables of procfs, built like RTC_fop */
+static file_ops proc_fop = {proc_open, proc_read, proc_write, proc_close, proc_stat};
+static file_ops proc_dir_fop = {proc_open, proc_dir_read, proc_write, proc_close, proc_stat, NULL, proc_getdents, NULL, NULL};
+
+/* procfs_mount
+ * Description: mount procfs; its files are generated, so only the snapshot cache is set up
+ * Input: mnt: the mount
+ *        arg: unused
+ * Output: 0 for success, -1 if the cache cannot be made
+*/
+static int32_t procfs_mount (mount_t* mnt, uint32_t arg){
+    if(snapshot_cache == NULL){
+        snapshot_cache = slab_cache_create((int8_t*)"proc_snapshot", sizeof(proc_snapshot_t));
+    }
+    return (snapshot_cache == NULL) ? -1 : 0;
+}
+
+/* procfs_lookup
+ * Description: find a proc file by name
+ * Input: mnt: the mount
+ *        path: path inside procfs
+ *        vnode: filled in for open
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t procfs_lookup (mount_t* mnt, const uint8_t* path, vnode_t* vnode){
+    uint32_t i, len;
+
+    while(*path == PATH_SEPARATOR){
+        path++;
+    }
+    vnode->size = 0;
+    if(*path == '\0'){
+        vnode->fops = &proc_dir_fop;
+        vnode->inode = PROC_ROOT;
+        vnode->file_type = DIR_TYPE;
+        return 0;
+    }
+    for(i = 0; i < NUM_PROC_FILES; i++){
+        len = strlen(proc_files[i].name);
+        if(strncmp((const int8_t*)path, proc_files[i].name, len + 1) == 0){
+            vnode->fops = &proc_fop;
+            vnode->inode = i + 1;
+            vnode->file_type = REGULAR_TYPE;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+fs_type_t procfs_fs_type = {"proc", procfs_mount, procfs_lookup, NULL, NULL, NULL};
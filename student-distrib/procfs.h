@@ -0,0 +1,44 @@
+/* procfs.h - read-only files with live kernel statistics
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROCFS_H
+#define _PROCFS_H
+
+#include "types.h"
+#include "vfs.h"
+
+#define PROC_BUF_SIZE   1024    // longest text a proc file can produce
+#define PROC_ROOT       0       // id of the directory, files are 1 and up
+#define PROC_NUM_WIDTH  10      // columns a number is padded to in tables
+
+/* text of one proc file as of the last read at position 0, one per (pid, fd) */
+typedef struct proc_snapshot {
+    int32_t file;               //id of the file the text belongs to, -1 for none
+    uint32_t length;
+    int8_t text[PROC_BUF_SIZE];
+} proc_snapshot_t;
+
+/* a proc file: its name and the function writing its text */
+typedef struct proc_file {
+    const int8_t* name;
+    void (*generate) (proc_snapshot_t* snap);
+} proc_file_t;
+
+extern fs_type_t procfs_fs_type;
+
+extern int32_t proc_open (const uint8_t* filename);
+
+extern int32_t proc_close (int32_t fd);
+
+extern int32_t proc_read (int32_t fd, void* buf, int32_t nbytes);
+
+extern int32_t proc_write (int32_t fd, const void* buf, int32_t nbytes);
+
+extern int32_t proc_stat (int32_t fd, stat_t* buf);
+
+extern int32_t proc_dir_read (int32_t fd, void* buf, int32_t nbytes);
+
+extern int32_t proc_getdents (int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* _PROCFS_H */
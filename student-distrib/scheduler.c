@@ -31,6 +31,8 @@ void scheduler() {
     }
     /* terminals switching from left to right: term0 -> term1 -> term2 -> term0 -> term1 ... */
     curr_index = (curr_index+1)%3;
+    sched_ticks++;
+    term_ticks[curr_index]++;
     /* if shell has not been opened, open shell first*/
     if (terminals[curr_index].shell_on == 0) {
         /* remap the video memory */
@@ -42,20 +44,7 @@ void scheduler() {
     next_PCB = get_pcb(terminals[curr_index].active_pid);
 
     /* set up paging */
-    int index = USR_ADDR >> 22; //shift 22 to get pde index
-    set_pde_mb(index, 1);
-    page_directory[index].MB.user_supervisor = 1;
-    page_directory[index].MB.global = 0;
-    page_directory[index].MB.table_address = 2 + terminals[curr_index].active_pid;   // skip first page
-
-    //flush tlb
-    asm volatile (
-        "movl %%cr3, %%eax;"
-        "movl %%eax, %%cr3;"
-        :
-        :
-        : "%eax"    //clobbers eax
-    );
+    switch_page_directory(terminals[curr_index].active_pid);
 
     /* save tss */
     tss.ss0 = KERNEL_DS;
@@ -3,12 +3,16 @@
 
 #include "system_calls.h"
 #include "types.h"
+#include "terminal.h"
 
 #define _8MB            0x800000
 #define _4MB            0x400000
 #define _8KB            0x2000
 
 extern volatile int32_t curr_index;
+/* scheduler ticks since boot, in total and handed to each terminal */
+uint32_t sched_ticks;
+uint32_t term_ticks[NUM_TERMS];
 
 void scheduler();
 
@@ -0,0 +1,248 @@
+/* slab.c - slab caches of fixed-size kernel objects, and kmalloc on top of them
+ * vim:ts=4 noexpandtab
+ *
+ * A cache hands out objects of one size, rounded up to a cache line so no two objects
+ * share one. Its memory comes in slabs, single frames from the buddy allocator that
+ * start with a slab_t header. Each slab threads its free objects into a list through
+ * their first word, and the cache keeps a list of the slabs that have any free, so both
+ * slab_alloc and slab_free are a pop or a push. A slab that empties goes back to the
+ * buddy allocator unless the cache would have no free objects left without it.
+ *
+ * kmalloc serves sizes up to KMALLOC_MAX_SMALL from power-of-two caches, and larger
+ * sizes straight from the buddy allocator with a large_block_t header in front. kfree
+ * tells the two apart by the magic at the start of the pointer's frame.
+ *
+ * Frames are used through the identity map init_paging sets up for the buddy range, so
+ * slab_init must run after paging is on.
+*/
+
+#include "slab.h"
+#include "lib.h"
+
+slab_cache_t slab_caches[SLAB_MAX_CACHES];
+uint32_t slab_num_caches;
+kmalloc_stats_t kmalloc_stats;
+
+static slab_cache_t* kmalloc_caches[KMALLOC_CLASSES];
+
+/* partial_push
+ * Description: put a slab on the front of its cache's list of slabs with free objects
+ * Input: cache: the cache
+ *        slab: a slab of the cache not on the list
+ * Output: none
+*/
+static void partial_push(slab_cache_t* cache, slab_t* slab){
+    slab->prev = NULL;
+    slab->next = cache->partial;
+    if(cache->partial != NULL){
+        cache->partial->prev = slab;
+    }
+    cache->partial = slab;
+}
+
+/* partial_remove
+ * Description: take a slab off its cache's list of slabs with free objects
+ * Input: cache: the cache
+ *        slab: a slab on the list
+ * Output: none
+*/
+static void partial_remove(slab_cache_t* cache, slab_t* slab){
+    if(slab->prev != NULL){
+        slab->prev->next = slab->next;
+    }else{
+        cache->partial = slab->next;
+    }
+    if(slab->next != NULL){
+        slab->next->prev = slab->prev;
+    }
+}
+
+/* new_slab
+ * Description: take a frame from the buddy allocator and carve it into free objects
+ * Input: cache: the cache to grow
+ * Output: the slab, NULL if no frame is free
+*/
+static slab_t* new_slab(slab_cache_t* cache){
+    slab_t* slab = (slab_t*)buddy_alloc(ORDER_4KB);
+    uint8_t* obj;
+    uint32_t i;
+
+    if(slab == NULL){
+        return NULL;
+    }
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free = NULL;
+    obj = (uint8_t*)(slab + 1) + (cache->per_slab - 1) * cache->obj_size;
+    for(i = 0; i < cache->per_slab; i++, obj -= cache->obj_size){
+        *(void**)obj = slab->free;  //lowest address ends up first
+        slab->free = obj;
+    }
+    partial_push(cache, slab);
+    cache->free_objs += cache->per_slab;
+    cache->slabs++;
+    return slab;
+}
+
+/* slab_cache_create
+ * Description: make a cache of objects of one size
+ * Input: name: shown in /proc/slabinfo, truncated to SLAB_NAME_LEN - 1
+ *        size: bytes of an object, at most SLAB_MAX_OBJECT
+ * Output: the cache, NULL if size is 0 or too large, or SLAB_MAX_CACHES exist
+*/
+slab_cache_t* slab_cache_create (const int8_t* name, uint32_t size){
+    slab_cache_t* cache;
+    uint32_t flags;
+
+    if(size == 0 || size > SLAB_MAX_OBJECT){
+        return NULL;
+    }
+    cli_and_save(flags);
+    if(slab_num_caches == SLAB_MAX_CACHES){
+        restore_flags(flags);
+        return NULL;
+    }
+    cache = &slab_caches[slab_num_caches++];
+    restore_flags(flags);
+
+    memset(cache, 0, sizeof(slab_cache_t));
+    strncpy(cache->name, name, SLAB_NAME_LEN - 1);
+    cache->obj_size = (size + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+    cache->per_slab = (SLAB_SIZE - sizeof(slab_t)) / cache->obj_size;
+    return cache;
+}
+
+/* slab_alloc
+ * Description: take an object from a cache, growing it by a slab if none is free
+ * Input: cache: the cache
+ * Output: the object, cache line aligned and not zeroed; NULL if memory is out
+*/
+void* slab_alloc (slab_cache_t* cache){
+    slab_t* slab;
+    void* obj;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if((slab = cache->partial) == NULL && (slab = new_slab(cache)) == NULL){
+        cache->failures++;
+        restore_flags(flags);
+        return NULL;
+    }
+    obj = slab->free;
+    slab->free = *(void**)obj;
+    slab->in_use++;
+    if(slab->free == NULL){
+        partial_remove(cache, slab);    //full
+    }
+    cache->free_objs--;
+    cache->active++;
+    cache->allocs++;
+    restore_flags(flags);
+    return obj;
+}
+
+/* slab_free
+ * Description: give an object back to its cache
+ * Input: cache: the cache it came from
+ *        obj: the object
+ * Output: none
+ * Side effect: an object whose frame is not a slab of cache is ignored
+*/
+void slab_free (slab_cache_t* cache, void* obj){
+    slab_t* slab = (slab_t*)((uint32_t)obj & ~(SLAB_SIZE - 1));
+    uint32_t flags;
+
+    if(obj == NULL || slab->magic != SLAB_MAGIC || slab->cache != cache){
+        return;
+    }
+    cli_and_save(flags);
+    if(slab->free == NULL){
+        partial_push(cache, slab);      //was full
+    }
+    *(void**)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+    cache->free_objs++;
+    cache->active--;
+    cache->frees++;
+    if(slab->in_use == 0 && cache->free_objs >= 2 * cache->per_slab){
+        partial_remove(cache, slab);    //other slabs still have room
+        slab->magic = 0;
+        cache->free_objs -= cache->per_slab;
+        cache->slabs--;
+        buddy_free((uint32_t)slab, ORDER_4KB);
+    }
+    restore_flags(flags);
+}
+
+/* slab_init
+ * Description: make the kmalloc size classes
+ * Input: none
+ * Output: none
+*/
+void slab_init (){
+    int8_t name[SLAB_NAME_LEN];
+    uint32_t i, size;
+
+    for(i = 0, size = KMALLOC_MIN; i < KMALLOC_CLASSES; i++, size <<= 1){
+        strcpy(name, (int8_t*)"kmalloc-");
+        itoa(size, name + strlen(name), 10);
+        kmalloc_caches[i] = slab_cache_create(name, size);
+    }
+}
+
+/* kmalloc
+ * Description: allocate kernel memory of any size
+ * Input: size: bytes wanted
+ * Output: cache line aligned memory, not zeroed; NULL if size is 0 or memory is out
+*/
+void* kmalloc (uint32_t size){
+    large_block_t* block;
+    uint32_t i, order, flags;
+
+    if(size == 0){
+        return NULL;
+    }
+    if(size <= KMALLOC_MAX_SMALL){
+        for(i = 0; (KMALLOC_MIN << i) < size; i++);
+        return slab_alloc(kmalloc_caches[i]);
+    }
+    for(order = 0; order < BUDDY_ORDERS && (FRAME_SIZE << order) < size + sizeof(large_block_t); order++);
+    if(order == BUDDY_ORDERS || (block = (large_block_t*)buddy_alloc(order)) == NULL){
+        return NULL;
+    }
+    block->magic = LARGE_MAGIC;
+    block->order = order;
+    cli_and_save(flags);
+    kmalloc_stats.large_allocs++;
+    kmalloc_stats.large_frames += 1 << order;
+    restore_flags(flags);
+    return block + 1;
+}
+
+/* kfree
+ * Description: free memory from kmalloc
+ * Input: ptr: what kmalloc returned, or NULL
+ * Output: none
+ * Side effect: a pointer kmalloc cannot have returned is ignored
+*/
+void kfree (void* ptr){
+    uint32_t base = (uint32_t)ptr & ~(FRAME_SIZE - 1);
+    large_block_t* block = (large_block_t*)base;
+    uint32_t flags;
+
+    if(ptr == NULL || base < BUDDY_MIN_ADDR || base >= BUDDY_MAX_ADDR){
+        return;
+    }
+    if(block->magic == SLAB_MAGIC){
+        slab_free(((slab_t*)base)->cache, ptr);
+    }else if(block->magic == LARGE_MAGIC && ptr == block + 1){
+        block->magic = 0;
+        cli_and_save(flags);
+        kmalloc_stats.large_frees++;
+        kmalloc_stats.large_frames -= 1 << block->order;
+        restore_flags(flags);
+        buddy_free(base, block->order);
+    }
+}
@@ -0,0 +1,73 @@
+/* slab.h - slab caches of fixed-size kernel objects, and kmalloc on top of them
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "buddy.h"
+
+#define CACHE_LINE          64
+#define SLAB_SIZE           FRAME_SIZE  // a slab is one frame from the buddy allocator
+#define SLAB_MAGIC          0x534C4142  // "SLAB", first word of a slab's frame
+#define LARGE_MAGIC         0x4C524745  // "LRGE", first word of a large kmalloc block
+#define SLAB_MAX_OBJECT     ((SLAB_SIZE - CACHE_LINE) / 2)  // a slab holds at least two
+#define SLAB_MAX_CACHES     16
+#define SLAB_NAME_LEN       16
+#define KMALLOC_MIN         CACHE_LINE  // smallest size class
+#define KMALLOC_CLASSES     5           // 64, 128, 256, 512 and 1024 bytes
+#define KMALLOC_MAX_SMALL   (KMALLOC_MIN << (KMALLOC_CLASSES - 1))
+
+/* header at the start of a slab's frame; the objects follow it */
+typedef struct slab {
+    uint32_t magic;
+    struct slab_cache* cache;
+    struct slab* prev;              //on the cache's list of slabs with free objects
+    struct slab* next;
+    void* free;                     //first free object, linked through its first word
+    uint32_t in_use;
+} __attribute__((aligned (CACHE_LINE))) slab_t;
+
+/* header at the start of a kmalloc block too large for a size class */
+typedef struct large_block {
+    uint32_t magic;
+    uint32_t order;
+} __attribute__((aligned (CACHE_LINE))) large_block_t;
+
+typedef struct slab_cache {
+    int8_t name[SLAB_NAME_LEN];
+    uint32_t obj_size;              //requested size rounded up to CACHE_LINE
+    uint32_t per_slab;
+    slab_t* partial;                //slabs with at least one free object
+    uint32_t free_objs;             //free objects in those slabs
+    uint32_t active;                //objects handed out
+    uint32_t slabs;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;              //allocations the buddy allocator could not back
+} slab_cache_t;
+
+typedef struct kmalloc_stats {
+    uint32_t large_allocs;
+    uint32_t large_frees;
+    uint32_t large_frames;          //frames large blocks hold now
+} kmalloc_stats_t;
+
+extern slab_cache_t slab_caches[SLAB_MAX_CACHES];
+extern uint32_t slab_num_caches;
+extern kmalloc_stats_t kmalloc_stats;
+
+extern void slab_init ();
+
+extern slab_cache_t* slab_cache_create (const int8_t* name, uint32_t size);
+
+extern void* slab_alloc (slab_cache_t* cache);
+
+extern void slab_free (slab_cache_t* cache, void* obj);
+
+extern void* kmalloc (uint32_t size);
+
+extern void kfree (void* ptr);
+
+#endif /* _SLAB_H */
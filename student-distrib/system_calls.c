@@ -1,4 +1,5 @@
 #include "paging.h"
+#include "tlb.h"
 #include "lib.h"
 #include "system_calls.h"
 #include "filesystem.h"
@@ -6,6 +7,8 @@
 #include "RTC.h"
 #include "x86_desc.h"
 #include "scheduler.h"
+#include "vfs.h"
+#include "slab.h"
 
 /* global variables */
 uint32_t pid_array[MAX_PROCESS] = {0, 0, 0, 0, 0, 0};   // initialize process array
@@ -16,9 +19,9 @@ uint32_t parent_pid;
 static file_ops null_fop = {failed_calls, failed_calls, failed_calls, failed_calls};
 static file_ops stdin_fop = {terminal_open, terminal_read, failed_calls, terminal_close};  // read
 static file_ops stdout_fop = {terminal_open, failed_calls, terminal_write, terminal_close};    // write
-static file_ops RTC_fop = {RTC_open, RTC_read, RTC_write, RTC_close};
-static file_ops dir_fop = {dir_open, dir_read, dir_write, dir_close};
-static file_ops file_fop = {file_open, file_read, file_write, file_close};
+
+/* bounce buffers for sendfile from files whose data is not in pages, one per process */
+static mmap_region_t mmap_regions[MAX_PROCESS][MMAP_REGIONS];   //files each process has mapped
 
 /*
  * int32_t halt (uint8_t status)
@@ -61,25 +64,14 @@ int32_t halt (uint8_t status) {
     curr_pid = curr_pcb_ptr->parent_process_ID;
     parent_pid = parent_pcb_ptr->parent_process_ID;
     pid_array[curr_pcb_ptr->process_ID] = 0;
+    free_user_frame(curr_pcb_ptr->process_ID);
+    free_anon_pages(curr_pcb_ptr->process_ID);
 
     /* update terminal active process ID */
     terminals[curr_index].active_pid = curr_pid;
 
     /* -------------------------- Restore parent paging -------------------------*/
-    int index = USR_ADDR >> 22; //shift 22 to get pde index
-    set_pde_mb(index, 1);
-    page_directory[index].MB.user_supervisor = 1;
-    page_directory[index].MB.global = 0;
-    page_directory[index].MB.table_address = 2 + curr_pid;   // skip first page
-
-    //flush tlb
-    asm volatile (
-        "movl %%cr3, %%eax;"
-        "movl %%eax, %%cr3;"
-        :
-        :
-        : "%eax"    //clobbers eax
-    );
+    switch_page_directory(curr_pid);
 
     /* -------------------------- Clear fd array -------------------------*/
     for(i = 0; i < MAX_FILES; i++){
@@ -145,47 +137,28 @@ int32_t execute (const uint8_t* command) {
     read_data(temp_dentry.inode_num, EIP_ENTRY, elf, 4);  // find the entry point for EIP from bytes 24-27 of the executable loaded
 
     /* -------------------------- Set up paging -------------------------*/
-    int pid_flag = 0;
-    for(i = 0; i < MAX_PROCESS; i++){
-        if(pid_array[i] == 0){
-            pid_array[i] = 1;
-            curr_pid = i;
-            pid_flag = 1;
-            break;
-        }
-    }
-    if(pid_flag == 0){
+    for(i = 0; i < MAX_PROCESS && pid_array[i] != 0; i++);
+    if(i == MAX_PROCESS){
         printf("process full\n");
         return -1;
     }
+    if(alloc_user_frame(i) == -1){
+        printf("out of memory\n");
+        return -1;
+    }
+    pid_array[i] = 1;
+    curr_pid = i;
 
-    int index = USR_ADDR >> 22; //shift 22 to get pde index
-    // int phys_mem_addr = USR_ADDR + curr_pid * _4MB; //start from 128mb, 4 mb each process
-
-    uint32_t pt_index = 2 + curr_pid;  // skip first page
-    // page_directory[USER_INDEX].table_addr_31_12 = phys_addr/ALIGN_4KB;//user virtual to physical
-
-    set_pde_mb(index, 1);
-    page_directory[index].MB.user_supervisor = 1;
-    page_directory[index].MB.global = 0;
-    page_directory[index].MB.table_address = pt_index;   //update page table index
-
-    //flush tlb
-    asm volatile (
-        "movl %%cr3, %%eax;"
-        "movl %%eax, %%cr3;"
-        :
-        :
-        : "%eax"    //clobbers eax
-    );
-
-    /* -------------------------- Load file -------------------------*/
-    inode_t* temp_inode = (inode_t*)(inode_ptr + temp_dentry.inode_num);
-    read_data(temp_dentry.inode_num, 0, (uint8_t*)PROGRAM_ADDR, temp_inode->length);  //copy file to program image address
+    // every user page starts not present, demand_load_page fills them on first touch
+    reset_user_pages(curr_pid);
+    init_user_directory(curr_pid);
+    switch_page_directory(curr_pid);
 
     /* -------------------------- Create PCB -------------------------*/
     PCB* pcb_ptr = get_curr_pcb();
     pcb_ptr->process_ID = curr_pid;
+    pcb_ptr->exe_inode = temp_dentry.inode_num;
+    pcb_ptr->exe_length = file_length(temp_dentry.inode_num);
 
     eip_arg = *((uint32_t*)elf);    // set EIP
     esp_arg = USR_ADDR + _4MB - sizeof(int32_t);  // 4 bits for data alignment
@@ -208,19 +181,7 @@ int32_t execute (const uint8_t* command) {
         terminals[curr_index].active_pid = pcb_ptr->process_ID;
     }
     // curr_term()->active_pid = pcb_ptr->process_ID;
-    //initialize fd array
-    for(i = 0; i < MAX_FILES; i++){
-        pcb_ptr->fda[i].file_operation_ptr = &null_fop;
-        pcb_ptr->fda[i].inode = 0;
-        pcb_ptr->fda[i].file_position = 0;
-        pcb_ptr->fda[i].flag = 0;
-    }
-
-    // set up stdin and stdout
-    pcb_ptr->fda[0].file_operation_ptr = &stdin_fop;
-    pcb_ptr->fda[0].flag = 1;    // in use
-    pcb_ptr->fda[1].file_operation_ptr = &stdout_fop;
-    pcb_ptr->fda[1].flag = 1;    // in use
+    init_process_files(pcb_ptr);
 
     // uint32_t curr_esp, curr_ebp;
 
@@ -310,58 +271,28 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes) {
  */
 int32_t open (const uint8_t* filename) {
     int fd_, i;
-    int read_check;
-    int files_full;
-    dentry_t dentry_;
-    read_check = read_dentry_by_name(filename, &dentry_);
-    if (read_check == -1) {
-        return -1;  // read failed
+    vnode_t vnode;
+    if (vfs_lookup(filename, &vnode) == -1) {
+        return -1;  // no such file in any mounted filesystem
     }
     PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
     // the first two fd entries are taken by stdin and stdout, so start from the third
-    files_full = 1;     // assume all files opened
+    fd_ = -1;
     for (i = 2; i < MAX_FILES; i++) {
         if (curr_process->fda[i].flag == 0) {
-            curr_process->fda[i].flag = 1;
-            curr_process->fda[i].file_position = 0;
             fd_ = i;
-            files_full = 0;     // not full
             break;
         }
     }
-    if (files_full) {
+    /* check if we can open the file */
+    if (fd_ == -1 || vnode.fops->open(filename) == -1) {
         return -1;
     }
-    /* set up fop table according to dentry */
-    switch (dentry_.file_type)
-    {
-    case RTC_TYPE:
-        /* check if we can open the file */
-        if (RTC_open(filename) == -1) {
-            return -1;
-        }
-        curr_process->fda[fd_].file_operation_ptr = &RTC_fop;
-        curr_process->fda[fd_].inode = 0;   // 0 for directories and RTC
-        break;
-    case DIR_TYPE:
-        /* check if we can open the file */
-        if (dir_open(filename) == -1) {
-            return -1;
-        }
-        curr_process->fda[fd_].file_operation_ptr = &dir_fop;
-        curr_process->fda[fd_].inode = 0;   // 0 for directories and RTC
-        break;
-    case REGULAR_TYPE:
-        /* check if we can open the file */
-        if (file_open(filename) == -1) {
-            return -1;
-        }
-        curr_process->fda[fd_].file_operation_ptr = &file_fop;
-        curr_process->fda[fd_].inode = dentry_.inode_num;
-        break;
-    default:
-        break;
-    }
+    // the filesystem picked the fop table, so every later call is one indirect call
+    curr_process->fda[fd_].file_operation_ptr = vnode.fops;
+    curr_process->fda[fd_].inode = vnode.inode;
+    curr_process->fda[fd_].file_position = 0;
+    curr_process->fda[fd_].flag = 1;
     return fd_;
 }
 
@@ -417,20 +348,380 @@ int32_t vidmap(uint8_t** screen_start){
     }
 
     set_pte_video_mem(VIDEO_ADDR >> 12, 1);
-
-    //flush tlb
-    asm volatile (
-        "movl %%cr3, %%eax;"
-        "movl %%eax, %%cr3;"
-        :
-        :
-        : "%eax"    //clobbers eax
-    );
+    tlb_flush_page(_132MB + VIDEO_ADDR);
     
     *screen_start = (uint8_t*)(USR_ADDR + _4MB + VIDEO_ADDR);
     return 0;
 }
 
+/*
+ * int32_t unlink(const uint8_t* filename)
+ * Description: delete a regular file or an empty directory from the filesystem
+ * Input: filename: name of the file
+ * Output: 0 for success, -1 for failure
+ */
+int32_t unlink(const uint8_t* filename){
+    return vfs_unlink(filename);
+}
+
+/*
+ * int32_t mkdir(const uint8_t* path)
+ * Description: create an empty directory; unlink removes it again once it is empty
+ * Input: path: path of the new directory
+ * Output: 0 for success, -1 for failure
+ */
+int32_t mkdir(const uint8_t* path){
+    return vfs_mkdir(path);
+}
+
+/*
+ * int32_t ftruncate(int32_t fd, uint32_t length)
+ * Description: set the length of an open regular file
+ * Input: fd: file descriptor number
+ *        length: new length in bytes
+ * Output: 0 for success, -1 for failure
+ */
+int32_t ftruncate(int32_t fd, uint32_t length){
+    if(fd < 2 || fd > (MAX_FILES-1)){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
+
+    if (curr_process->fda[fd].flag == 0 || curr_process->fda[fd].file_operation_ptr->truncate == NULL) {
+        return -1;
+    }
+    return curr_process->fda[fd].file_operation_ptr->truncate(fd, length);
+}
+
+/*
+ * int32_t getdents(int32_t fd, void* buf, int32_t nbytes)
+ * Description: read as many directory entries as fit in buf with a single call
+ * Input: fd: file descriptor of an open directory
+ *        buf: buffer to fill with dirent_t entries
+ *        nbytes: size of buf
+ * Output: number of bytes filled, 0 at the end of the directory, -1 for failure
+ */
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes){
+    if(fd < 2 || fd > (MAX_FILES-1) || buf == NULL){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
+
+    if (curr_process->fda[fd].flag == 0 || curr_process->fda[fd].file_operation_ptr->getdents == NULL) {
+        return -1;
+    }
+    return curr_process->fda[fd].file_operation_ptr->getdents(fd, buf, nbytes);
+}
+
+/*
+ * int32_t stat(const uint8_t* filename, stat_t* buf)
+ * Description: get the type, inode and size of a file by name
+ * Input: filename: name of the file
+ *        buf: stat_t to fill
+ * Output: 0 for success, -1 for failure
+ */
+int32_t stat(const uint8_t* filename, stat_t* buf){
+    return vfs_stat(filename, buf);
+}
+
+/*
+ * int32_t fstat(int32_t fd, stat_t* buf)
+ * Description: get the type, inode and size of an open file
+ * Input: fd: file descriptor number
+ *        buf: stat_t to fill
+ * Output: 0 for success, -1 for failure (including stdin and stdout)
+ */
+int32_t fstat(int32_t fd, stat_t* buf){
+    if(fd < 2 || fd > (MAX_FILES-1) || buf == NULL){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
+    fd_table* file = &curr_process->fda[fd];
+
+    if (file->flag == 0 || file->file_operation_ptr->stat == NULL) {
+        return -1;
+    }
+    return file->file_operation_ptr->stat(fd, buf);
+}
+
+/*
+ * int32_t lseek(int32_t fd, int32_t offset, int32_t whence)
+ * Description: move the file position of an open regular file
+ * Input: fd: file descriptor number
+ *        offset: new position relative to whence
+ *        whence: SEEK_SET, SEEK_CUR or SEEK_END
+ * Output: the new file position, -1 for failure
+ */
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence){
+    int32_t position;
+    stat_t st;
+    if(fd < 2 || fd > (MAX_FILES-1)){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
+    fd_table* file = &curr_process->fda[fd];
+
+    if (file->flag == 0 || file->file_operation_ptr->stat == NULL ||
+        file->file_operation_ptr->stat(fd, &st) == -1 || st.file_type != REGULAR_TYPE) {
+        return -1;
+    }
+    switch (whence)
+    {
+    case SEEK_SET:
+        position = offset;
+        break;
+    case SEEK_CUR:
+        position = file->file_position + offset;
+        break;
+    case SEEK_END:
+        position = st.size + offset;
+        break;
+    default:
+        return -1;
+    }
+    if (position < 0) {
+        return -1;
+    }
+    file->file_position = position;     // past the end is allowed, a later write zero-fills the gap
+    return position;
+}
+
+/*
+ * int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+ * Description: read from an open regular file at offset without moving its file position
+ * Input: fd: file descriptor number
+ *        buf: buffer to read into
+ *        nbytes: number of bytes to read
+ *        offset: position in the file to read from
+ * Output: number of bytes read, -1 for failure
+ */
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+    if(fd < 2 || fd > (MAX_FILES-1) || buf == NULL || nbytes < 0){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
+
+    if (curr_process->fda[fd].flag == 0 || curr_process->fda[fd].file_operation_ptr->pread == NULL) {
+        return -1;
+    }
+    return curr_process->fda[fd].file_operation_ptr->pread(fd, buf, nbytes, offset);
+}
+
+/*
+ * int32_t mmap(int32_t fd, uint32_t length)
+ * Description: map an open regular file read-only into the mmap window, with each page
+ *              pointing straight at the memory its filesystem hands out (no copy), or
+ *              with fd MMAP_ANON map zero-filled writable pages from the top of the
+ *              anonymous area, each backed by a frame only once it is touched
+ * Input: fd: file descriptor of an open regular file, or MMAP_ANON
+ *        length: number of bytes to map, 0 for the whole file
+ * Output: user address of the mapping, -1 for failure
+ */
+int32_t mmap(int32_t fd, uint32_t length){
+    uint32_t i, num_pages, addr;
+    int32_t first_page;
+    uint8_t* block;
+    stat_t st;
+    uint32_t pid = terminals[curr_index].active_pid;
+    mmap_region_t* region;
+
+    if(fd == MMAP_ANON){
+        if(length == 0 || length > ANON_END - ANON_ADDR){
+            return -1;
+        }
+        num_pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+        if((addr = anon_find(pid, num_pages)) == 0 || anon_reserve(pid, addr, num_pages) == -1){
+            return -1;
+        }
+        return addr;
+    }
+    if(fd < 2 || fd > (MAX_FILES-1)){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(pid);
+
+    file_ops* fops = curr_process->fda[fd].file_operation_ptr;
+
+    if (curr_process->fda[fd].flag == 0 || fops->page == NULL || fops->stat == NULL || fops->stat(fd, &st) == -1) {
+        return -1;
+    }
+    if (length == 0 || length > st.size) {
+        length = st.size;
+    }
+    num_pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (region = mmap_regions[pid]; region < mmap_regions[pid] + MMAP_REGIONS && region->pages != 0; region++);
+    if (region == mmap_regions[pid] + MMAP_REGIONS) {
+        return -1;  // too many files mapped
+    }
+    if ((first_page = find_mmap_pages(pid, num_pages)) == -1) {
+        return -1;  // empty file or window full
+    }
+    for (i = 0; i < num_pages; i++) {
+        block = fops->page(fd, i);
+        if (block == NULL || ((uint32_t)block & (PAGE_SIZE - 1)) != 0) {
+            // image not page aligned, undo the pages mapped so far
+            while (i-- > 0) {
+                set_pte_mmap(pid, first_page + i, 0, 0);
+            }
+            return -1;
+        }
+        set_pte_mmap(pid, first_page + i, (uint32_t)block, 1);
+    }
+    // the file's pages must outlive the mapping, so unlink and truncate check for it
+    region->fops = fops;
+    region->inode = curr_process->fda[fd].inode;
+    region->first_page = first_page;
+    region->num_pages = num_pages;
+    region->pages = num_pages;
+    // pages were not present before, so nothing stale can be in the tlb
+    return MMAP_ADDR + first_page * PAGE_SIZE;
+}
+
+/*
+ * int32_t munmap(void* addr, uint32_t length)
+ * Description: remove pages from the mmap window, or anonymous pages above the heap,
+ *              freeing the frames of those that were touched
+ * Input: addr: page aligned address returned by mmap
+ *        length: number of bytes to unmap
+ * Output: 0 for success, -1 for failure
+ */
+int32_t munmap(void* addr, uint32_t length){
+    uint32_t i, j, flags;
+    uint32_t first_page = ((uint32_t)addr - MMAP_ADDR) / PAGE_SIZE;
+    uint32_t num_pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t pid = terminals[curr_index].active_pid;
+
+    if ((uint32_t)addr >= ANON_ADDR && (uint32_t)addr < ANON_END) {
+        // the heap below the break belongs to sbrk
+        if (((uint32_t)addr & (PAGE_SIZE - 1)) != 0 || (uint32_t)addr < user_brk[pid] ||
+            length == 0 || length > ANON_END - (uint32_t)addr) {
+            return -1;
+        }
+        anon_release(pid, (uint32_t)addr, num_pages);
+        return 0;
+    }
+    if ((uint32_t)addr < MMAP_ADDR || ((uint32_t)addr & (PAGE_SIZE - 1)) != 0 ||
+        num_pages == 0 || first_page + num_pages > PTE_SIZE) {
+        return -1;
+    }
+    cli_and_save(flags);
+    for (i = first_page; i < first_page + num_pages; i++) {
+        if (!page_table_mmap[pid][i].present) {
+            continue;
+        }
+        for (j = 0; j < MMAP_REGIONS; j++) {
+            if (mmap_regions[pid][j].pages != 0 && i >= mmap_regions[pid][j].first_page &&
+                i < mmap_regions[pid][j].first_page + mmap_regions[pid][j].num_pages) {
+                mmap_regions[pid][j].pages--;   //0 frees the region
+                break;
+            }
+        }
+        set_pte_mmap(pid, i, 0, 0);
+        tlb_batch_add(MMAP_ADDR + i * PAGE_SIZE);
+    }
+    tlb_batch_flush();
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * int32_t sbrk(int32_t increment)
+ * Description: grow or shrink the heap, which starts at ANON_ADDR. New pages read as
+ *              zero and get a frame on first touch; pages given back free their frames
+ * Input: increment: bytes to add to the heap, negative to shrink it
+ * Output: the old end of the heap, -1 for failure
+ */
+int32_t sbrk(int32_t increment){
+    uint32_t pid = terminals[curr_index].active_pid;
+    uint32_t old_brk = user_brk[pid];
+    uint32_t new_brk = old_brk + increment;
+    uint32_t old_end = (old_brk + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t new_end;
+
+    if ((increment > 0 && (new_brk < old_brk || new_brk > ANON_END)) ||
+        (increment < 0 && (new_brk > old_brk || new_brk < ANON_ADDR))) {
+        return -1;
+    }
+    new_end = (new_brk + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (new_end > old_end) {
+        // pages may not run into anonymous mappings
+        if (!anon_range_free(pid, old_end, (new_end - old_end) / PAGE_SIZE) ||
+            anon_reserve(pid, old_end, (new_end - old_end) / PAGE_SIZE) == -1) {
+            return -1;
+        }
+    } else if (new_end < old_end) {
+        anon_release(pid, new_end, (old_end - new_end) / PAGE_SIZE);
+    }
+    user_brk[pid] = new_brk;
+    return old_brk;
+}
+
+/*
+ * int32_t sendfile(int32_t out_fd, int32_t in_fd, int32_t count)
+ * Description: copy bytes from a file's position to another open file without going
+ *              through user memory; when the file has pages (fops->page) they are written
+ *              out directly, otherwise a page at a time goes through a kmalloc'd buffer
+ * Input: out_fd: file descriptor to write to, e.g. stdout
+ *        in_fd: file descriptor of an open regular file, whose position moves past the bytes sent
+ *        count: most bytes to send
+ * Output: number of bytes sent, 0 at the end of the file, -1 for failure
+ */
+int32_t sendfile(int32_t out_fd, int32_t in_fd, int32_t count){
+    int32_t sent = 0, chunk;
+    uint32_t pos;
+    uint8_t* src;
+    uint8_t* bounce = NULL;    //kmalloc'd on the first chunk that needs it
+    stat_t st;
+    if(in_fd < 2 || in_fd > (MAX_FILES-1) || out_fd < 0 || out_fd > (MAX_FILES-1) || count < 0){
+        return -1;
+    }
+    PCB* curr_process = get_pcb(terminals[curr_index].active_pid);
+    fd_table* in = &curr_process->fda[in_fd];
+    fd_table* out = &curr_process->fda[out_fd];
+
+    if (in->flag == 0 || out->flag == 0 || in->file_operation_ptr->pread == NULL ||
+        in->file_operation_ptr->stat == NULL || in->file_operation_ptr->stat(in_fd, &st) == -1 ||
+        st.file_type != REGULAR_TYPE) {
+        return -1;
+    }
+    while (sent < count && (uint32_t)in->file_position < (uint32_t)st.size) {
+        pos = in->file_position;
+        // stop each chunk at a page boundary so it comes from one page
+        chunk = PAGE_SIZE - (pos & (PAGE_SIZE - 1));
+        if (chunk > count - sent) {
+            chunk = count - sent;
+        }
+        if ((uint32_t)chunk > st.size - pos) {
+            chunk = st.size - pos;
+        }
+        src = NULL;
+        if (in->file_operation_ptr->page != NULL) {
+            src = in->file_operation_ptr->page(in_fd, pos / PAGE_SIZE);
+        }
+        if (src != NULL) {
+            src += pos & (PAGE_SIZE - 1);
+        } else {
+            if (bounce == NULL && (bounce = kmalloc(PAGE_SIZE)) == NULL) {
+                break;
+            }
+            chunk = in->file_operation_ptr->pread(in_fd, bounce, chunk, pos);
+            if (chunk <= 0) {
+                break;
+            }
+            src = bounce;
+        }
+        // the terminal returns how many characters it printed, so advance by the chunk
+        if (out->file_operation_ptr->write(out_fd, src, chunk) == -1) {
+            kfree(bounce);
+            return (sent > 0) ? sent : -1;
+        }
+        in->file_position += chunk;
+        sent += chunk;
+    }
+    kfree(bounce);
+    return sent;
+}
+
 /* system call helper functions */
 
 /*
@@ -489,6 +780,110 @@ PCB* get_curr_pcb() {
     return (PCB* ) (PCB_START-(curr_pid+1)*PCB_SIZE);
 }
 
+/*
+ * void init_process_files(PCB* pcb_ptr)
+ * Description: give a new process stdin and stdout, every other fd closed and no
+ *              files mapped
+ * Input: pcb_ptr: PCB of the process, with process_ID set
+ * Output: none
+ */
+void init_process_files(PCB* pcb_ptr){
+    int i;
+    for(i = 0; i < MAX_FILES; i++){
+        pcb_ptr->fda[i].file_operation_ptr = &null_fop;
+        pcb_ptr->fda[i].inode = 0;
+        pcb_ptr->fda[i].file_position = 0;
+        pcb_ptr->fda[i].flag = 0;
+    }
+
+    // set up stdin and stdout
+    pcb_ptr->fda[0].file_operation_ptr = &stdin_fop;
+    pcb_ptr->fda[0].flag = 1;    // in use
+    pcb_ptr->fda[1].file_operation_ptr = &stdout_fop;
+    pcb_ptr->fda[1].flag = 1;    // in use
+    memset(mmap_regions[pcb_ptr->process_ID], 0, sizeof(mmap_regions[pcb_ptr->process_ID]));
+}
+
+/*
+ * int32_t demand_load_page(uint32_t addr)
+ * Description: page fault handler for the user region, maps the faulting 4kb page and
+ *              copies in the part of the program image it covers; faults in the
+ *              anonymous area go to anon_fault
+ * Input: addr: faulting linear address (cr2)
+ * Output: 0 if the page was mapped, -1 if the fault is a real error
+ */
+int32_t demand_load_page(uint32_t addr) {
+    uint32_t page_addr = addr & ~(BLOCK_SIZE - 1);
+    PTE_t* pte;
+    PCB* pcb_ptr;
+    int32_t bytes = 0;
+
+    if(addr >= ANON_ADDR && addr < ANON_END){
+        return anon_fault(mapped_user_pid, addr);
+    }
+    if(addr < USR_ADDR || addr >= USR_ADDR + _4MB){
+        return -1;  // not in the user region
+    }
+    pte = &page_table_user[mapped_user_pid][(addr - USR_ADDR) >> 12];
+    if(pte->present){
+        return -1;  // protection fault on a mapped page
+    }
+    // not-present entries are never cached in the tlb, so no flush is needed
+    pte->present = 1;
+
+    // PROGRAM_ADDR is page aligned, so a page overlapping the image starts inside it
+    pcb_ptr = get_pcb(mapped_user_pid);
+    if(page_addr >= PROGRAM_ADDR && page_addr < PROGRAM_ADDR + pcb_ptr->exe_length){
+        bytes = read_data(pcb_ptr->exe_inode, page_addr - PROGRAM_ADDR, (uint8_t*)page_addr, BLOCK_SIZE);
+        if(bytes < 0){
+            bytes = 0;
+        }
+    }
+    // the frame came from the buddy allocator with another owner's data, so the stack,
+    // bss and the tail of the image's last page must not see it
+    memset((uint8_t*)page_addr + bytes, 0, BLOCK_SIZE - bytes);
+    return 0;
+}
+
+/*
+ * int32_t file_busy(file_ops* fops, uint32_t inode, uint32_t uses)
+ * Description: check whether a live process uses a file. A program's pages are loaded
+ *              from its inode on first touch, an fd keeps a bare inode number, and mmap
+ *              points straight at the file's pages, so a file in use must not be
+ *              unlinked, nor a program or mapped file cut short
+ * Input: fops: file operation table the file is opened with
+ *        inode: inode as fd_table stores it
+ *        uses: FILE_BUSY_* bits of the uses to look for
+ * Output: 1 if it is in use, 0 if not
+ */
+int32_t file_busy(file_ops* fops, uint32_t inode, uint32_t uses) {
+    uint32_t i, j;
+    PCB* pcb_ptr;
+
+    for(i = 0; i < MAX_PROCESS; i++){
+        if(pid_array[i] == 0){
+            continue;
+        }
+        pcb_ptr = get_pcb(i);
+        if((uses & FILE_BUSY_PROGRAM) && fops == &file_fop && pcb_ptr->exe_inode == inode){
+            return 1;
+        }
+        for(j = 0; (uses & FILE_BUSY_MAPPED) && j < MMAP_REGIONS; j++){
+            if(mmap_regions[i][j].pages != 0 && mmap_regions[i][j].fops == fops &&
+               mmap_regions[i][j].inode == inode){
+                return 1;
+            }
+        }
+        for(j = 0; (uses & FILE_BUSY_OPEN) && j < MAX_FILES; j++){
+            if(pcb_ptr->fda[j].flag != 0 && pcb_ptr->fda[j].file_operation_ptr == fops &&
+               (uint32_t)pcb_ptr->fda[j].inode == inode){
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 /*
  * failed_calls()
  * Description: used for fops
@@ -18,6 +18,14 @@
 #define RTC_TYPE        0
 #define DIR_TYPE        1
 #define REGULAR_TYPE    2
+#define SEEK_SET        0
+#define SEEK_CUR        1
+#define SEEK_END        2
+#define MMAP_ANON       -1          // mmap fd for zero-filled pages backed by no file
+#define FILE_BUSY_PROGRAM   0x1     // file_busy: a process was executed from it
+#define FILE_BUSY_OPEN      0x2     // file_busy: a process has an fd on it
+#define FILE_BUSY_MAPPED    0x4     // file_busy: a process has its pages mapped
+#define MMAP_REGIONS    8           // files one process can have mapped at once
 
 #define ELFMAG0		    0x7F
 #define ELFMAG1		    0x45    //E
@@ -33,6 +41,12 @@ typedef struct file_operation_jump_table {
     int32_t (*read) (int32_t fd, void* buf, int32_t nbytes);
     int32_t (*write) (int32_t fd, const void* buf, int32_t nbytes);
     int32_t (*close) (int32_t fd);
+    /* optional, NULL when the file does not support the call */
+    int32_t (*stat) (int32_t fd, stat_t* buf);
+    int32_t (*truncate) (int32_t fd, uint32_t length);
+    int32_t (*getdents) (int32_t fd, void* buf, int32_t nbytes);
+    int32_t (*pread) (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+    uint8_t* (*page) (int32_t fd, uint32_t page_index);    //page aligned memory for mmap
 } file_ops;
 
 typedef struct file_descriptor_table {
@@ -42,6 +56,14 @@ typedef struct file_descriptor_table {
     int flag;
 } fd_table;
 
+typedef struct mmap_region {
+    file_ops* fops;         //fops and inode as the fd that was mapped had them
+    uint32_t inode;
+    uint32_t first_page;    //in the mmap window
+    uint32_t num_pages;
+    uint32_t pages;         //pages still mapped, 0 for a free slot
+} mmap_region_t;
+
 typedef struct process_control_block {
     fd_table fda[MAX_FILES];
     uint32_t process_ID;
@@ -58,9 +80,14 @@ typedef struct process_control_block {
     uint32_t saved_ebp;   //ebp of current process
     uint8_t arg[FILENAME_LEN];
     uint32_t term_ID;
+    uint32_t exe_inode;     //inode of the program image, loaded on demand
+    uint32_t exe_length;    //length of the program image in bytes
     /* more to be added... */
 } PCB;
 
+/* nonzero for each pid in use */
+extern uint32_t pid_array[MAX_PROCESS];
+
 /* system calls */
 int32_t halt (uint8_t status);
 int32_t execute (const uint8_t* command);
@@ -70,11 +97,26 @@ int32_t open (const uint8_t* filename);
 int32_t close (int32_t fd);
 int32_t get_args(uint8_t* buff, int32_t nbytes);
 int32_t vidmap(uint8_t** screen_start);
+int32_t unlink(const uint8_t* filename);
+int32_t ftruncate(int32_t fd, uint32_t length);
+int32_t mkdir(const uint8_t* path);
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes);
+int32_t stat(const uint8_t* filename, stat_t* buf);
+int32_t fstat(int32_t fd, stat_t* buf);
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t mmap(int32_t fd, uint32_t length);
+int32_t munmap(void* addr, uint32_t length);
+int32_t sendfile(int32_t out_fd, int32_t in_fd, int32_t count);
+int32_t sbrk(int32_t increment);
 
 /* system call helper functions */
 void parse_argument(uint8_t* command, uint8_t* executable, uint8_t* argument);
+void init_process_files(PCB* pcb_ptr);
 PCB* get_pcb(uint32_t process_num);
 PCB* get_curr_pcb();
 int32_t failed_calls();
+int32_t demand_load_page(uint32_t addr);
+int32_t file_busy(file_ops* fops, uint32_t inode, uint32_t uses);
 
 #endif
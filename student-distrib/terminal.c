@@ -5,6 +5,7 @@
 #include    "cursor.h"
 #include    "system_calls.h"
 #include    "paging.h"
+#include    "tlb.h"
 #include    "scheduler.h"
 
 #define SUCCESS         0
@@ -46,16 +47,9 @@ void terminal_init() {
             terminals[i].line_buffer[j] = '\0';
         }
         set_pte((terminals[i].video_page) >> 12, 1);
+        tlb_batch_add(terminals[i].video_page);
     }
-
-    //flush tlb
-    asm volatile (
-        "movl %%cr3, %%eax;"
-        "movl %%eax, %%cr3;"
-        :
-        :
-        : "%eax"    //clobbers eax
-    );
+    tlb_batch_flush();
 
     // terminal.cursor_x = 0;
     // terminal.cursor_y = 0;
@@ -245,6 +239,9 @@ void terminal_switch(int index){
 }
 
 void vidmap_switch(int index){
+    uint32_t flags;
+
+    cli_and_save(flags);
     // if the current running terminal is the one shows on the screen
     if(index == curr_term_index){
         page_table[VIDEO_MEM >> 12].page_address = VIDEO_MEM >> 12;
@@ -256,14 +253,11 @@ void vidmap_switch(int index){
         page_table_vidmap[VIDEO_MEM >> 12].page_address = terminals[index].video_page >> 12;
         page_table_vidmap[VIDEO_MEM >> 12].present = 0;
     }
-    //flush tlb
-    asm volatile (
-        "movl %%cr3, %%eax;"
-        "movl %%eax, %%cr3;"
-        :
-        :
-        : "%eax"    //clobbers eax
-    );
+    // only the two video pages moved, the rest of the tlb stays
+    tlb_batch_add(VIDEO_MEM);
+    tlb_batch_add(_132MB + VIDEO_MEM);
+    tlb_batch_flush();
+    restore_flags(flags);
 
     return;
 }
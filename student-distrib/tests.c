@@ -4,6 +4,18 @@
 #include "terminal.h"
 #include "RTC.h"
 #include "filesystem.h"
+#include "vfs.h"
+#include "tmpfs.h"
+#include "blkdev.h"
+#include "ata.h"
+#include "bcache.h"
+#include "virtio_blk.h"
+#include "buddy.h"
+#include "slab.h"
+#include "paging.h"
+#include "tlb.h"
+#include "system_calls.h"
+#include "scheduler.h"
 
 #define PASS 1
 #define FAIL 0
@@ -321,9 +333,1037 @@ int test_dir_read() {
 
 
 /* Checkpoint 3 tests */
+
+/* test_process_begin
+ * Description: set up a free process slot the way execute does, without loading a
+ *              program, so tests can make system calls against its fds, heap and mmap
+ *              window from the kernel. The file operations find their PCB from the
+ *              stack, so the slot must be the one whose PCB shares the kernel stack we
+ *              run on: pid 0 under launch_tests, before the shell is executed
+ * Inputs: prev_pid: set to the terminal's active process, for test_process_end
+ * Outputs: pid of the slot, -1 if it is in use or the stack belongs to another one
+ * Side Effects: makes it the terminal's active process and loads its page directory
+ */
+static int32_t test_process_begin(uint32_t* prev_pid) {
+	int32_t pid;
+	PCB* pcb_ptr;
+
+	for (pid = 0; pid < MAX_PROCESS && pid_array[pid] != 0; pid++);
+	if (pid == MAX_PROCESS || get_pcb(pid) != get_curr_pcb())
+		return -1;
+	pid_array[pid] = 1;
+	pcb_ptr = get_pcb(pid);
+	pcb_ptr->process_ID = pid;
+	pcb_ptr->parent_process_ID = pid;
+	pcb_ptr->exe_inode = (uint32_t)-1;	/* no program, so no file is busy running */
+	pcb_ptr->exe_length = 0;
+	reset_user_pages(pid);
+	init_user_directory(pid);
+	init_process_files(pcb_ptr);
+	*prev_pid = terminals[curr_index].active_pid;
+	terminals[curr_index].active_pid = pid;
+	switch_page_directory(pid);
+	return pid;
+}
+
+/* test_process_end
+ * Description: close what a test left open in a slot from test_process_begin and free it
+ * Inputs: pid: the slot
+ *         prev_pid: what test_process_begin saved
+ * Outputs: none
+ * Side Effects: loads the previous process's page directory, or the kernel's
+ */
+static void test_process_end(uint32_t pid, uint32_t prev_pid) {
+	int32_t fd;
+
+	for (fd = 2; fd < MAX_FILES; fd++)
+		if (get_pcb(pid)->fda[fd].flag != 0)
+			close(fd);
+	free_anon_pages(pid);
+	reset_user_pages(pid);
+	pid_array[pid] = 0;
+	terminals[curr_index].active_pid = prev_pid;
+	if (prev_pid != pid && pid_array[prev_pid] != 0)
+		switch_page_directory(prev_pid);
+	else
+		tlb_load_cr3(page_directory);
+}
+
+/* bytes_differ
+ * Description: compare two buffers
+ * Inputs: a, b: the buffers
+ *         n: number of bytes
+ * Outputs: 1 if they differ, 0 if they are the same
+ * Side Effects: None
+ */
+static int bytes_differ(const uint8_t* a, const uint8_t* b, uint32_t n) {
+	uint32_t i;
+	for (i = 0; i < n; i++)
+		if (a[i] != b[i])
+			return 1;
+	return 0;
+}
+
+#define RW_TEST_BYTES	600
+#define RW_TEST_CUT		250
+
+/* write_test
+ * Description: create a file by writing its name to the root directory, write to it and
+ *              append to it through an fd, cut it short with ftruncate, then unlink it
+ * Inputs: None
+ * Outputs: PASS if every step reads back what was written and the name is gone after
+ *          the unlink, FAIL otherwise
+ * Side Effects: creates and removes rw_test in the image
+ */
+int write_test() {
+	TEST_HEADER;
+	uint8_t out[RW_TEST_BYTES], in[2 * RW_TEST_BYTES];
+	uint32_t pid, prev_pid, i;
+	int32_t dir_fd, fd;
+	stat_t st;
+	dentry_t dt;
+	int result = PASS;
+
+	if ((pid = test_process_begin(&prev_pid)) == (uint32_t)-1)
+		return FAIL;
+	for (i = 0; i < RW_TEST_BYTES; i++)
+		out[i] = (uint8_t)(i * 7 + 1);
+	if ((dir_fd = open((uint8_t*)".")) == -1 || write(dir_fd, "rw_test", 7) != 7 ||
+		(fd = open((uint8_t*)"rw_test")) == -1) {
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+
+	/* the second write appends at the position the first one left */
+	if (write(fd, out, RW_TEST_BYTES) != RW_TEST_BYTES || write(fd, out, RW_TEST_BYTES) != RW_TEST_BYTES ||
+		fstat(fd, &st) == -1 || st.size != 2 * RW_TEST_BYTES)
+		result = FAIL;
+	if (lseek(fd, 0, SEEK_SET) != 0 || read(fd, in, sizeof(in)) != 2 * RW_TEST_BYTES ||
+		bytes_differ(in, out, RW_TEST_BYTES) || bytes_differ(in + RW_TEST_BYTES, out, RW_TEST_BYTES))
+		result = FAIL;
+
+	/* a running program's pages load from its inode, so it cannot be written */
+	get_pcb(pid)->exe_inode = st.inode_num;
+	if (lseek(fd, 0, SEEK_SET) != 0 || write(fd, out, RW_TEST_BYTES) != -1)
+		result = FAIL;
+	get_pcb(pid)->exe_inode = (uint32_t)-1;
+
+	if (ftruncate(fd, RW_TEST_CUT) != 0 || fstat(fd, &st) == -1 || st.size != RW_TEST_CUT ||
+		lseek(fd, 0, SEEK_SET) != 0 || read(fd, in, sizeof(in)) != RW_TEST_CUT ||
+		bytes_differ(in, out, RW_TEST_CUT))
+		result = FAIL;
+
+	/* an open file cannot be unlinked */
+	if (unlink((uint8_t*)"rw_test") != -1)
+		result = FAIL;
+	close(fd);
+	if (unlink((uint8_t*)"rw_test") != 0 || read_dentry_by_name((uint8_t*)"rw_test", &dt) != -1 ||
+		open((uint8_t*)"rw_test") != -1)
+		result = FAIL;
+	test_process_end(pid, prev_pid);
+	return result;
+}
+
+#define DENTS_TEST_BATCH	4
+
+/* getdents_test
+ * Description: list the root directory with getdents, a few entries per call, and check
+ *              each entry against a lookup of its name
+ * Inputs: None
+ * Outputs: PASS if every entry matches its dentry, frame0.txt is listed with its length,
+ *          and a buffer too small for one entry is refused, FAIL otherwise
+ * Side Effects: None
+ */
+int getdents_test() {
+	TEST_HEADER;
+	dirent_t entries[DENTS_TEST_BATCH];
+	int8_t name[FILENAME_LEN + 1];
+	uint32_t pid, prev_pid, total = 0, found = 0;
+	int32_t fd, bytes, i;
+	dentry_t dt;
+	int result = PASS;
+
+	if ((pid = test_process_begin(&prev_pid)) == (uint32_t)-1)
+		return FAIL;
+	if ((fd = open((uint8_t*)".")) == -1 || getdents(fd, entries, sizeof(dirent_t) - 1) != -1) {
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+	while ((bytes = getdents(fd, entries, sizeof(entries))) > 0) {
+		for (i = 0; i < bytes / (int32_t)sizeof(dirent_t); i++) {
+			strncpy(name, entries[i].filename, FILENAME_LEN);
+			name[FILENAME_LEN] = '\0';
+			if (read_dentry_by_name((uint8_t*)name, &dt) != 0 || dt.file_type != entries[i].file_type ||
+				(dt.file_type == REGULAR_TYPE && (dt.inode_num != entries[i].inode_num ||
+				file_length(dt.inode_num) != entries[i].size)))
+				result = FAIL;
+			if (strncmp(name, "frame0.txt", FILENAME_LEN) == 0 && entries[i].size == 187)
+				found = 1;
+			total++;
+		}
+	}
+	if (bytes != 0 || total == 0 || !found)
+		result = FAIL;
+	test_process_end(pid, prev_pid);
+	return result;
+}
+
+#define SEEK_TEST_TAIL	16
+
+/* lseek_pread_test
+ * Description: seek around frame0.txt and read its tail with read and with pread
+ * Inputs: None
+ * Outputs: PASS if both reads match read_data, pread leaves the position alone and a
+ *          seek before the start is refused, FAIL otherwise
+ * Side Effects: None
+ */
+int lseek_pread_test() {
+	TEST_HEADER;
+	uint8_t expect[SEEK_TEST_TAIL], by_read[SEEK_TEST_TAIL], by_pread[SEEK_TEST_TAIL];
+	uint32_t pid, prev_pid;
+	int32_t fd, size;
+	stat_t st;
+	int result = PASS;
+
+	if ((pid = test_process_begin(&prev_pid)) == (uint32_t)-1)
+		return FAIL;
+	if ((fd = open((uint8_t*)"frame0.txt")) == -1 || fstat(fd, &st) == -1) {
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+	size = st.size;
+	if (lseek(fd, 0, SEEK_END) != size || read(fd, by_read, SEEK_TEST_TAIL) != 0)
+		result = FAIL;
+	read_data(st.inode_num, size - SEEK_TEST_TAIL, expect, SEEK_TEST_TAIL);
+	if (lseek(fd, -SEEK_TEST_TAIL, SEEK_CUR) != size - SEEK_TEST_TAIL ||
+		read(fd, by_read, SEEK_TEST_TAIL) != SEEK_TEST_TAIL || bytes_differ(by_read, expect, SEEK_TEST_TAIL))
+		result = FAIL;
+	if (lseek(fd, 0, SEEK_SET) != 0 ||
+		pread(fd, by_pread, SEEK_TEST_TAIL, size - SEEK_TEST_TAIL) != SEEK_TEST_TAIL ||
+		bytes_differ(by_pread, expect, SEEK_TEST_TAIL) || lseek(fd, 0, SEEK_CUR) != 0)
+		result = FAIL;
+	if (lseek(fd, -1, SEEK_SET) != -1 || lseek(fd, 0, SEEK_CUR) != 0)
+		result = FAIL;
+	test_process_end(pid, prev_pid);
+	return result;
+}
+
+#define MMAP_TEST_BYTES	(PAGE_SIZE + 100)
+
+/* mmap_test
+ * Description: map a new file and compare the mapping with the file, check the file
+ *              cannot be unlinked while mapped, then map anonymous memory and write it
+ * Inputs: None
+ * Outputs: PASS if the mapping holds the file's bytes, the unlink is refused until the
+ *          munmap, and anonymous pages start zeroed, FAIL otherwise; the file part is
+ *          skipped when the filesystem cannot hand out its pages
+ * Side Effects: creates and removes mmap_test in the image
+ */
+int mmap_test() {
+	TEST_HEADER;
+	uint8_t out[RW_TEST_BYTES];
+	uint32_t pid, prev_pid, i;
+	int32_t fd, addr, anon;
+	int result = PASS;
+
+	if ((pid = test_process_begin(&prev_pid)) == (uint32_t)-1)
+		return FAIL;
+	for (i = 0; i < RW_TEST_BYTES; i++)
+		out[i] = (uint8_t)(i * 13 + 5);
+	if (fs_create((uint8_t*)"mmap_test") != 0 || (fd = open((uint8_t*)"mmap_test")) == -1) {
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+	for (i = 0; i + RW_TEST_BYTES <= MMAP_TEST_BYTES; i += RW_TEST_BYTES)
+		write(fd, out, RW_TEST_BYTES);
+	write(fd, out, MMAP_TEST_BYTES - i);
+
+	if ((addr = mmap(fd, 0)) == -1) {
+		/* only allowed when the filesystem has no pages to hand out, e.g. on the disk */
+		if (file_page(fd, 0) != NULL)
+			result = FAIL;
+	} else {
+		for (i = 0; i < MMAP_TEST_BYTES; i++)
+			if (((uint8_t*)addr)[i] != out[i % RW_TEST_BYTES])
+				result = FAIL;
+		close(fd);
+		if (unlink((uint8_t*)"mmap_test") != -1)
+			result = FAIL;
+		if (munmap((void*)addr, MMAP_TEST_BYTES) != 0)
+			result = FAIL;
+	}
+	close(fd);
+	if (unlink((uint8_t*)"mmap_test") != 0)
+		result = FAIL;
+
+	if ((anon = mmap(MMAP_ANON, 2 * PAGE_SIZE)) == -1) {
+		result = FAIL;
+	} else {
+		for (i = 0; i < 2 * PAGE_SIZE; i++)
+			if (((uint8_t*)anon)[i] != 0)
+				result = FAIL;
+		((uint8_t*)anon)[PAGE_SIZE] = 1;
+		if (munmap((void*)anon, 2 * PAGE_SIZE) != 0)
+			result = FAIL;
+	}
+	test_process_end(pid, prev_pid);
+	return result;
+}
+
+/* subdir_test
+ * Description: make a subdirectory holding one file and look names up through it
+ * Inputs: None
+ * Outputs: PASS if the path finds the file and only the path does, the directory cannot
+ *          be removed while it holds the file, and both names are gone after removal,
+ *          FAIL otherwise
+ * Side Effects: creates and removes sub_test and sub_test/inner in the image
+ */
+int subdir_test() {
+	TEST_HEADER;
+	dentry_t dt;
+	int result = PASS;
+
+	if (fs_mkdir((uint8_t*)"sub_test") != 0)
+		return FAIL;
+	if (fs_create((uint8_t*)"sub_test/inner") != 0 ||
+		read_dentry_by_name((uint8_t*)"sub_test/inner", &dt) != 0 || dt.file_type != REGULAR_TYPE ||
+		read_dentry_by_name((uint8_t*)"/sub_test//inner", &dt) != 0)
+		result = FAIL;
+	if (read_dentry_by_name((uint8_t*)"inner", &dt) != -1 ||
+		read_dentry_by_name((uint8_t*)"sub_test/missing", &dt) != -1 ||
+		read_dentry_by_name((uint8_t*)"frame0.txt/inner", &dt) != -1)
+		result = FAIL;
+	if (fs_delete((uint8_t*)"sub_test") != -1 || fs_delete((uint8_t*)"sub_test/inner") != 0 ||
+		read_dentry_by_name((uint8_t*)"sub_test/inner", &dt) != -1)
+		result = FAIL;
+	if (fs_delete((uint8_t*)"sub_test") != 0 || read_dentry_by_name((uint8_t*)"sub_test", &dt) != -1)
+		result = FAIL;
+	return result;
+}
+
+#define SBRK_TEST_BYTES	(2 * PAGE_SIZE + 100)
+
+/* sbrk_test
+ * Description: grow the heap, dirty it, give it back and grow it again
+ * Inputs: None
+ * Outputs: PASS if the heap starts at ANON_ADDR and reads as zeros both times, FAIL otherwise
+ * Side Effects: None
+ */
+int sbrk_test() {
+	TEST_HEADER;
+	uint32_t pid, prev_pid, i;
+	uint8_t* heap;
+	int result = PASS;
+
+	if ((pid = test_process_begin(&prev_pid)) == (uint32_t)-1)
+		return FAIL;
+	if ((heap = (uint8_t*)sbrk(SBRK_TEST_BYTES)) != (uint8_t*)ANON_ADDR) {
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+	for (i = 0; i < SBRK_TEST_BYTES; i++) {
+		if (heap[i] != 0)
+			result = FAIL;
+		heap[i] = 0xA5;
+	}
+	/* the pages given back are freed, so growing again must not show the old bytes */
+	if (sbrk(-SBRK_TEST_BYTES) != (int32_t)heap + SBRK_TEST_BYTES || sbrk(SBRK_TEST_BYTES) != (int32_t)heap)
+		result = FAIL;
+	for (i = 0; i < SBRK_TEST_BYTES; i++)
+		if (heap[i] != 0)
+			result = FAIL;
+	test_process_end(pid, prev_pid);
+	return result;
+}
+
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* Performance tests */
+
+#define BENCH_ROUNDS 100
+
+/* time a statement run rounds times, storing the cycles taken in cycles */
+#define BENCH_TIME(cycles, rounds, ...)	\
+	do {	\
+		uint32_t bench_round, bench_start = rdtsc();	\
+		for (bench_round = 0; bench_round < (rounds); bench_round++) {	\
+			__VA_ARGS__;	\
+		}	\
+		(cycles) = rdtsc() - bench_start;	\
+	} while (0)
+
+/* bench_report
+ * Description: print one figure of a benchmark
+ * Inputs: what: what was timed
+ *         cycles: cycles it took
+ *         ops: operations done in that time
+ *         unit: what one operation is
+ * Outputs: none
+ * Side Effects: prints "<what>: <cycles per op> cycles per <unit>"
+ */
+static void bench_report(const int8_t* what, uint32_t cycles, uint32_t ops, const int8_t* unit) {
+	printf("  %s: %u cycles per %s\n", what, cycles / (ops ? ops : 1), unit);
+}
+
+/* bench_name
+ * Description: build a benchmark file name like "<prefix>_<n>"
+ * Inputs: buf: buffer of at least FILENAME_LEN + 1 bytes
+ *         prefix: name prefix
+ *         n: two-digit number appended to the prefix
+ * Outputs: none
+ */
+static void bench_name(uint8_t* buf, const int8_t* prefix, int32_t n) {
+	int32_t len = strlen(prefix);
+	strcpy((int8_t*)buf, prefix);
+	buf[len] = '_';
+	buf[len + 1] = '0' + (n / 10) % 10;
+	buf[len + 2] = '0' + n % 10;
+	buf[len + 3] = '\0';
+}
+
+/* dentry_lookup_bench
+ * Description: time read_dentry_by_name against the linear read_dentry_by_scan
+ *              for hits and misses on a synthetic image with 63 dentries
+ * Inputs: None
+ * Outputs: PASS if both lookups agree on every name, FAIL otherwise
+ * Side Effects: temporarily points the filesystem at the synthetic image
+ */
+int dentry_lookup_bench() {
+	TEST_HEADER;
+	int32_t i;
+	int32_t result = PASS;
+	uint32_t hash_hit, scan_hit, hash_miss, scan_miss;
+	uint8_t names[DENTRY_NUM - 1][FILENAME_LEN + 1];
+	uint8_t misses[DENTRY_NUM - 1][FILENAME_LEN + 1];
+	unsigned int saved_base = (unsigned int)boot_block_ptr;
+	boot_block_t* bench_boot_block;
+	dentry_t dt;
+
+	if ((bench_boot_block = kmalloc(sizeof(boot_block_t))) == NULL)
+		return FAIL;
+	/* names of growing length so both short and long names are exercised */
+	memset(bench_boot_block, 0, sizeof(boot_block_t));
+	bench_boot_block->dir_count = DENTRY_NUM - 1;
+	for (i = 0; i < DENTRY_NUM - 1; i++) {
+		bench_name(names[i], (int8_t*)"verylongbenchmarkname" + (i % 20), i);
+		bench_name(misses[i], (int8_t*)"missingbenchmarkname" + (i % 19), i);
+		strncpy(bench_boot_block->direntries[i].filename, (int8_t*)names[i], FILENAME_LEN);
+		bench_boot_block->direntries[i].file_type = 2;
+		bench_boot_block->direntries[i].inode_num = i;
+	}
+	init_filesystem((unsigned int)bench_boot_block);
+
+	for (i = 0; i < DENTRY_NUM - 1; i++) {
+		if (read_dentry_by_name(names[i], &dt) != 0 || dt.inode_num != i ||
+			read_dentry_by_name(misses[i], &dt) != -1) {
+			result = FAIL;
+		}
+	}
+
+	BENCH_TIME(hash_hit, BENCH_ROUNDS,
+		for (i = 0; i < DENTRY_NUM - 1; i++)
+			read_dentry_by_name(names[i], &dt));
+	BENCH_TIME(scan_hit, BENCH_ROUNDS,
+		for (i = 0; i < DENTRY_NUM - 1; i++)
+			read_dentry_by_scan(names[i], &dt));
+	BENCH_TIME(hash_miss, BENCH_ROUNDS,
+		for (i = 0; i < DENTRY_NUM - 1; i++)
+			read_dentry_by_name(misses[i], &dt));
+	BENCH_TIME(scan_miss, BENCH_ROUNDS,
+		for (i = 0; i < DENTRY_NUM - 1; i++)
+			read_dentry_by_scan(misses[i], &dt));
+
+	init_filesystem(saved_base);
+	kfree(bench_boot_block);
+
+	printf("lookups among 63 dentries\n");
+	bench_report("hit, hashed", hash_hit, BENCH_ROUNDS * (DENTRY_NUM - 1), "lookup");
+	bench_report("hit, scan", scan_hit, BENCH_ROUNDS * (DENTRY_NUM - 1), "lookup");
+	bench_report("miss, hashed", hash_miss, BENCH_ROUNDS * (DENTRY_NUM - 1), "lookup");
+	bench_report("miss, scan", scan_miss, BENCH_ROUNDS * (DENTRY_NUM - 1), "lookup");
+	return result;
+}
+
+/* mount_bench
+ * Description: time mounting the boot image and looking up every top level name; images
+ *              from tools/createfs carry a name table, so mounting skips building the index
+ * Inputs: None
+ * Outputs: PASS if every top level name is found, FAIL otherwise
+ * Side Effects: remounts the image, which also rebuilds the allocation bitmaps
+ */
+int mount_bench() {
+	TEST_HEADER;
+	int32_t i, count;
+	int32_t result = PASS;
+	uint32_t mount_cycles, lookup_cycles;
+	uint8_t names[DENTRY_NUM - 1][FILENAME_LEN + 1];
+	unsigned int base = (unsigned int)boot_block_ptr;
+	dentry_t dt;
+
+	count = boot_block_ptr->dir_count;
+	for (i = 0; i < count; i++) {
+		strncpy((int8_t*)names[i], dentry_ptr[i].filename, FILENAME_LEN);
+		names[i][FILENAME_LEN] = '\0';
+	}
+
+	BENCH_TIME(mount_cycles, BENCH_ROUNDS, init_filesystem(base));
+	BENCH_TIME(lookup_cycles, BENCH_ROUNDS,
+		for (i = 0; i < count; i++)
+			if (read_dentry_by_name(names[i], &dt) != 0)
+				result = FAIL);
+
+	printf("name table in image: %s\n",
+		(((name_table_t*)boot_block_ptr->reserved)->magic == NAME_TABLE_MAGIC) ? "yes" : "no");
+	bench_report("mount", mount_cycles, BENCH_ROUNDS, "mount");
+	bench_report("lookup", lookup_cycles, BENCH_ROUNDS * count, "lookup");
+	return result;
+}
+
+#define READ_BENCH_ROUNDS	10
+#define READ_BENCH_BUF_SIZE	(40 * 1024)
+
+static uint8_t* read_bench_buf;	/* kmalloc'd by the benchmarks that read into it */
+
+/* read_data_bench_file
+ * Description: time whole-file reads through read_data_by_block and read_data
+ * Inputs: fname: file to read
+ * Outputs: PASS if both paths return the same byte count, FAIL otherwise
+ * Side Effects: prints cycles per KB for both paths
+ */
+static int read_data_bench_file(const uint8_t* fname) {
+	dentry_t dt;
+	int32_t block_bytes = 0, extent_bytes = 0;
+	uint32_t block_cycles, extent_cycles;
+
+	if (read_dentry_by_name(fname, &dt) != 0) {
+		printf("%s not found\n", fname);
+		return FAIL;
+	}
+
+	BENCH_TIME(block_cycles, READ_BENCH_ROUNDS,
+		block_bytes = read_data_by_block(dt.inode_num, 0, read_bench_buf, READ_BENCH_BUF_SIZE));
+	BENCH_TIME(extent_cycles, READ_BENCH_ROUNDS,
+		extent_bytes = read_data(dt.inode_num, 0, read_bench_buf, READ_BENCH_BUF_SIZE));
+
+	printf("%s (%d bytes)\n", fname, extent_bytes);
+	bench_report("per block", block_cycles, block_bytes * READ_BENCH_ROUNDS / 1024, "KB");
+	bench_report("per extent", extent_cycles, extent_bytes * READ_BENCH_ROUNDS / 1024, "KB");
+	return (block_bytes == extent_bytes) ? PASS : FAIL;
+}
+
+/* read_data_bench
+ * Description: compare read_data throughput before and after extent coalescing
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ */
+int read_data_bench() {
+	TEST_HEADER;
+	int result = PASS;
+
+	if ((read_bench_buf = kmalloc(READ_BENCH_BUF_SIZE)) == NULL)
+		return FAIL;
+	result &= read_data_bench_file((uint8_t*)"verylargetextwithverylongname.tx");
+	result &= read_data_bench_file((uint8_t*)"fish");
+	kfree(read_bench_buf);
+	return result;
+}
+
+#define TMPFS_BENCH_APPEND	100
+#define TMPFS_BENCH_BYTES	(512 * 1024)
+
+/* tmpfs_append_bench
+ * Description: time small appends to a tmpfs file, early in the file and near the end,
+ *              then read the whole file back
+ * Inputs: None
+ * Outputs: PASS if every append and read succeeds, FAIL otherwise
+ * Side Effects: creates and removes /tmp/bench
+ */
+int tmpfs_append_bench() {
+	TEST_HEADER;
+	vnode_t vnode;
+	uint32_t inode, offset, first_cycles = 0, last_cycles = 0, cycles;
+	int result = PASS;
+
+	if ((read_bench_buf = kmalloc(READ_BENCH_BUF_SIZE)) == NULL)
+		return FAIL;
+	if (vfs_create((uint8_t*)"/tmp/bench") || vfs_lookup((uint8_t*)"/tmp/bench", &vnode)) {
+		printf("tmpfs not mounted\n");
+		kfree(read_bench_buf);
+		return FAIL;
+	}
+	inode = vnode.inode & TMPFS_INDEX_MASK;
+
+	for (offset = 0; offset + TMPFS_BENCH_APPEND <= TMPFS_BENCH_BYTES; offset += TMPFS_BENCH_APPEND) {
+		BENCH_TIME(cycles, 1,
+			if (tmpfs_write_data(inode, offset, read_bench_buf, TMPFS_BENCH_APPEND) != TMPFS_BENCH_APPEND)
+				result = FAIL);
+		if (offset < TMPFS_BENCH_BYTES / 8)
+			first_cycles += cycles;
+		else if (offset >= TMPFS_BENCH_BYTES - TMPFS_BENCH_BYTES / 8)
+			last_cycles += cycles;
+	}
+
+	BENCH_TIME(cycles, 1,
+		for (offset = 0; offset < TMPFS_BENCH_BYTES && result == PASS; offset += READ_BENCH_BUF_SIZE)
+			if (tmpfs_read_data(inode, offset, read_bench_buf, READ_BENCH_BUF_SIZE) <= 0)
+				result = FAIL);
+	vfs_unlink((uint8_t*)"/tmp/bench");
+	kfree(read_bench_buf);
+
+	printf("%d byte appends\n", TMPFS_BENCH_APPEND);
+	bench_report("first eighth", first_cycles, TMPFS_BENCH_BYTES / 8 / TMPFS_BENCH_APPEND, "append");
+	bench_report("last eighth", last_cycles, TMPFS_BENCH_BYTES / 8 / TMPFS_BENCH_APPEND, "append");
+	bench_report("read back", cycles, TMPFS_BENCH_BYTES / 1024, "KB");
+	return result;
+}
+
+
+/* sendfile_bench
+ * Description: print the largest text file through an fd with read and write, a KB at a
+ *              time through a buffer standing in for user memory, then with sendfile
+ * Inputs: None
+ * Outputs: PASS if both paths move the whole file, FAIL otherwise
+ * Side Effects: prints the file twice; runs in a process slot of its own
+ */
+int sendfile_bench() {
+	TEST_HEADER;
+	const uint8_t* fname = (uint8_t*)"verylargetextwithverylongname.tx";
+	uint32_t pid, prev_pid, length, bounce_cycles, direct_cycles;
+	int32_t fd, cnt, bounce_bytes = 0, direct_bytes = 0;
+	stat_t st;
+
+	if ((pid = test_process_begin(&prev_pid)) == (uint32_t)-1)
+		return FAIL;
+	if ((fd = open(fname)) == -1 || fstat(fd, &st) == -1) {
+		printf("%s not found\n", fname);
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+	if ((read_bench_buf = kmalloc(1024)) == NULL) {
+		test_process_end(pid, prev_pid);
+		return FAIL;
+	}
+	length = st.size;
+
+	BENCH_TIME(bounce_cycles, 1,
+		while ((cnt = read(fd, read_bench_buf, 1024)) > 0) {
+			write(1, read_bench_buf, cnt);
+			bounce_bytes += cnt;
+		});
+	lseek(fd, 0, SEEK_SET);
+	BENCH_TIME(direct_cycles, 1,
+		while ((cnt = sendfile(1, fd, BLOCK_SIZE)) > 0)
+			direct_bytes += cnt);
+	kfree(read_bench_buf);
+	test_process_end(pid, prev_pid);
+
+	printf("\n%s (%u bytes)\n", fname, length);
+	bench_report("read+write", bounce_cycles, length / 1024, "KB");
+	bench_report("sendfile", direct_cycles, length / 1024, "KB");
+	return (bounce_bytes == (int32_t)length && direct_bytes == (int32_t)length) ? PASS : FAIL;
+}
+
+#define DISK_BENCH_ROUNDS	20
+#define DISK_BENCH_SECTORS	(READ_BENCH_BUF_SIZE / SECTOR_SIZE)
+
+/* disk_bench
+ * Description: read the start of the first ATA disk with PIO and then with DMA
+ * Inputs: None
+ * Outputs: PASS if both modes read the same bytes, FAIL otherwise
+ * Side Effects: leaves the drive in DMA mode when the controller supports it
+ */
+int disk_bench() {
+	TEST_HEADER;
+	block_dev_t* dev;
+	uint32_t i, pio_cycles, dma_cycles;
+	uint8_t* dma_buf;
+	int result = PASS;
+
+	for (i = 0; (dev = block_dev_at(i)) != NULL; i++)
+		if (dev->name[0] == 'h' && dev->name[1] == 'd' && dev->sectors >= DISK_BENCH_SECTORS)
+			break;
+	if (dev == NULL) {
+		printf("no ATA disk\n");
+		return FAIL;
+	}
+
+	read_bench_buf = kmalloc(READ_BENCH_BUF_SIZE);
+	dma_buf = kmalloc(READ_BENCH_BUF_SIZE);
+	if (read_bench_buf == NULL || dma_buf == NULL) {
+		kfree(read_bench_buf);
+		kfree(dma_buf);
+		return FAIL;
+	}
+
+	ata_set_dma(dev, 0);
+	BENCH_TIME(pio_cycles, DISK_BENCH_ROUNDS,
+		if (blk_read(dev, 0, DISK_BENCH_SECTORS, read_bench_buf) != 0)
+			result = FAIL);
+	ata_set_dma(dev, 1);
+	BENCH_TIME(dma_cycles, DISK_BENCH_ROUNDS,
+		if (blk_read(dev, 0, DISK_BENCH_SECTORS, dma_buf) != 0)
+			result = FAIL);
+
+	printf("%s: %u sectors per read\n", dev->name, DISK_BENCH_SECTORS);
+	bench_report("PIO", pio_cycles, DISK_BENCH_ROUNDS, "read");
+	bench_report("DMA", dma_cycles, DISK_BENCH_ROUNDS, "read");
+	for (i = 0; i < READ_BENCH_BUF_SIZE; i++)
+		if (read_bench_buf[i] != dma_buf[i])
+			result = FAIL;
+	kfree(dma_buf);
+	kfree(read_bench_buf);
+	return result;
+}
+
+/* bcache_bench_file
+ * Description: read a whole file the way execute loads a program, and report how the
+ *              buffer cache served it
+ * Inputs: fname: file to read
+ *         run: run number, for the report
+ * Outputs: PASS if the whole file was read, FAIL otherwise
+ * Side Effects: prints cycles, hits, misses and blocks read ahead
+ */
+static int bcache_bench_file(const uint8_t* fname, uint32_t run) {
+	dentry_t dt;
+	bcache_stats_t before = bcache_stats;
+	uint32_t cycles, length;
+	int32_t bytes;
+
+	if (read_dentry_by_name(fname, &dt) != 0)
+		return FAIL;
+	length = file_length(dt.inode_num);
+	if (length > READ_BENCH_BUF_SIZE)
+		length = READ_BENCH_BUF_SIZE;
+	BENCH_TIME(cycles, 1, bytes = read_data(dt.inode_num, 0, read_bench_buf, length));
+	printf("%s run %u: hits %u misses %u readahead %u\n", fname, run,
+		bcache_stats.hits - before.hits, bcache_stats.misses - before.misses,
+		bcache_stats.ra_blocks - before.ra_blocks);
+	bench_report("load", cycles, 1, "load");
+	return (bytes == length) ? PASS : FAIL;
+}
+
+/* bcache_bench
+ * Description: load shell and grep twice each; with the root on a disk the second load
+ *              should be served from the buffer cache without misses
+ * Inputs: None
+ * Outputs: PASS if the second loads had no misses, FAIL otherwise
+ * Side Effects: prints one line per load
+ */
+int bcache_bench() {
+	TEST_HEADER;
+	uint32_t misses;
+	int result = PASS;
+
+	if ((read_bench_buf = kmalloc(READ_BENCH_BUF_SIZE)) == NULL)
+		return FAIL;
+	if (bcache_bench_file((uint8_t*)"shell", 1) == FAIL || bcache_bench_file((uint8_t*)"grep", 1) == FAIL)
+		result = FAIL;
+	misses = bcache_stats.misses;
+	if (result == FAIL || bcache_bench_file((uint8_t*)"shell", 2) == FAIL ||
+		bcache_bench_file((uint8_t*)"grep", 2) == FAIL || bcache_stats.misses != misses)
+		result = FAIL;
+	kfree(read_bench_buf);
+	return result;
+}
+
+#define VIRTIO_BENCH_READS	1024
+#define VIRTIO_BENCH_ORDER	5	/* buddy block holding one page per read in flight */
+#define VIRTIO_BENCH_DEPTH	(1 << VIRTIO_BENCH_ORDER)
+
+static uint8_t* virtio_bench_pages;	/* from the buddy allocator while virtio_bench runs */
+static volatile uint32_t virtio_bench_outstanding;
+static volatile uint32_t virtio_bench_errors;
+
+/* virtio_bench_done
+ * Description: blk_done_t of the queued reads
+ * Inputs: arg: unused
+ *         status: 0 for success
+ * Outputs: none
+ * Side Effects: counts the read as finished
+ */
+static void virtio_bench_done(void* arg, int32_t status) {
+	if (status != 0)
+		virtio_bench_errors++;
+	virtio_bench_outstanding--;
+}
+
+/* virtio_bench_block
+ * Description: block number of the i-th read, in BLK_PAGE_SIZE blocks
+ * Inputs: i: read number
+ *         blocks: blocks on the device
+ *         random: 0 for sequential blocks, 1 for a scattered sequence
+ * Outputs: the block
+ */
+static uint32_t virtio_bench_block(uint32_t i, uint32_t blocks, uint32_t random) {
+	if (!random)
+		return i % blocks;
+	return (i * 2654435761U) % blocks;
+}
+
+/* virtio_bench_reads
+ * Description: read VIRTIO_BENCH_READS blocks of 4KB, waiting for each one or keeping
+ *              up to depth in flight
+ * Inputs: dev: the disk
+ *         random: 0 for sequential blocks, 1 for a scattered sequence
+ *         depth: reads in flight at once
+ * Outputs: none
+ * Side Effects: counts failed reads in virtio_bench_errors
+ */
+static void virtio_bench_reads(block_dev_t* dev, uint32_t random, uint32_t depth) {
+	uint32_t blocks = dev->sectors / BLK_PAGE_SECTORS;
+	uint32_t i, flags;
+	uint8_t* page;
+
+	for (i = 0; i < VIRTIO_BENCH_READS; i++) {
+		page = virtio_bench_pages + (i % VIRTIO_BENCH_DEPTH) * BLK_PAGE_SIZE;
+		if (depth == 1) {
+			if (blk_read(dev, virtio_bench_block(i, blocks, random) * BLK_PAGE_SECTORS, BLK_PAGE_SECTORS, page) != 0)
+				virtio_bench_errors++;
+			continue;
+		}
+		while (virtio_bench_outstanding >= depth)
+			dev->poll(dev);
+		cli_and_save(flags);	//the interrupt decrements it
+		virtio_bench_outstanding++;
+		restore_flags(flags);
+		while (blk_start_read(dev, virtio_bench_block(i, blocks, random) * BLK_PAGE_SECTORS, 1, &page,
+				virtio_bench_done, NULL) != 0)
+			dev->poll(dev);
+	}
+	while (virtio_bench_outstanding > 0)
+		dev->poll(dev);
+}
+
+/* virtio_bench_run
+ * Description: time one pass of virtio_bench_reads
+ * Inputs: dev: the disk
+ *         random: 0 for sequential blocks, 1 for a scattered sequence
+ *         depth: reads in flight at once
+ * Outputs: PASS if every read succeeded, FAIL otherwise
+ * Side Effects: prints cycles per read and how completions were batched
+ */
+static int virtio_bench_run(block_dev_t* dev, uint32_t random, uint32_t depth) {
+	virtio_blk_t* vb = dev->data;
+	uint32_t cycles, interrupts, completions;
+
+	virtio_bench_errors = 0;
+	interrupts = vb->interrupts;
+	completions = vb->completions;
+	vb->max_batch = 0;
+	BENCH_TIME(cycles, 1, virtio_bench_reads(dev, random, depth));
+
+	printf("%s %s depth %u: %u interrupts for %u reads, batch up to %u\n",
+		dev->name, random ? "random" : "sequential", depth,
+		vb->interrupts - interrupts, vb->completions - completions, vb->max_batch);
+	bench_report("read", cycles, VIRTIO_BENCH_READS, "read");
+	return (virtio_bench_errors == 0) ? PASS : FAIL;
+}
+
+/* virtio_bench
+ * Description: 4KB read throughput of the first virtio disk, sequential and random, one
+ *              read at a time and with the queue kept full
+ * Inputs: None
+ * Outputs: PASS if every read succeeded, FAIL otherwise
+ * Side Effects: prints one line per run
+ */
+int virtio_bench() {
+	TEST_HEADER;
+	block_dev_t* dev;
+	uint32_t i;
+	int result = PASS;
+
+	for (i = 0; (dev = block_dev_at(i)) != NULL; i++)
+		if (dev->name[0] == 'v' && dev->name[1] == 'd' && dev->sectors >= BLK_PAGE_SECTORS)
+			break;
+	if (dev == NULL) {
+		printf("no virtio disk\n");
+		return FAIL;
+	}
+	/* page aligned and identity mapped, as the device reads into physical pages */
+	if ((virtio_bench_pages = (uint8_t*)buddy_alloc(VIRTIO_BENCH_ORDER)) == NULL)
+		return FAIL;
+	for (i = 0; i < 4; i++)
+		if (virtio_bench_run(dev, i & 1, (i & 2) ? VIRTIO_BENCH_DEPTH : 1) == FAIL)
+			result = FAIL;
+	buddy_free((uint32_t)virtio_bench_pages, VIRTIO_BENCH_ORDER);
+	return result;
+}
+
+#define BUDDY_BENCH_FRAMES	(FRAME_SIZE / sizeof(uint32_t))	/* addresses one frame holds */
+#define BUDDY_BENCH_ROUNDS	100
+
+static uint32_t* buddy_bench_addrs;	/* a frame from the buddy allocator while buddy_bench runs */
+
+/* buddy_bench
+ * Description: time 4KB allocations and frees from the buddy allocator, frees in the
+ *              reverse order so they merge back, then 4MB allocation and free pairs
+ * Inputs: None
+ * Outputs: PASS if every block came back aligned and the free count is restored, FAIL otherwise
+ * Side Effects: prints cycles per call
+ */
+int buddy_bench() {
+	TEST_HEADER;
+	uint32_t i, alloc_cycles, free_cycles, large_cycles, addr, free_before;
+	int result = PASS;
+
+	if ((buddy_bench_addrs = (uint32_t*)buddy_alloc(ORDER_4KB)) == NULL)
+		return FAIL;
+	free_before = buddy_stats.free_frames;
+
+	BENCH_TIME(alloc_cycles, 1,
+		for (i = 0; i < BUDDY_BENCH_FRAMES; i++)
+			buddy_bench_addrs[i] = buddy_alloc(ORDER_4KB));
+	for (i = 0; i < BUDDY_BENCH_FRAMES; i++)
+		if (buddy_bench_addrs[i] == 0)
+			result = FAIL;
+	/* frees in the reverse order so they merge back; buddy_free ignores 0 */
+	BENCH_TIME(free_cycles, 1,
+		for (i = BUDDY_BENCH_FRAMES; i > 0; i--)
+			buddy_free(buddy_bench_addrs[i - 1], ORDER_4KB));
+
+	BENCH_TIME(large_cycles, BUDDY_BENCH_ROUNDS,
+		if ((addr = buddy_alloc(ORDER_4MB)) == 0 || (addr & (FRAME_SIZE * (1 << ORDER_4MB) - 1)))
+			result = FAIL;
+		buddy_free(addr, ORDER_4MB));
+
+	bench_report("4KB alloc", alloc_cycles, BUDDY_BENCH_FRAMES, "call");
+	bench_report("4KB free", free_cycles, BUDDY_BENCH_FRAMES, "call");
+	bench_report("4MB alloc+free", large_cycles, BUDDY_BENCH_ROUNDS, "pair");
+	if (buddy_stats.free_frames != free_before)
+		result = FAIL;
+	buddy_free((uint32_t)buddy_bench_addrs, ORDER_4KB);
+	return result;
+}
+
+#define SLAB_BENCH_OBJS		(FRAME_SIZE / sizeof(void*))	/* pointers one frame holds */
+#define SLAB_BENCH_ROUNDS	1000
+#define SLAB_BENCH_LARGE	8192
+
+static void** slab_bench_objs;	/* a frame from the buddy allocator while slab_bench runs */
+
+/* slab_active
+ * Description: count the objects handed out by all slab caches
+ * Inputs: None
+ * Outputs: the count
+ * Side Effects: None
+ */
+static uint32_t slab_active() {
+	uint32_t i, active = 0;
+	for (i = 0; i < slab_num_caches; i++)
+		active += slab_caches[i].active;
+	return active;
+}
+
+/* slab_bench
+ * Description: time kmalloc and kfree of 64 byte objects, first growing the cache to hold
+ *              SLAB_BENCH_OBJS of them, then as alloc and free pairs on a warm cache, then
+ *              for blocks too large for a size class
+ * Inputs: None
+ * Outputs: PASS if every object is cache line aligned and the caches end as they began, FAIL otherwise
+ * Side Effects: prints cycles per call
+ */
+int slab_bench() {
+	TEST_HEADER;
+	uint32_t i, alloc_cycles, free_cycles, pair_cycles, large_cycles;
+	uint32_t active_before = slab_active();
+	void* obj;
+	int result = PASS;
+
+	/* not kmalloc'd, which would count as a large block still held */
+	if ((slab_bench_objs = (void**)buddy_alloc(ORDER_4KB)) == NULL)
+		return FAIL;
+
+	BENCH_TIME(alloc_cycles, 1,
+		for (i = 0; i < SLAB_BENCH_OBJS; i++)
+			slab_bench_objs[i] = kmalloc(KMALLOC_MIN));
+	for (i = 0; i < SLAB_BENCH_OBJS; i++)
+		if (slab_bench_objs[i] == NULL || ((uint32_t)slab_bench_objs[i] & (CACHE_LINE - 1)))
+			result = FAIL;
+	/* kfree ignores NULL */
+	BENCH_TIME(free_cycles, 1,
+		for (i = 0; i < SLAB_BENCH_OBJS; i++)
+			kfree(slab_bench_objs[i]));
+
+	BENCH_TIME(pair_cycles, SLAB_BENCH_ROUNDS,
+		if ((obj = kmalloc(KMALLOC_MIN)) == NULL)
+			result = FAIL;
+		kfree(obj));
+	BENCH_TIME(large_cycles, SLAB_BENCH_ROUNDS,
+		if ((obj = kmalloc(SLAB_BENCH_LARGE)) == NULL || ((uint32_t)obj & (CACHE_LINE - 1)))
+			result = FAIL;
+		kfree(obj));
+
+	bench_report("kmalloc", alloc_cycles, SLAB_BENCH_OBJS, "call");
+	bench_report("kfree", free_cycles, SLAB_BENCH_OBJS, "call");
+	bench_report("warm kmalloc+kfree", pair_cycles, SLAB_BENCH_ROUNDS, "pair");
+	bench_report("large kmalloc+kfree", large_cycles, SLAB_BENCH_ROUNDS, "pair");
+	if (slab_active() != active_before || kmalloc_stats.large_allocs != kmalloc_stats.large_frees)
+		result = FAIL;
+	buddy_free((uint32_t)slab_bench_objs, ORDER_4KB);
+	return result;
+}
+
+#define TLB_BENCH_ROUNDS	1000
+#define TLB_BENCH_OBJS		16
+#define TLB_BENCH_VIDEO		0xB8000	// screen, then the three terminal pages after it
+#define TLB_BENCH_VIDEO_PAGES	4
+
+/* tlb_bench_tick
+ * Description: do the paging work of one scheduler tick, then touch the kernel pages a
+ *              tick typically uses so the misses the flushes caused are paid for
+ * Inputs: objs: TLB_BENCH_OBJS kernel heap objects to touch
+ *         old_flush: also reload cr3 after the video remap, as vidmap_switch used to
+ * Outputs: none
+ * Side Effects: reloads cr3
+ */
+static void tlb_bench_tick(void** objs, int old_flush) {
+	uint32_t i;
+	switch_page_directory(mapped_user_pid);
+	vidmap_switch(curr_term_index);
+	if (old_flush)
+		tlb_flush_all();
+	for (i = 0; i < TLB_BENCH_VIDEO_PAGES; i++)
+		(void)*(volatile uint8_t*)(TLB_BENCH_VIDEO + i * PAGE_SIZE);
+	for (i = 0; i < TLB_BENCH_OBJS; i++)
+		(void)*(volatile uint32_t*)objs[i];
+}
+
+/* tlb_bench
+ * Description: time the paging work of a scheduler tick the old way, with no global pages
+ *              and a full flush for the video remap, and the new way, with global kernel
+ *              pages and invlpg of the two video pages
+ * Inputs: None
+ * Outputs: PASS if the objects could be allocated, FAIL otherwise
+ * Side Effects: prints cycles per tick; interrupts are off while it runs
+ */
+int tlb_bench() {
+	TEST_HEADER;
+	uint32_t i, flags, old_cycles, new_cycles;
+	void* objs[TLB_BENCH_OBJS];
+
+	for (i = 0; i < TLB_BENCH_OBJS; i++) {
+		if ((objs[i] = kmalloc(SLAB_MAX_OBJECT)) == NULL) {
+			while (i-- > 0)
+				kfree(objs[i]);
+			return FAIL;
+		}
+	}
+	cli_and_save(flags);
+	tlb_disable_global();
+	BENCH_TIME(old_cycles, TLB_BENCH_ROUNDS, tlb_bench_tick(objs, 1));
+	tlb_enable_global();
+	tlb_flush_all();
+	BENCH_TIME(new_cycles, TLB_BENCH_ROUNDS, tlb_bench_tick(objs, 0));
+	restore_flags(flags);
+	for (i = 0; i < TLB_BENCH_OBJS; i++)
+		kfree(objs[i]);
+
+	bench_report("full flushes", old_cycles, TLB_BENCH_ROUNDS, "tick");
+	bench_report("global pages and invlpg", new_cycles, TLB_BENCH_ROUNDS, "tick");
+	return PASS;
+}
 
 /* Test suite entry point */
 void launch_tests(){
@@ -346,6 +1386,27 @@ void launch_tests(){
 	//TEST_OUTPUT("read_executable", read_executable());
 	//TEST_OUTPUT("test_dir_read", test_dir_read());
 	//TEST_OUTPUT("test terminal write NULL", test_terminal_write_null(128));
+
+	/* Checkpoint 3 tests */
+	TEST_OUTPUT("write_test", write_test());
+	TEST_OUTPUT("getdents_test", getdents_test());
+	TEST_OUTPUT("lseek_pread_test", lseek_pread_test());
+	TEST_OUTPUT("mmap_test", mmap_test());
+	TEST_OUTPUT("subdir_test", subdir_test());
+	TEST_OUTPUT("sbrk_test", sbrk_test());
+
+	/* Performance tests */
+	//TEST_OUTPUT("dentry_lookup_bench", dentry_lookup_bench());
+	//TEST_OUTPUT("mount_bench", mount_bench());
+	//TEST_OUTPUT("read_data_bench", read_data_bench());
+	//TEST_OUTPUT("tmpfs_append_bench", tmpfs_append_bench());
+	//TEST_OUTPUT("sendfile_bench", sendfile_bench());
+	//TEST_OUTPUT("disk_bench", disk_bench());
+	//TEST_OUTPUT("bcache_bench", bcache_bench());
+	//TEST_OUTPUT("virtio_bench", virtio_bench());
+	//TEST_OUTPUT("buddy_bench", buddy_bench());
+	//TEST_OUTPUT("slab_bench", slab_bench());
+	//TEST_OUTPUT("tlb_bench", tlb_bench());
 }
 
 
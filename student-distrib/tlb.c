@@ -0,0 +1,134 @@
+/* tlb.c - keeping the tlb in step with the page tables
+ * vim:ts=4 noexpandtab
+ *
+ * Kernel mappings are the same in every page directory, so they are marked global and,
+ * once tlb_enable_global sets CR4.PGE, stay cached across the cr3 load of a context
+ * switch. The price is that a cr3 load no longer flushes them: code that changes a
+ * present entry must invalidate it with tlb_flush_page, or queue it with tlb_batch_add
+ * and flush the queue once the tables are consistent. A batch that outgrows
+ * TLB_BATCH_MAX is dropped for one tlb_flush_all, which costs less than that many
+ * invlpgs plus the misses either way.
+*/
+
+#include "tlb.h"
+#include "lib.h"
+
+tlb_stats_t tlb_stats;
+
+static uint32_t batch[TLB_BATCH_MAX];
+static uint32_t batch_count;    //TLB_BATCH_MAX + 1 once the batch has overflowed
+
+/* read_cr4
+ * Description: read control register 4
+ * Input: none
+ * Output: its value
+*/
+static uint32_t read_cr4(){
+    uint32_t cr4;
+    asm volatile ("movl %%cr4, %0" : "=r"(cr4));
+    return cr4;
+}
+
+/* write_cr4
+ * Description: write control register 4
+ * Input: cr4: value to write
+ * Output: none
+*/
+static void write_cr4(uint32_t cr4){
+    asm volatile ("movl %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+/* tlb_enable_global
+ * Description: let entries of pages marked global survive cr3 loads; called once paging is on
+ * Input: none
+ * Output: none
+*/
+void tlb_enable_global (){
+    write_cr4(read_cr4() | CR4_PGE);
+}
+
+/* tlb_disable_global
+ * Description: make cr3 loads drop global entries again, as before tlb_enable_global;
+ *              only for measuring what global pages save
+ * Input: none
+ * Output: none
+*/
+void tlb_disable_global (){
+    write_cr4(read_cr4() & ~CR4_PGE);
+}
+
+/* tlb_load_cr3
+ * Description: switch to a page directory, dropping every non-global entry
+ * Input: directory: 4KB aligned page directory, identity mapped
+ * Output: none
+*/
+void tlb_load_cr3 (void* directory){
+    asm volatile ("movl %0, %%cr3" : : "r"(directory) : "memory");
+    tlb_stats.cr3_loads++;
+}
+
+/* tlb_flush_page
+ * Description: drop the entry of one page, global or not
+ * Input: addr: any linear address in the page
+ * Output: none
+*/
+void tlb_flush_page (uint32_t addr){
+    asm volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+    tlb_stats.page_flushes++;
+}
+
+/* tlb_flush_all
+ * Description: drop every entry, global ones too, by turning CR4.PGE off and back on
+ * Input: none
+ * Output: none
+*/
+void tlb_flush_all (){
+    uint32_t cr4, flags;
+
+    cli_and_save(flags);
+    cr4 = read_cr4();
+    if(cr4 & CR4_PGE){
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    }else{
+        asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax", "memory");
+    }
+    tlb_stats.global_flushes++;
+    restore_flags(flags);
+}
+
+/* tlb_batch_add
+ * Description: queue a page whose entry changed, to be dropped by tlb_batch_flush
+ * Input: addr: any linear address in the page
+ * Output: none
+ * Side effect: the caller keeps interrupts off from the first add to the flush
+*/
+void tlb_batch_add (uint32_t addr){
+    if(batch_count < TLB_BATCH_MAX){
+        batch[batch_count] = addr;
+    }
+    if(batch_count <= TLB_BATCH_MAX){
+        batch_count++;
+    }
+}
+
+/* tlb_batch_flush
+ * Description: drop the entries of the queued pages, or all entries if the queue overflowed
+ * Input: none
+ * Output: none
+*/
+void tlb_batch_flush (){
+    uint32_t i;
+
+    if(batch_count > TLB_BATCH_MAX){
+        tlb_flush_all();
+    }else{
+        for(i = 0; i < batch_count; i++){
+            tlb_flush_page(batch[i]);
+        }
+    }
+    if(batch_count != 0){
+        tlb_stats.batches++;
+    }
+    batch_count = 0;
+}
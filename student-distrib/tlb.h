@@ -0,0 +1,37 @@
+/* tlb.h - keeping the tlb in step with the page tables
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TLB_H
+#define _TLB_H
+
+#include "types.h"
+
+#define CR4_PSE         0x10    // 4MB pages
+#define CR4_PGE         0x80    // global pages survive cr3 loads
+#define TLB_BATCH_MAX   16      // past this many pages one full flush beats an invlpg each
+
+typedef struct tlb_stats {
+    uint32_t cr3_loads;         //each drops every entry not marked global
+    uint32_t page_flushes;      //invlpg of one page
+    uint32_t global_flushes;    //drops global entries too
+    uint32_t batches;
+} tlb_stats_t;
+
+extern tlb_stats_t tlb_stats;
+
+extern void tlb_enable_global ();
+
+extern void tlb_disable_global ();
+
+extern void tlb_load_cr3 (void* directory);
+
+extern void tlb_flush_page (uint32_t addr);
+
+extern void tlb_flush_all ();
+
+extern void tlb_batch_add (uint32_t addr);
+
+extern void tlb_batch_flush ();
+
+#endif /* _TLB_H */
@@ -0,0 +1,777 @@
+#include "tmpfs.h"
+#include "system_calls.h"
+#include "paging.h"
+#include "lib.h"
+#include "buddy.h"
+#include "slab.h"
+
+static uint32_t tmpfs_pages;            //pages held by every tmpfs file
+
+/* radix tree nodes come from their own slab cache, made at mount */
+static slab_cache_t* radix_cache;
+
+static tmpfs_inode_t tmpfs_inodes[TMPFS_MAX_FILES];
+static uint32_t tmpfs_mounted;
+
+/* alloc_page
+ * Description: take a zeroed page from the buddy allocator; frames are identity mapped,
+ *              so the page's address is also what mmap maps
+ * Input: none
+ * Output: the page, NULL if memory is out
+*/
+static uint8_t* alloc_page(){
+    uint8_t* page = (uint8_t*)buddy_alloc(ORDER_4KB);
+    if(page == NULL){
+        return NULL;
+    }
+    memset(page, 0, PAGE_SIZE);
+    tmpfs_pages++;
+    return page;
+}
+
+/* free_page
+ * Description: give a page back to the buddy allocator
+ * Input: page: page from alloc_page
+ * Output: none
+*/
+static void free_page(uint8_t* page){
+    buddy_free((uint32_t)page, ORDER_4KB);
+    tmpfs_pages--;
+}
+
+/* alloc_node
+ * Description: take an empty radix tree node
+ * Input: none
+ * Output: the node, NULL if memory is out
+*/
+static radix_node_t* alloc_node(){
+    radix_node_t* node = (radix_node_t*)slab_alloc(radix_cache);
+    if(node != NULL){
+        memset(node, 0, sizeof(radix_node_t));
+    }
+    return node;
+}
+
+/* free_node
+ * Description: give a radix tree node back to its cache
+ * Input: node: node from alloc_node
+ * Output: none
+*/
+static void free_node(radix_node_t* node){
+    slab_free(radix_cache, node);
+}
+
+/* radix_capacity
+ * Description: number of page indices a tree of the given height maps
+ * Input: height: tree height
+ * Output: 2^(RADIX_SHIFT * height)
+*/
+static uint32_t radix_capacity(uint32_t height){
+    return 1 << (RADIX_SHIFT * height);
+}
+
+/* radix_lookup
+ * Description: find a page of a file, checking the last page looked up first
+ * Input: ino: the file
+ *        index: page index within the file
+ * Output: the page, NULL for a hole or past the tree
+*/
+static uint8_t* radix_lookup(tmpfs_inode_t* ino, uint32_t index){
+    void* slot;
+    uint32_t height;
+
+    if(ino->hint_page != NULL && ino->hint_index == index){
+        return ino->hint_page;
+    }
+    if(index >= radix_capacity(ino->height)){
+        return NULL;
+    }
+    slot = ino->root;
+    for(height = ino->height; height > 0 && slot != NULL; height--){
+        slot = ((radix_node_t*)slot)->slots[(index >> (RADIX_SHIFT * (height - 1))) & (RADIX_FANOUT - 1)];
+    }
+    if(slot != NULL){
+        ino->hint_index = index;
+        ino->hint_page = (uint8_t*)slot;
+    }
+    return (uint8_t*)slot;
+}
+
+/* radix_insert
+ * Description: put a page into a file's tree, growing the tree as needed
+ * Input: ino: the file
+ *        index: page index within the file, which must be a hole
+ *        page: the page
+ * Output: 0 for success, -1 if the tree cannot grow that far or nodes ran out
+*/
+static int32_t radix_insert(tmpfs_inode_t* ino, uint32_t index, uint8_t* page){
+    radix_node_t* node;
+    void** slot;
+    uint32_t height;
+
+    while(index >= radix_capacity(ino->height)){
+        if(ino->height == RADIX_MAX_HEIGHT){
+            return -1;
+        }
+        if(ino->root != NULL){
+            if((node = alloc_node()) == NULL){
+                return -1;
+            }
+            node->slots[0] = ino->root;     //the old tree becomes the first subtree
+            ino->root = node;
+        }
+        ino->height++;
+    }
+
+    slot = &ino->root;
+    for(height = ino->height; height > 0; height--){
+        if(*slot == NULL && (*slot = alloc_node()) == NULL){
+            return -1;  //empty nodes left behind are freed with the file
+        }
+        slot = &((radix_node_t*)*slot)->slots[(index >> (RADIX_SHIFT * (height - 1))) & (RADIX_FANOUT - 1)];
+    }
+    *slot = page;
+    ino->hint_index = index;
+    ino->hint_page = page;
+    return 0;
+}
+
+/* radix_trim
+ * Description: free the pages of a subtree from a page index on, and the nodes left empty
+ * Input: slot: slot holding the subtree
+ *        height: height of the subtree
+ *        first: first page index to free, relative to the subtree
+ * Output: 1 if the subtree is now empty, 0 otherwise
+*/
+static uint32_t radix_trim(void** slot, uint32_t height, uint32_t first){
+    radix_node_t* node = (radix_node_t*)*slot;
+    uint32_t i, span, empty = 1;
+
+    if(node == NULL){
+        return 1;
+    }
+    if(height == 0){
+        if(first == 0){
+            free_page((uint8_t*)*slot);
+            *slot = NULL;
+        }
+        return *slot == NULL;
+    }
+
+    span = radix_capacity(height - 1);
+    for(i = 0; i < RADIX_FANOUT; i++){
+        if(first < (i + 1) * span){
+            radix_trim(&node->slots[i], height - 1, (first > i * span) ? first - i * span : 0);
+        }
+        if(node->slots[i] != NULL){
+            empty = 0;
+        }
+    }
+    if(empty){
+        free_node(node);
+        *slot = NULL;
+    }
+    return empty;
+}
+
+/* set_size
+ * Description: set the length of a file, freeing the pages past the new end and zeroing
+ *              the rest of its last page so growing the file again reads zeros
+ * Input: ino: the file
+ *        length: new length in bytes
+ * Output: none
+*/
+static void set_size(tmpfs_inode_t* ino, uint32_t length){
+    uint8_t* page;
+
+    if(length < ino->size){
+        ino->hint_page = NULL;
+        radix_trim(&ino->root, ino->height, (length + PAGE_SIZE - 1) / PAGE_SIZE);
+        if(ino->root == NULL){
+            ino->height = 0;
+        }
+        if((length & (PAGE_SIZE - 1)) != 0 && (page = radix_lookup(ino, length / PAGE_SIZE)) != NULL){
+            memset(page + (length & (PAGE_SIZE - 1)), 0, PAGE_SIZE - (length & (PAGE_SIZE - 1)));
+        }
+    }
+    ino->size = length;
+}
+
+/* inode_id
+ * Description: id of a file kept in fd_table.inode, so an fd outliving an unlink of its
+ *              file stops matching the slot
+ * Input: index: index of the file
+ * Output: the id
+*/
+static uint32_t inode_id(uint32_t index){
+    return (tmpfs_inodes[index].generation << TMPFS_GEN_SHIFT) | index;
+}
+
+/* fd_inode
+ * Description: find the file an fd of the current process refers to
+ * Input: fd: index in the file descriptor array
+ * Output: the file, NULL if it was unlinked
+*/
+static tmpfs_inode_t* fd_inode(int32_t fd){
+    uint32_t id = get_curr_pcb()->fda[fd].inode;
+    uint32_t index = id & TMPFS_INDEX_MASK;
+
+    if(index >= TMPFS_MAX_FILES || tmpfs_inodes[index].file_type == -1 || inode_id(index) != id){
+        return NULL;
+    }
+    return &tmpfs_inodes[index];
+}
+
+/* find_child
+ * Description: find a file by name in a directory
+ * Input: dir: index of the directory
+ *        name: name to find (not necessarily null terminated)
+ *        len: length of the name
+ * Output: index of the file, -1 if there is none
+*/
+static int32_t find_child(uint32_t dir, const uint8_t* name, uint32_t len){
+    uint32_t i;
+    for(i = TMPFS_ROOT + 1; i < TMPFS_MAX_FILES; i++){
+        if(tmpfs_inodes[i].file_type != -1 && tmpfs_inodes[i].parent == dir &&
+           strncmp(tmpfs_inodes[i].name, (const int8_t*)name, len) == 0 &&
+           (len == FILENAME_LEN || tmpfs_inodes[i].name[len] == '\0')){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* nth_child
+ * Description: find the entry at a position of a directory listing
+ * Input: dir: index of the directory
+ *        pos: position in the listing
+ * Output: index of the file, -1 past the end
+*/
+static int32_t nth_child(uint32_t dir, uint32_t pos){
+    uint32_t i;
+    for(i = TMPFS_ROOT + 1; i < TMPFS_MAX_FILES; i++){
+        if(tmpfs_inodes[i].file_type != -1 && tmpfs_inodes[i].parent == dir && pos-- == 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* resolve
+ * Description: walk a path from the root directory
+ * Input: path: path relative to the mount point
+ *        leaf: if not NULL, the last component is not looked up but returned here
+ *        leaf_len: length of the last component
+ * Output: index of the file, or of the directory holding the last component when leaf is
+ *         given; -1 if a component is missing or not a directory
+*/
+static int32_t resolve(const uint8_t* path, const uint8_t** leaf, uint32_t* leaf_len){
+    int32_t cur = TMPFS_ROOT;
+    const uint8_t* name;
+    const uint8_t* next;
+    uint32_t len;
+
+    while(1){
+        while(*path == PATH_SEPARATOR){
+            path++;
+        }
+        if(*path == '\0'){
+            return (leaf == NULL) ? cur : -1;   //creating needs a name
+        }
+        name = path;
+        for(len = 0; path[len] != '\0' && path[len] != PATH_SEPARATOR; len++);
+        if(len > FILENAME_LEN || tmpfs_inodes[cur].file_type != DIR_TYPE){
+            return -1;
+        }
+        path += len;
+        if(leaf != NULL){
+            for(next = path; *next == PATH_SEPARATOR; next++);
+            if(*next == '\0'){
+                *leaf = name;
+                *leaf_len = len;
+                return cur;
+            }
+        }
+        if((cur = find_child(cur, name, len)) == -1){
+            return -1;
+        }
+    }
+}
+
+/* create_in_dir
+ * Description: add an empty file or directory to a directory
+ * Input: dir: index of the directory
+ *        name: name of the new file (not necessarily null terminated)
+ *        len: length of the name
+ *        file_type: REGULAR_TYPE or DIR_TYPE
+ * Output: index of the new file, -1 if the name is taken or the table is full
+*/
+static int32_t create_in_dir(uint32_t dir, const uint8_t* name, uint32_t len, int32_t file_type){
+    uint32_t i;
+    tmpfs_inode_t* ino;
+
+    if(len == 0 || len > FILENAME_LEN || tmpfs_inodes[dir].file_type != DIR_TYPE ||
+       find_child(dir, name, len) != -1){
+        return -1;
+    }
+    for(i = 0; i < len; i++){
+        if(name[i] == PATH_SEPARATOR || name[i] == '\0'){
+            return -1;
+        }
+    }
+    for(i = TMPFS_ROOT + 1; i < TMPFS_MAX_FILES; i++){
+        ino = &tmpfs_inodes[i];
+        if(ino->file_type == -1){
+            memset(ino->name, 0, FILENAME_LEN);
+            memcpy(ino->name, name, len);
+            ino->file_type = file_type;
+            ino->parent = dir;
+            ino->size = 0;
+            ino->height = 0;
+            ino->root = NULL;
+            ino->hint_page = NULL;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* create_path
+ * Description: create an empty file or directory by path
+ * Input: path: path relative to the mount point
+ *        file_type: REGULAR_TYPE or DIR_TYPE
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t create_path(const uint8_t* path, int32_t file_type){
+    const uint8_t* leaf;
+    uint32_t leaf_len, flags;
+    int32_t dir, result = -1;
+
+    cli_and_save(flags);
+    if((dir = resolve(path, &leaf, &leaf_len)) != -1 && create_in_dir(dir, leaf, leaf_len, file_type) != -1){
+        result = 0;
+    }
+    restore_flags(flags);
+    return result;
+}
+
+/* tmpfs_read_data
+ * Description: read from a file a page at a time; holes read as zeros
+ * Input: inode: index of the file
+ *        offset: position in the file to read from
+ *        buf: buffer to read into
+ *        length: number of bytes to read
+ * Output: number of bytes read, 0 at the end of the file, -1 for fail
+*/
+int32_t tmpfs_read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    tmpfs_inode_t* ino;
+    uint8_t* page;
+    uint32_t done, chunk, page_offset, flags;
+
+    if(inode >= TMPFS_MAX_FILES || tmpfs_inodes[inode].file_type != REGULAR_TYPE || buf == NULL){
+        return -1;
+    }
+    ino = &tmpfs_inodes[inode];
+
+    cli_and_save(flags);    //another process may truncate the file under us
+    if(offset >= ino->size){
+        length = 0;
+    }else if(length > ino->size - offset){
+        length = ino->size - offset;
+    }
+    for(done = 0; done < length; done += chunk){
+        page_offset = (offset + done) & (PAGE_SIZE - 1);
+        chunk = PAGE_SIZE - page_offset;
+        if(chunk > length - done){
+            chunk = length - done;
+        }
+        if((page = radix_lookup(ino, (offset + done) / PAGE_SIZE)) != NULL){
+            memcpy(buf + done, page + page_offset, chunk);
+        }else{
+            memset(buf + done, 0, chunk);
+        }
+    }
+    restore_flags(flags);
+    return length;
+}
+
+/* tmpfs_write_data
+ * Description: write to a file a page at a time, adding pages as needed
+ * Input: inode: index of the file
+ *        offset: position in the file to write at
+ *        buf: data to write
+ *        length: number of bytes to write
+ * Output: number of bytes written, which is short if memory ran out or the file was
+ *         unlinked meanwhile, -1 for fail
+ * Side effect: buf is read with interrupts on, a COPY_CHUNK at a time, since touching it
+ *              may fault and load a page; only the page lookup and the copy in are locked
+*/
+int32_t tmpfs_write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length){
+    tmpfs_inode_t* ino;
+    uint8_t* page;
+    uint32_t done, chunk, page_offset, flags, generation;
+    uint8_t staged[COPY_CHUNK];
+
+    if(inode >= TMPFS_MAX_FILES || tmpfs_inodes[inode].file_type != REGULAR_TYPE || buf == NULL){
+        return -1;
+    }
+    ino = &tmpfs_inodes[inode];
+    generation = ino->generation;
+
+    for(done = 0; done < length; done += chunk){
+        page_offset = (offset + done) & (PAGE_SIZE - 1);
+        chunk = PAGE_SIZE - page_offset;
+        if(chunk > length - done){
+            chunk = length - done;
+        }
+        if(chunk > COPY_CHUNK){
+            chunk = COPY_CHUNK;
+        }
+        memcpy(staged, buf + done, chunk);
+        cli_and_save(flags);
+        if(ino->file_type != REGULAR_TYPE || ino->generation != generation){
+            restore_flags(flags);
+            break;
+        }
+        if((page = radix_lookup(ino, (offset + done) / PAGE_SIZE)) == NULL){
+            if((page = alloc_page()) == NULL){
+                restore_flags(flags);
+                break;
+            }
+            if(radix_insert(ino, (offset + done) / PAGE_SIZE, page) == -1){
+                free_page(page);
+                restore_flags(flags);
+                break;
+            }
+        }
+        memcpy(page + page_offset, staged, chunk);
+        if(offset + done + chunk > ino->size){
+            ino->size = offset + done + chunk;
+        }
+        restore_flags(flags);
+    }
+    return (done == 0 && length > 0) ? -1 : (int32_t)done;
+}
+
+/* tmpfs_pages_used
+ * Description: number of pages every tmpfs file holds between them
+ * Input: none
+ * Output: page count
+*/
+uint32_t tmpfs_pages_used(){
+    return tmpfs_pages;
+}
+
+/* tmpfs_open
+ * Description: open a tmpfs file; the lookup already found it
+ * Input: filename
+ * Output: 0
+*/
+int32_t tmpfs_open (const uint8_t* filename){
+    return 0;
+}
+
+/* tmpfs_close
+ * Description: close a tmpfs file
+ * Input: fd
+ * Output: 0
+*/
+int32_t tmpfs_close (int32_t fd){
+    return 0;
+}
+
+/* tmpfs_read
+ * Description: read a file at its file position
+ * Input: fd: index of file to read in file descriptor array
+ *        buf: buffer to read data into
+ *        nbytes: number of bytes to read
+ * Output: number of bytes read if success, -1 if failed
+*/
+int32_t tmpfs_read (int32_t fd, void* buf, int32_t nbytes){
+    int32_t bytes_read;
+    tmpfs_inode_t* ino = fd_inode(fd);
+    PCB* pcb_ptr = get_curr_pcb();
+
+    if(ino == NULL || nbytes < 0){
+        return -1;
+    }
+    bytes_read = tmpfs_read_data(ino - tmpfs_inodes, pcb_ptr->fda[fd].file_position, (uint8_t*)buf, nbytes);
+    if(bytes_read > 0){
+        pcb_ptr->fda[fd].file_position += bytes_read;
+    }
+    return bytes_read;
+}
+
+/* tmpfs_write
+ * Description: write a file at its file position, growing it as needed
+ * Input: fd: index of file to write in file descriptor array
+ *        buf: data to write
+ *        nbytes: number of bytes to write
+ * Output: number of bytes written if success, -1 if failed
+*/
+int32_t tmpfs_write (int32_t fd, const void* buf, int32_t nbytes){
+    int32_t bytes_written;
+    tmpfs_inode_t* ino = fd_inode(fd);
+    PCB* pcb_ptr = get_curr_pcb();
+
+    if(ino == NULL || nbytes < 0){
+        return -1;
+    }
+    bytes_written = tmpfs_write_data(ino - tmpfs_inodes, pcb_ptr->fda[fd].file_position, (const uint8_t*)buf, nbytes);
+    if(bytes_written > 0){
+        pcb_ptr->fda[fd].file_position += bytes_written;
+    }
+    return bytes_written;
+}
+
+/* tmpfs_stat
+ * Description: fill in the type, index and size of an open file or directory
+ * Input: fd: index of the file in file descriptor array
+ *        buf: stat_t to fill
+ * Output: 0 for success, -1 if the file was unlinked
+*/
+int32_t tmpfs_stat (int32_t fd, stat_t* buf){
+    tmpfs_inode_t* ino = fd_inode(fd);
+    if(ino == NULL){
+        return -1;
+    }
+    buf->file_type = ino->file_type;
+    buf->inode_num = ino - tmpfs_inodes;
+    buf->size = (ino->file_type == REGULAR_TYPE) ? ino->size : 0;
+    return 0;
+}
+
+/* tmpfs_truncate
+ * Description: set the length of an open file; growing it leaves a hole that reads as zeros
+ * Input: fd: index of the file in file descriptor array
+ *        length: new length in bytes
+ * Output: 0 for success, -1 for fail, including for shrinking a mapped file
+*/
+int32_t tmpfs_truncate (int32_t fd, uint32_t length){
+    uint32_t flags;
+    tmpfs_inode_t* ino = fd_inode(fd);
+
+    if(ino == NULL || length > radix_capacity(RADIX_MAX_HEIGHT) * PAGE_SIZE){
+        return -1;
+    }
+    cli_and_save(flags);
+    // a shrink frees pages mmap may still point at
+    if(length < ino->size && file_busy(get_curr_pcb()->fda[fd].file_operation_ptr,
+                                       get_curr_pcb()->fda[fd].inode, FILE_BUSY_MAPPED)){
+        restore_flags(flags);
+        return -1;
+    }
+    set_size(ino, length);
+    restore_flags(flags);
+    return 0;
+}
+
+/* tmpfs_pread
+ * Description: read an open file at offset without moving its file position
+ * Input: fd: index of the file in file descriptor array
+ *        buf: buffer to read into
+ *        nbytes: number of bytes to read
+ *        offset: position in the file to read from
+ * Output: number of bytes read, -1 for fail
+*/
+int32_t tmpfs_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+    tmpfs_inode_t* ino = fd_inode(fd);
+    if(ino == NULL || nbytes < 0){
+        return -1;
+    }
+    return tmpfs_read_data(ino - tmpfs_inodes, offset, (uint8_t*)buf, nbytes);
+}
+
+/* tmpfs_page
+ * Description: find one page of an open file for mmap
+ * Input: fd: index of the file in file descriptor array
+ *        page_index: index of the page within the file
+ * Output: pointer to the page, NULL if it is past the end or a hole
+*/
+uint8_t* tmpfs_page (int32_t fd, uint32_t page_index){
+    tmpfs_inode_t* ino = fd_inode(fd);
+    if(ino == NULL || page_index >= (ino->size + PAGE_SIZE - 1) / PAGE_SIZE){
+        return NULL;
+    }
+    return radix_lookup(ino, page_index);
+}
+
+/* tmpfs_dir_read
+ * Description: read the name of the next entry of a directory
+ * Input: fd: index of the directory in file descriptor array
+ *        buf: buffer for the name
+ *        nbytes: size of buf
+ * Output: length of the name, 0 at the end of the directory, -1 for fail
+*/
+int32_t tmpfs_dir_read (int32_t fd, void* buf, int32_t nbytes){
+    int32_t child;
+    uint32_t len;
+    tmpfs_inode_t* dir = fd_inode(fd);
+    PCB* curr_pcb = get_curr_pcb();
+
+    if(dir == NULL || buf == NULL || nbytes < 0){
+        return -1;
+    }
+    if((child = nth_child(dir - tmpfs_inodes, curr_pcb->fda[fd].file_position)) == -1){
+        return 0;
+    }
+    for(len = 0; len < FILENAME_LEN && tmpfs_inodes[child].name[len] != '\0'; len++);
+    if(len > (uint32_t)nbytes){
+        len = nbytes;
+    }
+    memcpy(buf, tmpfs_inodes[child].name, len);
+    curr_pcb->fda[fd].file_position++;
+    return len;
+}
+
+/* tmpfs_dir_write
+ * Description: write a file name to the directory, which creates an empty regular file in it
+ * Input: fd: index of the directory in file descriptor array
+ *        buf: name of the new file (not necessarily null terminated)
+ *        nbytes: length of the name
+ * Output: nbytes for success, -1 for fail
+*/
+int32_t tmpfs_dir_write (int32_t fd, const void* buf, int32_t nbytes){
+    uint32_t flags;
+    int32_t result = -1;
+    tmpfs_inode_t* dir = fd_inode(fd);
+
+    if(dir == NULL || buf == NULL || nbytes <= 0){
+        return -1;
+    }
+    cli_and_save(flags);
+    if(create_in_dir(dir - tmpfs_inodes, (const uint8_t*)buf, nbytes, REGULAR_TYPE) != -1){
+        result = nbytes;
+    }
+    restore_flags(flags);
+    return result;
+}
+
+/* tmpfs_getdents
+ * Description: fill buf with as many packed dirent_t entries as fit, starting at the
+ *              directory's file position
+ * Input: fd: index of the directory in file descriptor array
+ *        buf: buffer to fill
+ *        nbytes: size of buf
+ * Output: number of bytes filled, 0 at the end of the directory, -1 if buf cannot hold one entry
+*/
+int32_t tmpfs_getdents (int32_t fd, void* buf, int32_t nbytes){
+    dirent_t* entry = (dirent_t*)buf;
+    int32_t child, count = 0;
+    tmpfs_inode_t* dir = fd_inode(fd);
+    PCB* curr_pcb = get_curr_pcb();
+
+    if(dir == NULL || buf == NULL || nbytes < (int32_t)sizeof(dirent_t)){
+        return -1;
+    }
+    while((count + 1) * (int32_t)sizeof(dirent_t) <= nbytes &&
+          (child = nth_child(dir - tmpfs_inodes, curr_pcb->fda[fd].file_position)) != -1){
+        memcpy(entry[count].filename, tmpfs_inodes[child].name, FILENAME_LEN);
+        entry[count].file_type = tmpfs_inodes[child].file_type;
+        entry[count].inode_num = child;
+        entry[count].size = (tmpfs_inodes[child].file_type == REGULAR_TYPE) ? tmpfs_inodes[child].size : 0;
+        curr_pcb->fda[fd].file_position++;
+        count++;
+    }
+    return count * sizeof(dirent_t);
+}
+
+/* file operation tables of tmpfs */
+static file_ops tmpfs_file_fop = {tmpfs_open, tmpfs_read, tmpfs_write, tmpfs_close, tmpfs_stat, tmpfs_truncate, NULL, tmpfs_pread, tmpfs_page};
+static file_ops tmpfs_dir_fop = {tmpfs_open, tmpfs_dir_read, tmpfs_dir_write, tmpfs_close, tmpfs_stat, NULL, tmpfs_getdents, NULL, NULL};
+
+/* tmpfs_mount
+ * Description: set up an empty tmpfs; there is one file table, so it mounts only once
+ * Input: mnt: the mount
+ *        arg: unused
+ * Output: 0 for success, -1 if tmpfs is already mounted or the node cache cannot be made
+*/
+static int32_t tmpfs_mount (mount_t* mnt, uint32_t arg){
+    uint32_t i;
+
+    if(tmpfs_mounted){
+        return -1;
+    }
+    if(radix_cache == NULL &&
+       (radix_cache = slab_cache_create((int8_t*)"radix_node", sizeof(radix_node_t))) == NULL){
+        return -1;
+    }
+    for(i = 0; i < TMPFS_MAX_FILES; i++){
+        tmpfs_inodes[i].file_type = -1;
+        tmpfs_inodes[i].generation = 0;
+    }
+    tmpfs_inodes[TMPFS_ROOT].file_type = DIR_TYPE;
+    tmpfs_inodes[TMPFS_ROOT].parent = TMPFS_ROOT;
+    tmpfs_mounted = 1;
+    mnt->data = tmpfs_inodes;
+    return 0;
+}
+
+/* tmpfs_lookup
+ * Description: find a file in tmpfs and pick its file operation table
+ * Input: mnt: the mount
+ *        path: path inside tmpfs
+ *        vnode: filled in for open
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t tmpfs_lookup (mount_t* mnt, const uint8_t* path, vnode_t* vnode){
+    int32_t index;
+
+    if((index = resolve(path, NULL, NULL)) == -1){
+        return -1;
+    }
+    vnode->fops = (tmpfs_inodes[index].file_type == DIR_TYPE) ? &tmpfs_dir_fop : &tmpfs_file_fop;
+    vnode->inode = inode_id(index);
+    vnode->file_type = tmpfs_inodes[index].file_type;
+    vnode->size = (tmpfs_inodes[index].file_type == REGULAR_TYPE) ? tmpfs_inodes[index].size : 0;
+    return 0;
+}
+
+/* tmpfs_create
+ * Description: create an empty regular file
+ * Input: mnt: the mount
+ *        path: path inside tmpfs
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t tmpfs_create (mount_t* mnt, const uint8_t* path){
+    return create_path(path, REGULAR_TYPE);
+}
+
+/* tmpfs_mkdir
+ * Description: create an empty directory
+ * Input: mnt: the mount
+ *        path: path inside tmpfs
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t tmpfs_mkdir (mount_t* mnt, const uint8_t* path){
+    return create_path(path, DIR_TYPE);
+}
+
+/* tmpfs_unlink
+ * Description: remove a regular file or an empty directory and free its pages
+ * Input: mnt: the mount
+ *        path: path inside tmpfs
+ * Output: 0 for success, -1 for fail, including for a mapped file
+*/
+static int32_t tmpfs_unlink (mount_t* mnt, const uint8_t* path){
+    int32_t index;
+    uint32_t flags;
+    tmpfs_inode_t* ino;
+
+    cli_and_save(flags);
+    if((index = resolve(path, NULL, NULL)) == -1 || index == TMPFS_ROOT ||
+       (tmpfs_inodes[index].file_type == DIR_TYPE && nth_child(index, 0) != -1) ||
+       file_busy(&tmpfs_file_fop, inode_id(index), FILE_BUSY_MAPPED)){
+        restore_flags(flags);
+        return -1;
+    }
+    ino = &tmpfs_inodes[index];
+    set_size(ino, 0);
+    radix_trim(&ino->root, ino->height, 0);     //nodes left by a failed insert
+    ino->file_type = -1;
+    ino->generation++;
+    restore_flags(flags);
+    return 0;
+}
+
+fs_type_t tmpfs_fs_type = {"tmpfs", tmpfs_mount, tmpfs_lookup, tmpfs_create, tmpfs_mkdir, tmpfs_unlink};
@@ -0,0 +1,70 @@
+/* tmpfs.h - RAM backed scratch filesystem
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TMPFS_H
+#define _TMPFS_H
+
+#include "types.h"
+#include "filesystem.h"
+#include "vfs.h"
+
+#define TMPFS_MAX_FILES     64      // files and directories, including the root
+#define TMPFS_ROOT          0       // index of the root directory
+#define RADIX_SHIFT         6       // index bits resolved by one tree level
+#define RADIX_FANOUT        (1 << RADIX_SHIFT)
+#define RADIX_MAX_HEIGHT    3       // 2^18 pages, more than the buddy allocator has
+#define TMPFS_GEN_SHIFT     8       // fd_table.inode is the file index plus its generation
+#define TMPFS_INDEX_MASK    ((1 << TMPFS_GEN_SHIFT) - 1)
+#define TMPFS_PAGE_NONE     0xFFFFFFFF
+
+/* an interior node of a file's page tree; slots hold child nodes, or pages at the bottom */
+typedef struct radix_node {
+    void* slots[RADIX_FANOUT];
+} radix_node_t;
+
+/* a file or directory. A tree of height h maps page indices below 2^(RADIX_SHIFT*h);
+   at height 0 the root is page 0 itself */
+typedef struct tmpfs_inode {
+    int32_t file_type;              //DIR_TYPE or REGULAR_TYPE, -1 for a free slot
+    int8_t name[FILENAME_LEN];      //not null terminated if the name is 32 chars long
+    uint32_t parent;                //index of the directory holding it
+    uint32_t generation;            //bumped on unlink so stale fds stop matching
+    uint32_t size;                  //length in bytes for regular files
+    uint32_t height;
+    void* root;                     //NULL for a file with no pages
+    uint32_t hint_index;            //last page looked up, so appends skip the tree walk
+    uint8_t* hint_page;
+} tmpfs_inode_t;
+
+extern fs_type_t tmpfs_fs_type;
+
+extern int32_t tmpfs_read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+
+extern int32_t tmpfs_write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
+extern uint32_t tmpfs_pages_used();
+
+extern int32_t tmpfs_open (const uint8_t* filename);
+
+extern int32_t tmpfs_close (int32_t fd);
+
+extern int32_t tmpfs_read (int32_t fd, void* buf, int32_t nbytes);
+
+extern int32_t tmpfs_write (int32_t fd, const void* buf, int32_t nbytes);
+
+extern int32_t tmpfs_stat (int32_t fd, stat_t* buf);
+
+extern int32_t tmpfs_truncate (int32_t fd, uint32_t length);
+
+extern int32_t tmpfs_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+extern uint8_t* tmpfs_page (int32_t fd, uint32_t page_index);
+
+extern int32_t tmpfs_dir_read (int32_t fd, void* buf, int32_t nbytes);
+
+extern int32_t tmpfs_dir_write (int32_t fd, const void* buf, int32_t nbytes);
+
+extern int32_t tmpfs_getdents (int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* _TMPFS_H */
@@ -0,0 +1,191 @@
+#include "vfs.h"
+#include "lib.h"
+
+static fs_type_t* fs_types[MAX_FS_TYPES];
+static mount_t mounts[MAX_MOUNTS];
+
+/* skip_separators
+ * Description: skip the leading '/' characters of a path
+ * Input: path: path to skip into
+ * Output: first character after them
+*/
+static const uint8_t* skip_separators(const uint8_t* path){
+    while(*path == PATH_SEPARATOR){
+        path++;
+    }
+    return path;
+}
+
+/* find_mount
+ * Description: find the mount whose mount point is the longest prefix of path
+ * Input: path: absolute or root-relative path
+ *        rest: set to the part of path inside that mount
+ * Output: the mount, NULL if nothing is mounted over path
+*/
+static mount_t* find_mount(const uint8_t* path, const uint8_t** rest){
+    uint32_t i;
+    mount_t* best = NULL;
+
+    path = skip_separators(path);
+    for(i = 0; i < MAX_MOUNTS; i++){
+        if(mounts[i].type == NULL || (best != NULL && mounts[i].path_len <= best->path_len)){
+            continue;
+        }
+        if(mounts[i].path_len == 0 ||
+           (strncmp((int8_t*)path, mounts[i].path, mounts[i].path_len) == 0 &&
+            (path[mounts[i].path_len] == PATH_SEPARATOR || path[mounts[i].path_len] == '\0'))){
+            best = &mounts[i];
+        }
+    }
+    if(best != NULL){
+        *rest = path + best->path_len;
+    }
+    return best;
+}
+
+/* register_fs_type
+ * Description: add a filesystem type that vfs_mount can find by name
+ * Input: type: the filesystem type, which must stay valid forever
+ * Output: 0 for success, -1 if the table is full
+*/
+int32_t register_fs_type(fs_type_t* type){
+    uint32_t i;
+    for(i = 0; i < MAX_FS_TYPES; i++){
+        if(fs_types[i] == NULL || fs_types[i] == type){
+            fs_types[i] = type;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* vfs_mount
+ * Description: mount a registered filesystem type at path
+ * Input: path: mount point, "/" for the root
+ *        type_name: name the type was registered under
+ *        arg: passed to the type's mount function
+ * Output: 0 for success, -1 if the type is unknown, the path is taken or too long,
+ *         the mount table is full or the filesystem refuses to mount
+*/
+int32_t vfs_mount(const int8_t* path, const int8_t* type_name, uint32_t arg){
+    uint32_t i, len;
+    fs_type_t* type = NULL;
+    mount_t* mnt = NULL;
+
+    if(path == NULL || type_name == NULL){
+        return -1;
+    }
+    for(i = 0; i < MAX_FS_TYPES; i++){
+        if(fs_types[i] != NULL && strncmp(fs_types[i]->name, type_name, strlen(type_name) + 1) == 0){
+            type = fs_types[i];
+        }
+    }
+    path = (const int8_t*)skip_separators((const uint8_t*)path);
+    len = strlen(path);
+    while(len > 0 && path[len - 1] == PATH_SEPARATOR){
+        len--;
+    }
+    if(type == NULL || len > MOUNT_PATH_LEN){
+        return -1;
+    }
+
+    for(i = 0; i < MAX_MOUNTS; i++){
+        if(mounts[i].type != NULL && mounts[i].path_len == len && strncmp(mounts[i].path, path, len) == 0){
+            return -1;  //already mounted
+        }
+        if(mounts[i].type == NULL && mnt == NULL){
+            mnt = &mounts[i];
+        }
+    }
+    if(mnt == NULL){
+        return -1;
+    }
+
+    memset(mnt, 0, sizeof(mount_t));
+    strncpy(mnt->path, path, len);
+    mnt->path_len = len;
+    if(type->mount(mnt, arg) == -1){
+        return -1;
+    }
+    mnt->type = type;
+    return 0;
+}
+
+/* vfs_lookup
+ * Description: find a file through the filesystem mounted over its path
+ * Input: path: path of the file
+ *        vnode: filled in with the file's operations and id
+ * Output: 0 for success, -1 if there is no such file
+*/
+int32_t vfs_lookup(const uint8_t* path, vnode_t* vnode){
+    const uint8_t* rest;
+    mount_t* mnt;
+
+    if(path == NULL || vnode == NULL || (mnt = find_mount(path, &rest)) == NULL){
+        return -1;
+    }
+    vnode->mnt = mnt;
+    return mnt->type->lookup(mnt, rest, vnode);
+}
+
+/* vfs_stat
+ * Description: fill in the type, inode and size of a file by path
+ * Input: path: path of the file
+ *        buf: stat_t to fill
+ * Output: 0 for success, -1 for fail
+*/
+int32_t vfs_stat(const uint8_t* path, stat_t* buf){
+    vnode_t vnode;
+    if(buf == NULL || vfs_lookup(path, &vnode) == -1){
+        return -1;
+    }
+    buf->file_type = vnode.file_type;
+    buf->inode_num = vnode.inode;
+    buf->size = vnode.size;
+    return 0;
+}
+
+/* vfs_create
+ * Description: create an empty regular file
+ * Input: path: path of the new file
+ * Output: 0 for success, -1 for fail, including on read-only filesystems
+*/
+int32_t vfs_create(const uint8_t* path){
+    const uint8_t* rest;
+    mount_t* mnt;
+
+    if(path == NULL || (mnt = find_mount(path, &rest)) == NULL || mnt->type->create == NULL){
+        return -1;
+    }
+    return mnt->type->create(mnt, rest);
+}
+
+/* vfs_mkdir
+ * Description: create an empty directory
+ * Input: path: path of the new directory
+ * Output: 0 for success, -1 for fail, including on read-only filesystems
+*/
+int32_t vfs_mkdir(const uint8_t* path){
+    const uint8_t* rest;
+    mount_t* mnt;
+
+    if(path == NULL || (mnt = find_mount(path, &rest)) == NULL || mnt->type->mkdir == NULL){
+        return -1;
+    }
+    return mnt->type->mkdir(mnt, rest);
+}
+
+/* vfs_unlink
+ * Description: remove a regular file or an empty directory
+ * Input: path: path of the file
+ * Output: 0 for success, -1 for fail, including on read-only filesystems
+*/
+int32_t vfs_unlink(const uint8_t* path){
+    const uint8_t* rest;
+    mount_t* mnt;
+
+    if(path == NULL || (mnt = find_mount(path, &rest)) == NULL || mnt->type->unlink == NULL){
+        return -1;
+    }
+    return mnt->type->unlink(mnt, rest);
+}
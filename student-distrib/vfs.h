@@ -0,0 +1,69 @@
+/* vfs.h - filesystem types, the mount table and vnodes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _VFS_H
+#define _VFS_H
+
+#include "types.h"
+#include "system_calls.h"
+
+#define MAX_FS_TYPES    8
+#define MAX_MOUNTS      4
+#define MOUNT_PATH_LEN  32      // longest mount point, without the leading '/'
+
+struct mount;
+
+/* what a lookup hands to open: the table the fd dispatches through, and the id the
+   filesystem keeps in fd_table.inode */
+typedef struct vnode {
+    file_ops* fops;
+    uint32_t inode;
+    int32_t file_type;      //RTC_TYPE, DIR_TYPE or REGULAR_TYPE
+    uint32_t size;          //length in bytes for regular files, 0 otherwise
+    struct mount* mnt;
+} vnode_t;
+
+/* a registered filesystem type; paths handed to it are relative to its mount point.
+   create, mkdir and unlink are NULL for read-only filesystems */
+typedef struct fs_type {
+    const int8_t* name;
+    int32_t (*mount) (struct mount* mnt, uint32_t arg);
+    int32_t (*lookup) (struct mount* mnt, const uint8_t* path, vnode_t* vnode);
+    int32_t (*create) (struct mount* mnt, const uint8_t* path);
+    int32_t (*mkdir) (struct mount* mnt, const uint8_t* path);
+    int32_t (*unlink) (struct mount* mnt, const uint8_t* path);
+} fs_type_t;
+
+typedef struct mount {
+    int8_t path[MOUNT_PATH_LEN + 1];    //"" for the root, otherwise e.g. "tmp"
+    uint32_t path_len;
+    fs_type_t* type;                    //NULL for a free slot
+    void* data;                         //private to the filesystem
+} mount_t;
+
+/* filesystem types and device tables built into the kernel */
+extern fs_type_t image_fs_type;     //the boot module image, see filesystem.c
+extern fs_type_t disk_fs_type;      //the same format read from a block device
+extern file_ops file_fop;
+extern file_ops dir_fop;
+extern file_ops RTC_fop;
+
+/* add a filesystem type that vfs_mount can find by name */
+extern int32_t register_fs_type(fs_type_t* type);
+
+/* mount a registered filesystem type at path, passing arg to its mount function */
+extern int32_t vfs_mount(const int8_t* path, const int8_t* type_name, uint32_t arg);
+
+/* find the file at path in whichever filesystem is mounted over it */
+extern int32_t vfs_lookup(const uint8_t* path, vnode_t* vnode);
+
+extern int32_t vfs_stat(const uint8_t* path, stat_t* buf);
+
+extern int32_t vfs_create(const uint8_t* path);
+
+extern int32_t vfs_mkdir(const uint8_t* path);
+
+extern int32_t vfs_unlink(const uint8_t* path);
+
+#endif /* _VFS_H */
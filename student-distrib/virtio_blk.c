@@ -0,0 +1,393 @@
+/* virtio_blk.c - virtio block device driver (legacy PCI interface)
+ * vim:ts=4 noexpandtab
+ *
+ * Follows the legacy interface of the virtio 1.0 specification (sections 4.1.4.8 and
+ * 5.2), which QEMU's virtio-blk-pci offers by default. The device has one virtqueue.
+ * Every request is a descriptor chain: a header the device reads, the data buffers, and
+ * a status byte the device writes. Up to VIRTIO_BLK_REQS requests are in the queue at
+ * once; start_read returns as soon as its request is queued.
+ *
+ * An interrupt drains the whole used ring, so requests that finish close together are
+ * completed in one batch. Callers that wait with interrupts off drain it themselves.
+*/
+
+#include "virtio_blk.h"
+#include "lib.h"
+#include "pci.h"
+
+#define EFLAGS_IF   0x200   // interrupts enabled
+
+virtio_blk_t virtio_blks[VIRTIO_BLK_MAX_DEVS];
+uint32_t virtio_blk_count;
+
+/* barrier
+ * Description: keep the compiler from moving ring accesses across this point; x86 does
+ *              not reorder the stores themselves
+ * Input: none
+ * Output: none
+*/
+static inline void barrier(){
+    asm volatile ("" : : : "memory");
+}
+
+/* vq_setup
+ * Description: lay out the descriptor table, available ring and used ring of a queue of
+ *              vb->size entries, and put every descriptor and request on a free list
+ * Input: vb: the device
+ * Output: none
+*/
+static void vq_setup(virtio_blk_t* vb){
+    uint32_t i, used_offset;
+
+    memset(vb->queue_mem, 0, VIRTQ_MEM_SIZE);
+    vb->desc = (virtq_desc_t*)vb->queue_mem;
+    vb->avail = (virtq_avail_t*)(vb->queue_mem + vb->size * sizeof(virtq_desc_t));
+    used_offset = vb->size * sizeof(virtq_desc_t) + (3 + vb->size) * sizeof(uint16_t);
+    used_offset = (used_offset + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+    vb->used = (virtq_used_t*)(vb->queue_mem + used_offset);
+
+    for(i = 0; i < vb->size; i++){
+        vb->desc[i].next = i + 1;
+    }
+    vb->free_desc = 0;
+    vb->num_free = vb->size;
+    vb->last_used = 0;
+    for(i = 0; i < VIRTIO_BLK_REQS; i++){
+        vb->reqs[i].next_free = (i + 1 < VIRTIO_BLK_REQS) ? &vb->reqs[i + 1] : NULL;
+    }
+    vb->free_reqs = &vb->reqs[0];
+}
+
+/* req_alloc
+ * Description: take a request, if the queue also has descriptors for it
+ * Input: vb: the device, with interrupts off
+ *        segs: number of data buffers
+ * Output: the request, NULL if the queue is full
+*/
+static virtio_blk_req_t* req_alloc(virtio_blk_t* vb, uint32_t segs){
+    virtio_blk_req_t* req = vb->free_reqs;
+
+    if(req == NULL || vb->num_free < segs + 2){
+        return NULL;
+    }
+    vb->free_reqs = req->next_free;
+    return req;
+}
+
+/* req_free
+ * Description: give a request back
+ * Input: vb: the device, with interrupts off
+ *        req: the request
+ * Output: none
+*/
+static void req_free(virtio_blk_t* vb, virtio_blk_req_t* req){
+    req->next_free = vb->free_reqs;
+    vb->free_reqs = req;
+}
+
+/* vq_submit
+ * Description: queue a request and notify the device. The chain is taken off the front
+ *              of the free descriptor list, which is already linked through next
+ * Input: vb: the device, with interrupts off and a request from req_alloc
+ *        req: the request
+ *        write: 1 to write to the disk
+ *        lba: first sector
+ *        bufs: data buffers, identity mapped kernel memory
+ *        seg_len: bytes of each buffer
+ *        segs: number of buffers
+ * Output: none
+*/
+static void vq_submit(virtio_blk_t* vb, virtio_blk_req_t* req, uint32_t write, uint32_t lba,
+                      uint8_t* const* bufs, uint32_t seg_len, uint32_t segs){
+    uint16_t head = vb->free_desc;
+    uint16_t d = head;
+    uint32_t i;
+
+    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    req->reserved = 0;
+    req->sector = lba;
+    req->sector_high = 0;
+    req->status = VIRTIO_BLK_S_UNSET;
+    req->done = 0;
+
+    vb->desc[d].addr = (uint32_t)&req->type;
+    vb->desc[d].addr_high = 0;
+    vb->desc[d].len = 4 * sizeof(uint32_t);
+    vb->desc[d].flags = VIRTQ_DESC_F_NEXT;
+    for(i = 0; i < segs; i++){
+        d = vb->desc[d].next;
+        vb->desc[d].addr = (uint32_t)bufs[i];
+        vb->desc[d].addr_high = 0;
+        vb->desc[d].len = seg_len;
+        vb->desc[d].flags = VIRTQ_DESC_F_NEXT | (write ? 0 : VIRTQ_DESC_F_WRITE);
+    }
+    d = vb->desc[d].next;
+    vb->desc[d].addr = (uint32_t)&req->status;
+    vb->desc[d].addr_high = 0;
+    vb->desc[d].len = sizeof(uint8_t);
+    vb->desc[d].flags = VIRTQ_DESC_F_WRITE;
+    vb->free_desc = vb->desc[d].next;
+    vb->num_free -= segs + 2;
+    vb->desc_req[head] = req;
+
+    vb->avail->ring[vb->avail->idx & (vb->size - 1)] = head;
+    barrier();      //the entry before the index that publishes it
+    vb->avail->idx++;
+    barrier();
+    if(++vb->in_flight > vb->max_in_flight){
+        vb->max_in_flight = vb->in_flight;
+    }
+    outw(0, vb->io + VIRTIO_REG_QUEUE_NOTIFY);
+}
+
+/* vq_complete
+ * Description: finish every request the device has put on the used ring: free its
+ *              descriptors, then wake its waiter or call its callback
+ * Input: vb: the device, with interrupts off
+ * Output: number of requests finished
+*/
+static uint32_t vq_complete(virtio_blk_t* vb){
+    virtq_used_elem_t* elem;
+    virtio_blk_req_t* req;
+    blk_done_t callback;
+    void* arg;
+    uint8_t status;
+    uint32_t count = 0;
+    uint16_t head, d;
+
+    while(vb->last_used != vb->used->idx){
+        barrier();  //the index before the entry it covers
+        elem = &vb->used->ring[vb->last_used & (vb->size - 1)];
+        head = elem->id;
+        req = vb->desc_req[head];
+        for(d = head; vb->desc[d].flags & VIRTQ_DESC_F_NEXT; d = vb->desc[d].next){
+            vb->num_free++;
+        }
+        vb->desc[d].next = vb->free_desc;
+        vb->free_desc = head;
+        vb->num_free++;
+        vb->last_used++;
+        vb->in_flight--;
+        count++;
+
+        req->done = 1;
+        if(req->callback != NULL){
+            callback = req->callback;
+            arg = req->arg;
+            status = req->status;
+            req_free(vb, req);
+            callback(arg, (status == VIRTIO_BLK_S_OK) ? 0 : -1);
+        }
+    }
+    vb->completions += count;
+    return count;
+}
+
+/* virtio_blk_irq
+ * Description: pci_irq_handler_t for a device: acknowledge its interrupt and finish the
+ *              requests it completed since the last one, all in one batch
+ * Input: data: the device
+ * Output: 1 if the device raised the interrupt, 0 if it was another device on the line
+*/
+static uint32_t virtio_blk_irq(void* data){
+    virtio_blk_t* vb = data;
+    uint32_t count;
+
+    if(!(inb(vb->io + VIRTIO_REG_ISR) & VIRTIO_ISR_QUEUE)){
+        return 0;
+    }
+    count = vq_complete(vb);
+    if(count > 0){
+        vb->interrupts++;
+        if(count > vb->max_batch){
+            vb->max_batch = count;
+        }
+    }
+    return 1;
+}
+
+/* virtio_blk_abandoned
+ * Description: blk_done_t of a request its waiter gave up on; vq_complete frees the
+ *              request and its descriptors if the device ever returns it
+ * Input: arg: unused
+ *        status: unused
+ * Output: none
+*/
+static void virtio_blk_abandoned(void* arg, int32_t status){
+}
+
+/* virtio_blk_rw
+ * Description: queue one request for a contiguous buffer and wait for it, spinning with
+ *              interrupts on, or draining the used ring when they are off
+ * Input: vb: the device
+ *        lba: first sector
+ *        count: number of sectors, at most VIRTIO_BLK_MAX_SECTORS
+ *        buf: data
+ *        write: 1 to write to the disk
+ * Output: 0 for success, -1 if the device reports an error or never finishes the request
+*/
+static int32_t virtio_blk_rw(virtio_blk_t* vb, uint32_t lba, uint32_t count, uint8_t* buf, uint32_t write){
+    virtio_blk_req_t* req;
+    uint32_t flags, saved, i;
+    uint8_t status;
+
+    cli_and_save(flags);
+    while((req = req_alloc(vb, 1)) == NULL){
+        vq_complete(vb);    //make room from requests that are already done
+        restore_flags(flags);
+        cli_and_save(flags);
+    }
+    req->callback = NULL;
+    vq_submit(vb, req, write, lba, &buf, count * SECTOR_SIZE, 1);
+    restore_flags(flags);
+
+    for(i = 0; !req->done; i++){
+        if(!(flags & EFLAGS_IF)){
+            vq_complete(vb);    //no interrupt can arrive
+        }
+        if(i == VIRTIO_BLK_TIMEOUT){
+            cli_and_save(saved);
+            if(!req->done){
+                req->callback = virtio_blk_abandoned;   //the chain stays with the device
+                restore_flags(saved);
+                return -1;
+            }
+            restore_flags(saved);
+        }
+        inb(vb->io + VIRTIO_REG_STATUS);    //paces the wait like ata_wait's status polls
+    }
+    cli_and_save(saved);
+    status = req->status;
+    req_free(vb, req);
+    restore_flags(saved);
+    return (status == VIRTIO_BLK_S_OK) ? 0 : -1;
+}
+
+/* virtio_blk_read
+ * Description: block_dev_t read for a virtio disk
+ * Input: dev: the disk's block device
+ *        lba: first sector
+ *        count: number of sectors, at most VIRTIO_BLK_MAX_SECTORS
+ *        buf: destination
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t virtio_blk_read(block_dev_t* dev, uint32_t lba, uint32_t count, void* buf){
+    return virtio_blk_rw(dev->data, lba, count, buf, 0);
+}
+
+/* virtio_blk_write
+ * Description: block_dev_t write for a virtio disk
+ * Input: dev: the disk's block device
+ *        lba: first sector
+ *        count: number of sectors, at most VIRTIO_BLK_MAX_SECTORS
+ *        buf: source
+ * Output: 0 for success, -1 for fail
+*/
+static int32_t virtio_blk_write(block_dev_t* dev, uint32_t lba, uint32_t count, const void* buf){
+    return virtio_blk_rw(dev->data, lba, count, (uint8_t*)buf, 1);
+}
+
+/* virtio_blk_start_read
+ * Description: block_dev_t start_read for a virtio disk: queue the read, one descriptor
+ *              per page, and return; the interrupt that completes it calls done
+ * Input: dev: the disk's block device
+ *        lba: first sector
+ *        pages: number of pages, at most BLK_MAX_PAGES
+ *        page_bufs: destination pages
+ *        done: completion callback
+ *        arg: passed to done
+ * Output: 0 if queued, -1 if the queue is full
+*/
+static int32_t virtio_blk_start_read(block_dev_t* dev, uint32_t lba, uint32_t pages, uint8_t* const* page_bufs,
+                                     blk_done_t done, void* arg){
+    virtio_blk_t* vb = dev->data;
+    virtio_blk_req_t* req;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if((req = req_alloc(vb, pages)) == NULL){
+        restore_flags(flags);
+        return -1;
+    }
+    req->callback = done;
+    req->arg = arg;
+    vq_submit(vb, req, 0, lba, page_bufs, BLK_PAGE_SIZE, pages);
+    restore_flags(flags);
+    return 0;
+}
+
+/* virtio_blk_poll
+ * Description: block_dev_t poll for a virtio disk: finish the requests it has completed
+ * Input: dev: the disk's block device
+ * Output: none
+*/
+static void virtio_blk_poll(block_dev_t* dev){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    vq_complete(dev->data);
+    restore_flags(flags);
+}
+
+/* virtio_blk_init
+ * Description: set up every virtio block device pci_init found and register each as
+ *              vda, vdb, ...
+ * Input: none
+ * Output: none
+ * Side effect: unmasks the devices' interrupt lines; call after pci_init and i8259_init
+*/
+void virtio_blk_init (){
+    virtio_blk_t* vb;
+    pci_dev_t* pdev;
+    uint32_t i, bar0;
+
+    for(i = 0; virtio_blk_count < VIRTIO_BLK_MAX_DEVS &&
+               (pdev = pci_find_device(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, i)) != NULL; i++){
+        vb = &virtio_blks[virtio_blk_count];
+        bar0 = pci_config_read(pdev->addr, PCI_BAR0);
+        if(!(bar0 & PCI_BAR_IO) || pdev->irq == PCI_IRQ_NONE){
+            continue;   //modern-only device, or no interrupt routed to it
+        }
+        pci_config_write(pdev->addr, PCI_COMMAND,
+                         pci_config_read(pdev->addr, PCI_COMMAND) | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+        vb->io = bar0 & PCI_BAR_IO_MASK;
+        vb->irq = pdev->irq;
+
+        outb(0, vb->io + VIRTIO_REG_STATUS);    //reset
+        outb(VIRTIO_STATUS_ACK, vb->io + VIRTIO_REG_STATUS);
+        outb(VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER, vb->io + VIRTIO_REG_STATUS);
+        inl(vb->io + VIRTIO_REG_DEVICE_FEATURES);
+        outl(0, vb->io + VIRTIO_REG_GUEST_FEATURES);    //none of the optional features are needed
+
+        outw(0, vb->io + VIRTIO_REG_QUEUE_SELECT);
+        vb->size = inw(vb->io + VIRTIO_REG_QUEUE_SIZE);
+        if(vb->size == 0 || vb->size > VIRTQ_MAX_SIZE || (vb->size & (vb->size - 1)) != 0){
+            outb(VIRTIO_STATUS_FAILED, vb->io + VIRTIO_REG_STATUS);
+            continue;
+        }
+        vq_setup(vb);
+        outl((uint32_t)vb->queue_mem / VIRTQ_ALIGN, vb->io + VIRTIO_REG_QUEUE_PFN);
+        if(pci_request_irq(vb->irq, virtio_blk_irq, vb) == -1){
+            outb(VIRTIO_STATUS_FAILED, vb->io + VIRTIO_REG_STATUS);
+            continue;
+        }
+        outb(VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK, vb->io + VIRTIO_REG_STATUS);
+
+        vb->dev.name[0] = 'v';
+        vb->dev.name[1] = 'd';
+        vb->dev.name[2] = 'a' + virtio_blk_count;
+        vb->dev.name[3] = '\0';
+        vb->dev.sectors = inl(vb->io + VIRTIO_REG_BLK_CAPACITY);
+        if(inl(vb->io + VIRTIO_REG_BLK_CAPACITY + 4) != 0){
+            vb->dev.sectors = 0xFFFFFFFF;   //LBA past 32 bits is not reachable
+        }
+        vb->dev.max_sectors = VIRTIO_BLK_MAX_SECTORS;
+        vb->dev.read = virtio_blk_read;
+        vb->dev.write = virtio_blk_write;
+        vb->dev.start_read = virtio_blk_start_read;
+        vb->dev.poll = virtio_blk_poll;
+        vb->dev.data = vb;
+        register_block_dev(&vb->dev);
+        virtio_blk_count++;
+    }
+}
@@ -0,0 +1,111 @@
+/* virtio_blk.h - virtio block device driver (legacy PCI interface)
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _VIRTIO_BLK_H
+#define _VIRTIO_BLK_H
+
+#include "types.h"
+#include "blkdev.h"
+
+#define VIRTIO_VENDOR           0x1AF4
+#define VIRTIO_BLK_DEVICE       0x1001  // transitional block device, which has the legacy interface
+#define VIRTIO_BLK_MAX_DEVS     2
+
+/* legacy registers, offsets from BAR0 */
+#define VIRTIO_REG_DEVICE_FEATURES  0x00
+#define VIRTIO_REG_GUEST_FEATURES   0x04
+#define VIRTIO_REG_QUEUE_PFN        0x08
+#define VIRTIO_REG_QUEUE_SIZE       0x0C
+#define VIRTIO_REG_QUEUE_SELECT     0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY     0x10
+#define VIRTIO_REG_STATUS           0x12
+#define VIRTIO_REG_ISR              0x13    // reading acknowledges the interrupt
+#define VIRTIO_REG_BLK_CAPACITY     0x14    // device config without MSI-X: 64-bit sector count
+
+#define VIRTIO_STATUS_ACK           0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FAILED        0x80
+#define VIRTIO_ISR_QUEUE            0x01    // a used ring has new entries
+
+#define VIRTQ_MAX_SIZE          256     // largest queue the driver has memory for
+#define VIRTQ_ALIGN             4096    // the used ring starts on its own page
+#define VIRTQ_MEM_SIZE          (3 * VIRTQ_ALIGN)   // rings of a VIRTQ_MAX_SIZE queue
+#define VIRTQ_DESC_F_NEXT       0x1
+#define VIRTQ_DESC_F_WRITE      0x2     // the device writes the buffer
+
+#define VIRTIO_BLK_T_IN         0       // read
+#define VIRTIO_BLK_T_OUT        1       // write
+#define VIRTIO_BLK_S_OK         0
+#define VIRTIO_BLK_S_UNSET      0xFF    // not written by the device yet
+#define VIRTIO_BLK_REQS         64      // requests in flight per device
+#define VIRTIO_BLK_TIMEOUT      0x1000000   // status polls before a request is abandoned
+#define VIRTIO_BLK_MAX_SECTORS  (BLK_MAX_PAGES * BLK_PAGE_SECTORS)
+
+typedef struct virtq_desc {
+    uint32_t addr;                  //physical address, low half
+    uint32_t addr_high;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct virtq_avail {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[VIRTQ_MAX_SIZE];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct virtq_used_elem {
+    uint32_t id;                    //head descriptor of the finished chain
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct virtq_used {
+    uint16_t flags;
+    volatile uint16_t idx;
+    virtq_used_elem_t ring[VIRTQ_MAX_SIZE];
+} __attribute__((packed)) virtq_used_t;
+
+/* one request: the header and status byte the device sees, and who to tell when it is done */
+typedef struct virtio_blk_req {
+    uint32_t type;                  //header read by the device
+    uint32_t reserved;
+    uint32_t sector;
+    uint32_t sector_high;
+    volatile uint8_t status;        //written by the device
+    volatile uint32_t done;
+    blk_done_t callback;            //NULL when a process waits for done
+    void* arg;
+    struct virtio_blk_req* next_free;
+} virtio_blk_req_t;
+
+typedef struct virtio_blk {
+    uint8_t queue_mem[VIRTQ_MEM_SIZE];  //first, so the rings get the struct's alignment
+    uint16_t io;
+    uint16_t size;                  //entries of the queue, set by the device
+    uint32_t irq;
+    virtq_desc_t* desc;
+    virtq_avail_t* avail;
+    virtq_used_t* used;
+    uint16_t free_desc;             //first free descriptor, chained through next
+    uint16_t num_free;
+    uint16_t last_used;             //used ring entries consumed so far
+    virtio_blk_req_t reqs[VIRTIO_BLK_REQS];
+    virtio_blk_req_t* free_reqs;
+    virtio_blk_req_t* desc_req[VIRTQ_MAX_SIZE];     //request of each chain, by head descriptor
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+    uint32_t interrupts;            //interrupts that completed requests
+    uint32_t completions;
+    uint32_t max_batch;             //most requests one interrupt completed
+    block_dev_t dev;
+} __attribute__((aligned (VIRTQ_ALIGN))) virtio_blk_t;
+
+extern virtio_blk_t virtio_blks[VIRTIO_BLK_MAX_DEVS];
+extern uint32_t virtio_blk_count;
+
+extern void virtio_blk_init ();
+
+#endif /* _VIRTIO_BLK_H */
@@ -18,6 +18,13 @@ int main ()
 	return 2;
     }
 
+    /* regular files go to the terminal inside the kernel, a page per call */
+    while (0 < (cnt = ece391_sendfile (1, fd, 4096)))
+        ;
+    if (0 == cnt)
+        return 0;
+
+    /* directories and devices cannot be sent, read them through buf */
     while (0 != (cnt = ece391_read (fd, buf, 1024))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
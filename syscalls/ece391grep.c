@@ -5,6 +5,7 @@
 
 #define BUFSIZE 1024
 #define SBUFSIZE 33
+#define NUM_DIRENTS 32
 
 int32_t
 do_one_file (const char* s, const char* fname) 
@@ -67,9 +68,10 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, i, len;
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
+    struct ece391_dirent entries[NUM_DIRENTS];
 
     if (0 != ece391_getargs (search, BUFSIZE)) {
         ece391_fdputs (1, (uint8_t*)"could not read argument\n");
@@ -81,16 +83,20 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    while (0 != (cnt = ece391_getdents (fd, entries, sizeof (entries)))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	    return 3;
 	}
-	if ('.' == buf[0]) /* a directory... */
-	    continue;
-	buf[cnt] = '\0';
-	if (0 != do_one_file ((char*)search, (char*)buf))
-	    return 3;
+	for (i = 0; i < cnt / (int32_t)sizeof (struct ece391_dirent); i++) {
+	    if (REGULAR_FILE != entries[i].type) /* a directory or device... */
+		continue;
+	    for (len = 0; len < DIRENT_NAME_LEN && '\0' != entries[i].name[len]; len++)
+		buf[len] = entries[i].name[len];
+	    buf[len] = '\0';
+	    if (0 != do_one_file ((char*)search, (char*)buf))
+		return 3;
+	}
     }
 
     return 0;
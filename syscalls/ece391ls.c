@@ -4,25 +4,37 @@
 #include "ece391syscall.h"
 
 #define SBUFSIZE 33
+#define NUM_DIRENTS 32
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, i, len;
     uint8_t buf[SBUFSIZE];
+    uint8_t dir[SBUFSIZE];
+    struct ece391_dirent entries[NUM_DIRENTS];
 
-    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+    /* list the directory given as the argument, the root without one */
+    dir[SBUFSIZE - 1] = '\0';
+    if (0 != ece391_getargs (dir, SBUFSIZE - 1))
+        ece391_strcpy (dir, (uint8_t*)".");
+
+    if (-1 == (fd = ece391_open (dir))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    while (0 != (cnt = ece391_getdents (fd, entries, sizeof (entries)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
-	        return 3;
+	    for (i = 0; i < cnt / (int32_t)sizeof (struct ece391_dirent); i++) {
+	        for (len = 0; len < DIRENT_NAME_LEN && '\0' != entries[i].name[len]; len++)
+	            buf[len] = entries[i].name[len];
+	        buf[len] = '\n';
+	        if (-1 == ece391_write (1, buf, len + 1))
+	            return 3;
+	    }
     }
 
     return 0;
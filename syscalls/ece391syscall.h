@@ -21,6 +21,54 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_unlink (const uint8_t* filename);
+extern int32_t ece391_ftruncate (int32_t fd, uint32_t length);
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+extern int32_t ece391_stat (const uint8_t* filename, void* buf);
+extern int32_t ece391_fstat (int32_t fd, void* buf);
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+/* Maps length bytes (0 for all) of an open file read-only; returns the address or -1.
+   With fd ECE391_MMAP_ANON maps length bytes of zeroed, writable memory instead. */
+#define ECE391_MMAP_ANON (-1)
+extern int32_t ece391_mmap (int32_t fd, uint32_t length);
+extern int32_t ece391_munmap (void* addr, uint32_t length);
+/* Paths may name subdirectories, e.g. "dir/file"; unlink also removes empty directories. */
+extern int32_t ece391_mkdir (const uint8_t* path);
+/* Writes up to count bytes from in_fd's position to out_fd inside the kernel; returns
+   the number sent, 0 at the end of the file. in_fd must be a regular file. */
+extern int32_t ece391_sendfile (int32_t out_fd, int32_t in_fd, int32_t count);
+/* Grows (or with a negative increment shrinks) the heap; returns its old end or -1.
+   New heap memory reads as zero and only takes physical memory once touched. */
+extern int32_t ece391_sbrk (int32_t increment);
+
+/* One entry filled in by ece391_getdents; entries are packed back to back. */
+#define DIRENT_NAME_LEN 32
+struct ece391_dirent {
+	uint8_t name[DIRENT_NAME_LEN];	/* not NUL-terminated if 32 chars long */
+	int32_t type;
+	int32_t inode;
+	int32_t size;
+};
+
+/* File information filled in by ece391_stat and ece391_fstat. */
+struct ece391_stat {
+	int32_t type;
+	int32_t inode;
+	int32_t size;	/* length in bytes for regular files, 0 otherwise */
+};
+
+enum seek_whence {
+	SEEK_SET = 0,
+	SEEK_CUR,
+	SEEK_END
+};
+
+enum file_types {
+	RTC_FILE = 0,
+	DIR_FILE,
+	REGULAR_FILE
+};
 
 enum signums {
 	DIV_ZERO = 0,
@@ -11,5 +11,17 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_UNLINK  11
+#define SYS_FTRUNCATE  12
+#define SYS_GETDENTS  13
+#define SYS_STAT  14
+#define SYS_FSTAT  15
+#define SYS_LSEEK  16
+#define SYS_PREAD  17
+#define SYS_MMAP  18
+#define SYS_MUNMAP  19
+#define SYS_MKDIR  20
+#define SYS_SENDFILE  21
+#define SYS_SBRK  22
 
 #endif /* ECE391SYSNUM_H */
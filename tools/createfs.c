@@ -0,0 +1,770 @@
+/* createfs.c - build a filesystem image for the kernel from a host directory
+ *
+ * Produces the format student-distrib/filesystem.c reads: a boot block holding the root
+ * directory, the inode blocks, then the data blocks. Unlike the prebuilt createfs, the
+ * layout is chosen rather than scattered:
+ *   - each file's data blocks are one contiguous run, so read_data copies it in one
+ *     extent and execute loads it in bulk
+ *   - executables come first, in the order given by -l, then the other files; since
+ *     every data block is a 4 KB page of an image loaded page aligned, a program's
+ *     pages can be mapped straight out of the image
+ *   - -d stores identical data blocks once; the kernel copies a shared block before
+ *     writing to it
+ *   - -z stores other files as LZ4 chunks when that saves blocks
+ *   - subdirectories of the input become subdirectories of the image
+ *   - a hash table of every name goes after the files, found through the boot block, so
+ *     the kernel looks names up from mount without indexing them first (-N leaves it out)
+ *
+ * usage: createfs -i <dir> -o <image> [-l <order file>] [-n <inodes>] [-s <spare blocks>]
+ *                 [-d] [-z] [-2] [-N] [-v]
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE          4096
+#define FILENAME_LEN        32
+#define ROOT_DENTRIES       63      // dentries that fit in the boot block
+#define DATA_BLOCK_NUM      1023
+#define DIRECT_BLOCK_NUM    1021    // version 2: the last two entries are indirect blocks
+#define SINGLE_INDIRECT     1021
+#define DOUBLE_INDIRECT     1022
+#define PTRS_PER_BLOCK      (BLOCK_SIZE / 4)
+#define FS_VERSION_INDIRECT 2
+#define DENTRY_COMPRESSED   0x1
+#define DENTRY_DIR_INODE    0x2
+#define RTC_TYPE            0
+#define DIR_TYPE            1
+#define REGULAR_TYPE        2
+#define DEFAULT_INODES      64
+#define DEFAULT_SPARE       16      // free data blocks left for files written at run time
+#define DEDUPE_HASH_SIZE    65536   // power of two
+#define LZ4_HASH_BITS       12
+#define LZ4_MIN_MATCH       4
+#define LZ4_MATCH_LIMIT     12      // a match must start this far before the end
+#define LZ4_LAST_LITERALS   5       // and end this far before it
+#define UNRANKED            INT_MAX
+#define NAME_TABLE_MAGIC    0x4E4D5442
+#define NAME_SLOT_EMPTY     0xFFFF
+#define MIN_NAME_SLOTS      64
+
+typedef struct dentry {
+    char filename[FILENAME_LEN];
+    int32_t file_type;
+    int32_t inode_num;
+    int32_t flags;
+    int32_t raw_length;
+    uint8_t reserved[16];
+} dentry_t;
+
+typedef struct boot_block {
+    int32_t dir_count;
+    int32_t inode_count;
+    int32_t data_count;
+    int32_t version;
+    uint8_t reserved[48];
+    dentry_t direntries[ROOT_DENTRIES];
+} boot_block_t;
+
+typedef struct inode {
+    int32_t length;
+    int32_t data_block_num[DATA_BLOCK_NUM];
+} inode_t;
+
+/* kept at the start of boot_block_t.reserved, see student-distrib/filesystem.h */
+typedef struct name_table {
+    uint32_t magic;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    uint32_t num_slots;
+    uint32_t num_entries;
+    uint32_t checksum;
+} name_table_t;
+
+typedef struct name_slot {
+    uint32_t hash;
+    uint16_t dir;
+    uint16_t index;
+} name_slot_t;
+
+/* a file or directory read from the input */
+typedef struct node {
+    char name[FILENAME_LEN + 1];
+    char path[PATH_MAX];
+    int32_t type;
+    int32_t rank;               // position in the -l list, UNRANKED if not listed
+    int32_t is_exec;
+    int32_t flags;              // DENTRY_COMPRESSED or DENTRY_DIR_INODE
+    uint8_t* data;              // bytes as stored in the image
+    uint32_t length;
+    uint32_t raw_length;        // length before compression
+    uint32_t inode;
+    struct node* children;
+    uint32_t num_children;
+} node_t;
+
+/* options */
+static char** order_list;
+static int32_t order_count;
+static int32_t dedupe;
+static int32_t compress;
+static int32_t version;
+static int32_t verbose;
+static int32_t name_table = 1;
+
+/* image being built */
+static inode_t* inodes;
+static uint32_t num_inodes;
+static uint32_t next_inode = 1;     // inode 0 is the root directory's id in the kernel
+static uint8_t* blocks;
+static uint32_t num_blocks;
+static uint32_t block_capacity;
+static int32_t dedupe_hash[DEDUPE_HASH_SIZE];
+static uint32_t blocks_saved;
+static name_slot_t* name_slots;
+static uint32_t num_name_slots;
+
+static void die(const char* msg, const char* arg){
+    fprintf(stderr, "createfs: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+    exit(1);
+}
+
+static void* xmalloc(size_t size){
+    void* p = calloc(1, size ? size : 1);
+    if(p == NULL){
+        die("out of memory", NULL);
+    }
+    return p;
+}
+
+/* ---------------------------------------------------------------- LZ4 */
+
+static uint32_t read32(const uint8_t* p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* lz4_put_length
+ * Description: append the 255-run extension of a literal or match length
+ * Output: new position in dst, -1 if dst is full
+ */
+static int32_t lz4_put_length(uint8_t* dst, int32_t pos, int32_t cap, uint32_t len){
+    for(len -= 15; len >= 255; len -= 255){
+        if(pos >= cap){
+            return -1;
+        }
+        dst[pos++] = 255;
+    }
+    if(pos >= cap){
+        return -1;
+    }
+    dst[pos++] = len;
+    return pos;
+}
+
+/* lz4_put_sequence
+ * Description: append one sequence: literals, then a match unless match_len is 0
+ * Output: new position in dst, -1 if dst is full
+ */
+static int32_t lz4_put_sequence(uint8_t* dst, int32_t pos, int32_t cap, const uint8_t* literals,
+                                uint32_t lit_len, uint32_t offset, uint32_t match_len){
+    if(pos >= cap){
+        return -1;
+    }
+    dst[pos++] = ((lit_len < 15 ? lit_len : 15) << 4) |
+                 (match_len == 0 ? 0 : (match_len - LZ4_MIN_MATCH < 15 ? match_len - LZ4_MIN_MATCH : 15));
+    if(lit_len >= 15 && (pos = lz4_put_length(dst, pos, cap, lit_len)) == -1){
+        return -1;
+    }
+    if(pos + (int32_t)lit_len > cap){
+        return -1;
+    }
+    memcpy(dst + pos, literals, lit_len);
+    pos += lit_len;
+    if(match_len == 0){
+        return pos;
+    }
+    if(pos + 2 > cap){
+        return -1;
+    }
+    dst[pos++] = offset & 0xFF;
+    dst[pos++] = offset >> 8;
+    if(match_len - LZ4_MIN_MATCH >= 15){
+        pos = lz4_put_length(dst, pos, cap, match_len - LZ4_MIN_MATCH);
+    }
+    return pos;
+}
+
+/* lz4_compress
+ * Description: greedy LZ4 block compressor with a single-entry hash table
+ * Input: src, n: bytes to compress
+ *        dst, cap: output buffer
+ * Output: compressed length, -1 if it does not fit in cap
+ */
+static int32_t lz4_compress(const uint8_t* src, int32_t n, uint8_t* dst, int32_t cap){
+    static int32_t table[1 << LZ4_HASH_BITS];
+    int32_t i = 0, anchor = 0, pos = 0, ref, len;
+    uint32_t h;
+
+    memset(table, -1, sizeof(table));
+    while(i + LZ4_MATCH_LIMIT <= n){
+        h = (read32(src + i) * 2654435761U) >> (32 - LZ4_HASH_BITS);
+        ref = table[h];
+        table[h] = i;
+        if(ref < 0 || i - ref > 65535 || read32(src + ref) != read32(src + i)){
+            i++;
+            continue;
+        }
+        for(len = LZ4_MIN_MATCH; i + len < n - LZ4_LAST_LITERALS && src[ref + len] == src[i + len]; len++);
+        if((pos = lz4_put_sequence(dst, pos, cap, src + anchor, i - anchor, i - ref, len)) == -1){
+            return -1;
+        }
+        i += len;
+        anchor = i;
+    }
+    return lz4_put_sequence(dst, pos, cap, src + anchor, n - anchor, 0, 0);
+}
+
+/* compress_file
+ * Description: replace a file's data with LZ4 chunks if that takes fewer blocks. Chunk i
+ *              covers raw bytes [i * BLOCK_SIZE, (i + 1) * BLOCK_SIZE); the stored file starts
+ *              with chunks + 1 offsets, and a chunk as long as its raw bytes is stored raw
+ */
+static void compress_file(node_t* file){
+    uint32_t chunks = (file->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t header = (chunks + 1) * sizeof(uint32_t);
+    uint32_t i, raw_len, pos = header;
+    int32_t len;
+    uint8_t* out = xmalloc(header + (size_t)chunks * BLOCK_SIZE);
+    uint32_t* offsets = (uint32_t*)out;
+
+    for(i = 0; i < chunks; i++){
+        raw_len = (i + 1 < chunks) ? BLOCK_SIZE : file->length - i * BLOCK_SIZE;
+        offsets[i] = pos;
+        len = lz4_compress(file->data + i * BLOCK_SIZE, raw_len, out + pos, raw_len - 1);
+        if(len <= 0){
+            memcpy(out + pos, file->data + i * BLOCK_SIZE, raw_len);   //does not shrink
+            len = raw_len;
+        }
+        pos += len;
+    }
+    offsets[chunks] = pos;
+
+    if((pos + BLOCK_SIZE - 1) / BLOCK_SIZE >= chunks){
+        free(out);  //no block saved
+        return;
+    }
+    if(verbose){
+        printf("  %s: %u bytes stored as %u\n", file->path, file->length, pos);
+    }
+    free(file->data);
+    file->data = out;
+    file->raw_length = file->length;
+    file->length = pos;
+    file->flags |= DENTRY_COMPRESSED;
+}
+
+/* ---------------------------------------------------------------- reading the input */
+
+/* file_rank
+ * Description: position of a path in the -l list; entries are paths relative to the input
+ */
+static int32_t file_rank(const char* rel){
+    int32_t i;
+    for(i = 0; i < order_count; i++){
+        if(strcmp(order_list[i], rel) == 0){
+            return i;
+        }
+    }
+    return UNRANKED;
+}
+
+/* compare_nodes
+ * Description: layout order: listed files in list order, then executables, then the rest,
+ *              each by name
+ */
+static int compare_nodes(const void* a, const void* b){
+    const node_t* x = a;
+    const node_t* y = b;
+    if(x->rank != y->rank){
+        return (x->rank < y->rank) ? -1 : 1;
+    }
+    if(x->is_exec != y->is_exec){
+        return y->is_exec - x->is_exec;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static void read_file(node_t* file){
+    FILE* f = fopen(file->path, "rb");
+    struct stat st;
+
+    if(f == NULL || fstat(fileno(f), &st) != 0){
+        die("cannot read", file->path);
+    }
+    file->length = file->raw_length = st.st_size;
+    file->data = xmalloc(file->length);
+    if(file->length > 0 && fread(file->data, 1, file->length, f) != file->length){
+        die("short read", file->path);
+    }
+    fclose(f);
+    file->is_exec = file->length >= 4 && memcmp(file->data, "\x7f" "ELF", 4) == 0;
+    if(compress && !file->is_exec){
+        compress_file(file);    //programs stay raw so their pages can be mapped
+    }
+}
+
+/* read_dir
+ * Description: read a directory of the input and everything below it
+ * Input: dir: node to fill, with path set
+ *        rel: path of dir relative to the input, "" for the input itself
+ */
+static void read_dir(node_t* dir, const char* rel){
+    DIR* d = opendir(dir->path);
+    struct dirent* ent;
+    struct stat st;
+    node_t* child;
+    uint32_t capacity = 16;
+    char child_rel[PATH_MAX];
+
+    if(d == NULL){
+        die("cannot open directory", dir->path);
+    }
+    dir->children = xmalloc(capacity * sizeof(node_t));
+    while((ent = readdir(d)) != NULL){
+        if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0){
+            continue;
+        }
+        if(dir->num_children == capacity){
+            capacity *= 2;
+            dir->children = realloc(dir->children, capacity * sizeof(node_t));
+            if(dir->children == NULL){
+                die("out of memory", NULL);
+            }
+        }
+        child = &dir->children[dir->num_children];
+        memset(child, 0, sizeof(node_t));
+        if(snprintf(child->path, sizeof(child->path), "%s/%s", dir->path, ent->d_name) >= (int)sizeof(child->path)){
+            die("path too long", ent->d_name);
+        }
+        snprintf(child_rel, sizeof(child_rel), "%s%s%s", rel, *rel ? "/" : "", ent->d_name);
+        if(strlen(ent->d_name) > FILENAME_LEN && verbose){
+            printf("  %s: name cut to %d characters\n", child->path, FILENAME_LEN);
+        }
+        memcpy(child->name, ent->d_name, strnlen(ent->d_name, FILENAME_LEN));
+        child->rank = file_rank(child_rel);
+        if(stat(child->path, &st) != 0){
+            die("cannot stat", child->path);
+        }
+        if(S_ISDIR(st.st_mode)){
+            child->type = DIR_TYPE;
+            child->flags = DENTRY_DIR_INODE;
+            read_dir(child, child_rel);
+        }else if(S_ISREG(st.st_mode)){
+            child->type = REGULAR_TYPE;
+            read_file(child);
+        }else{
+            fprintf(stderr, "createfs: skipping %s\n", child->path);
+            continue;
+        }
+        dir->num_children++;
+    }
+    closedir(d);
+    qsort(dir->children, dir->num_children, sizeof(node_t), compare_nodes);
+}
+
+/* ---------------------------------------------------------------- building the image */
+
+/* assign_inodes
+ * Description: number the inodes breadth first in layout order
+ */
+static void assign_inodes(node_t* dir){
+    uint32_t i;
+    for(i = 0; i < dir->num_children; i++){
+        if(dir->children[i].type != RTC_TYPE){
+            dir->children[i].inode = next_inode++;
+        }
+    }
+    for(i = 0; i < dir->num_children; i++){
+        if(dir->children[i].type == DIR_TYPE){
+            assign_inodes(&dir->children[i]);
+        }
+    }
+}
+
+/* new_block
+ * Description: append a zeroed data block
+ * Output: its block number
+ */
+static uint32_t new_block(){
+    if(num_blocks == block_capacity){
+        block_capacity = block_capacity ? block_capacity * 2 : 64;
+        blocks = realloc(blocks, (size_t)block_capacity * BLOCK_SIZE);
+        if(blocks == NULL){
+            die("out of memory", NULL);
+        }
+    }
+    memset(blocks + (size_t)num_blocks * BLOCK_SIZE, 0, BLOCK_SIZE);
+    return num_blocks++;
+}
+
+static uint32_t block_hash(const uint8_t* data){
+    uint32_t hash = 2166136261U, i;
+    for(i = 0; i < BLOCK_SIZE; i++){
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/* store_block
+ * Description: put one block of file data in the image, reusing an identical block when
+ *              deduplicating
+ * Input: data: BLOCK_SIZE bytes
+ * Output: block number
+ */
+static uint32_t store_block(const uint8_t* data){
+    uint32_t slot = 0, num;
+
+    if(dedupe){
+        for(slot = block_hash(data) & (DEDUPE_HASH_SIZE - 1); dedupe_hash[slot] != -1;
+            slot = (slot + 1) & (DEDUPE_HASH_SIZE - 1)){
+            if(memcmp(blocks + (size_t)dedupe_hash[slot] * BLOCK_SIZE, data, BLOCK_SIZE) == 0){
+                blocks_saved++;
+                return dedupe_hash[slot];
+            }
+        }
+    }
+    num = new_block();
+    memcpy(blocks + (size_t)num * BLOCK_SIZE, data, BLOCK_SIZE);
+    if(dedupe){
+        dedupe_hash[slot] = num;
+    }
+    return num;
+}
+
+/* store_data
+ * Description: lay a file's bytes out as one run of data blocks and point its inode at
+ *              them; indirect blocks go after the run so they do not split it
+ */
+static void store_data(uint32_t inode, const uint8_t* data, uint32_t length, int32_t shareable){
+    uint32_t count = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t i, table = 0, double_table = 0, direct = (version == FS_VERSION_INDIRECT) ? DIRECT_BLOCK_NUM : DATA_BLOCK_NUM;
+    uint8_t buf[BLOCK_SIZE];
+    uint32_t* nums = xmalloc((count + 1) * sizeof(uint32_t));
+    uint32_t* ptrs;
+
+    if(inode >= num_inodes){
+        die("not enough inodes, use -n", NULL);
+    }
+    for(i = 0; i < count; i++){
+        memset(buf, 0, BLOCK_SIZE);
+        memcpy(buf, data + (size_t)i * BLOCK_SIZE, (i + 1 < count) ? BLOCK_SIZE : length - i * BLOCK_SIZE);
+        if(shareable){
+            nums[i] = store_block(buf);
+        }else{
+            nums[i] = new_block();
+            memcpy(blocks + (size_t)nums[i] * BLOCK_SIZE, buf, BLOCK_SIZE);
+        }
+    }
+
+    inodes[inode].length = length;
+    for(i = 0; i < count && i < direct; i++){
+        inodes[inode].data_block_num[i] = nums[i];
+    }
+    if(count > direct && version != FS_VERSION_INDIRECT){
+        die("file too large for a version 1 image, use -2", NULL);
+    }
+    for(i = direct; i < count; i++){
+        if(i == DIRECT_BLOCK_NUM + PTRS_PER_BLOCK){
+            double_table = new_block();
+            inodes[inode].data_block_num[DOUBLE_INDIRECT] = double_table;
+        }
+        if((i - DIRECT_BLOCK_NUM) % PTRS_PER_BLOCK == 0){
+            table = new_block();
+            if(i == DIRECT_BLOCK_NUM){
+                inodes[inode].data_block_num[SINGLE_INDIRECT] = table;
+            }else{
+                ptrs = (uint32_t*)(blocks + (size_t)double_table * BLOCK_SIZE);
+                ptrs[(i - DIRECT_BLOCK_NUM) / PTRS_PER_BLOCK - 1] = table;
+            }
+        }
+        ptrs = (uint32_t*)(blocks + (size_t)table * BLOCK_SIZE);
+        ptrs[(i - DIRECT_BLOCK_NUM) % PTRS_PER_BLOCK] = nums[i];
+    }
+    free(nums);
+}
+
+static void fill_dentry(dentry_t* dentry, const node_t* node){
+    memset(dentry, 0, sizeof(dentry_t));
+    memcpy(dentry->filename, node->name, strnlen(node->name, FILENAME_LEN));
+    dentry->file_type = node->type;
+    dentry->inode_num = node->inode;
+    dentry->flags = node->flags;
+    dentry->raw_length = (node->flags & DENTRY_COMPRESSED) ? node->raw_length : 0;
+}
+
+/* store_dir
+ * Description: lay out the files of a directory in order, then its subdirectories
+ */
+static void store_dir(node_t* dir){
+    uint32_t i;
+    dentry_t* entries;
+
+    for(i = 0; i < dir->num_children; i++){
+        if(dir->children[i].type == REGULAR_TYPE){
+            if(verbose){
+                printf("  inode %3u, block %5u: %s\n", dir->children[i].inode, num_blocks, dir->children[i].path);
+            }
+            store_data(dir->children[i].inode, dir->children[i].data, dir->children[i].length, 1);
+        }
+    }
+    for(i = 0; i < dir->num_children; i++){
+        if(dir->children[i].type != DIR_TYPE){
+            continue;
+        }
+        entries = xmalloc(dir->children[i].num_children * sizeof(dentry_t));
+        for(uint32_t j = 0; j < dir->children[i].num_children; j++){
+            fill_dentry(&entries[j], &dir->children[i].children[j]);
+        }
+        store_data(dir->children[i].inode, (uint8_t*)entries, dir->children[i].num_children * sizeof(dentry_t), 0);
+        free(entries);
+        store_dir(&dir->children[i]);
+    }
+}
+
+/* name_hash
+ * Description: the kernel's dentry index hash: FNV-1a of the name mixed with the directory id
+ */
+static uint32_t name_hash(uint32_t dir, const char* name){
+    uint32_t hash = 2166136261U;
+    int i;
+    for(i = 0; i < FILENAME_LEN && name[i] != '\0'; i++){
+        hash = (hash ^ (uint8_t)name[i]) * 16777619U;
+    }
+    return hash ^ (dir * 2654435761U);
+}
+
+static uint32_t count_names(const node_t* dir){
+    uint32_t i, count = dir->num_children;
+    for(i = 0; i < dir->num_children; i++){
+        count += count_names(&dir->children[i]);
+    }
+    return count;
+}
+
+/* add_names
+ * Description: put every dentry of a directory and of the directories below it in the
+ *              name table
+ * Input: dir: the directory
+ *        id: its directory id, 0 for the root
+ */
+static void add_names(const node_t* dir, uint32_t id){
+    uint32_t i, hash, slot;
+
+    if(dir->num_children >= NAME_SLOT_EMPTY){
+        die("too many files for the name table, use -N", dir->path);
+    }
+    for(i = 0; i < dir->num_children; i++){
+        hash = name_hash(id, dir->children[i].name);
+        for(slot = hash & (num_name_slots - 1); name_slots[slot].index != NAME_SLOT_EMPTY;
+            slot = (slot + 1) & (num_name_slots - 1));
+        name_slots[slot].hash = hash;
+        name_slots[slot].dir = id;
+        name_slots[slot].index = i;
+    }
+    for(i = 0; i < dir->num_children; i++){
+        if(dir->children[i].type == DIR_TYPE && dir->children[i].inode != 0){
+            add_names(&dir->children[i], dir->children[i].inode);
+        }
+    }
+}
+
+/* store_name_table
+ * Description: write the name table into blocks after the files and describe it in the
+ *              boot block; at most half the slots are used so probe runs stay short
+ */
+static void store_name_table(const node_t* root, boot_block_t* boot){
+    name_table_t table;
+    uint32_t i, sum = 0, first;
+
+    memset(&table, 0, sizeof(table));
+    table.num_entries = count_names(root);
+    for(num_name_slots = MIN_NAME_SLOTS; num_name_slots < 2 * table.num_entries; num_name_slots *= 2);
+    if(num_inodes > NAME_SLOT_EMPTY){
+        die("too many inodes for the name table, use -N", NULL);
+    }
+    name_slots = xmalloc(num_name_slots * sizeof(name_slot_t));
+    for(i = 0; i < num_name_slots; i++){
+        name_slots[i].index = NAME_SLOT_EMPTY;
+    }
+    add_names(root, 0);
+
+    for(i = 0; i < num_name_slots; i++){
+        sum = ((sum << 1) | (sum >> 31)) ^ name_slots[i].hash;
+        sum = ((sum << 1) | (sum >> 31)) ^ (name_slots[i].dir | ((uint32_t)name_slots[i].index << 16));
+    }
+    table.num_blocks = (num_name_slots * sizeof(name_slot_t) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    first = num_blocks;     //new_block appends, so the table's blocks are consecutive
+    for(i = 0; i < table.num_blocks; i++){
+        new_block();
+    }
+    memcpy(blocks + (size_t)first * BLOCK_SIZE, name_slots, num_name_slots * sizeof(name_slot_t));
+    table.magic = NAME_TABLE_MAGIC;
+    table.first_block = first;
+    table.num_slots = num_name_slots;
+    table.checksum = sum;
+    memcpy(boot->reserved, &table, sizeof(table));
+    free(name_slots);
+}
+
+static uint32_t max_blocks(const node_t* dir){
+    uint32_t i, n, most = 0;
+    for(i = 0; i < dir->num_children; i++){
+        n = (dir->children[i].type == DIR_TYPE) ? max_blocks(&dir->children[i])
+                                               : (dir->children[i].length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        most = (n > most) ? n : most;
+    }
+    return most;
+}
+
+static void read_order_list(const char* path){
+    FILE* f = fopen(path, "r");
+    char line[PATH_MAX];
+    uint32_t capacity = 16;
+
+    if(f == NULL){
+        die("cannot read", path);
+    }
+    order_list = xmalloc(capacity * sizeof(char*));
+    while(fgets(line, sizeof(line), f) != NULL){
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0' || line[0] == '#'){
+            continue;
+        }
+        if((uint32_t)order_count == capacity){
+            capacity *= 2;
+            order_list = realloc(order_list, capacity * sizeof(char*));
+        }
+        order_list[order_count++] = strdup(line);
+    }
+    fclose(f);
+}
+
+static void usage(const char* prog){
+    fprintf(stderr,
+        "Usage: %s -i <dir> -o <image> [options]\n"
+        "Options:\n"
+        "  -i <path>   input directory\n"
+        "  -o <path>   output image\n"
+        "  -l <path>   file listing paths in expected access order, one per line\n"
+        "  -n <count>  number of inodes (default %d)\n"
+        "  -s <count>  free data blocks to leave for writes (default %d)\n"
+        "  -d          store identical data blocks once\n"
+        "  -z          compress files other than executables with LZ4\n"
+        "  -2          version 2 image with indirect blocks (needed past 4 MB)\n"
+        "  -N          leave out the name table\n"
+        "  -v          list the layout\n",
+        prog, DEFAULT_INODES, DEFAULT_SPARE);
+    exit(2);
+}
+
+int main(int argc, char** argv){
+    const char* input = NULL;
+    const char* output = NULL;
+    uint32_t spare = DEFAULT_SPARE, i;
+    node_t root;
+    boot_block_t boot;
+    FILE* out;
+    int opt;
+
+    num_inodes = DEFAULT_INODES;
+    while((opt = getopt(argc, argv, "hi:o:l:n:s:dz2Nv")) != -1){
+        switch(opt){
+        case 'i': input = optarg; break;
+        case 'o': output = optarg; break;
+        case 'l': read_order_list(optarg); break;
+        case 'n': num_inodes = strtoul(optarg, NULL, 0); break;
+        case 's': spare = strtoul(optarg, NULL, 0); break;
+        case 'd': dedupe = 1; break;
+        case 'z': compress = 1; break;
+        case '2': version = FS_VERSION_INDIRECT; break;
+        case 'N': name_table = 0; break;
+        case 'v': verbose = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(input == NULL || output == NULL){
+        usage(argv[0]);
+    }
+
+    memset(&root, 0, sizeof(root));
+    snprintf(root.path, sizeof(root.path), "%s", input);
+    read_dir(&root, "");
+
+    /* the root gets "." first and the rtc device, as in the original images */
+    root.children = realloc(root.children, (root.num_children + 2) * sizeof(node_t));
+    memmove(root.children + 1, root.children, root.num_children * sizeof(node_t));
+    memset(&root.children[0], 0, sizeof(node_t));
+    strcpy(root.children[0].name, ".");
+    root.children[0].type = DIR_TYPE;
+    root.num_children++;
+    for(i = 0; i < root.num_children && strcmp(root.children[i].name, "rtc") != 0; i++);
+    if(i == root.num_children){
+        memset(&root.children[i], 0, sizeof(node_t));
+        strcpy(root.children[i].name, "rtc");
+        root.children[i].type = RTC_TYPE;
+        root.num_children++;
+    }
+    if(root.num_children > ROOT_DENTRIES){
+        die("too many files in the top directory", NULL);
+    }
+    if(max_blocks(&root) > DATA_BLOCK_NUM){
+        version = FS_VERSION_INDIRECT;
+    }
+
+    assign_inodes(&root);
+    root.children[0].inode = 0;     //"." has no inode of its own
+    next_inode--;
+    if(next_inode + 1 > num_inodes){
+        num_inodes = next_inode + 1;
+    }
+    inodes = xmalloc((size_t)num_inodes * sizeof(inode_t));
+    memset(dedupe_hash, -1, sizeof(dedupe_hash));
+    store_dir(&root);
+
+    memset(&boot, 0, sizeof(boot));
+    if(name_table){
+        store_name_table(&root, &boot);
+    }
+    boot.dir_count = root.num_children;
+    boot.inode_count = num_inodes;
+    boot.data_count = num_blocks + spare;
+    boot.version = version;
+    for(i = 0; i < root.num_children; i++){
+        fill_dentry(&boot.direntries[i], &root.children[i]);
+    }
+    for(i = 0; i < spare; i++){
+        new_block();
+    }
+
+    if((out = fopen(output, "wb")) == NULL){
+        die("cannot write", output);
+    }
+    if(fwrite(&boot, sizeof(boot), 1, out) != 1 ||
+       fwrite(inodes, sizeof(inode_t), num_inodes, out) != num_inodes ||
+       (num_blocks > 0 && fwrite(blocks, BLOCK_SIZE, num_blocks, out) != num_blocks)){
+        die("write failed", output);
+    }
+    fclose(out);
+    printf("%s: %u entries, %u inodes, %u data blocks (%u free, %u shared), version %d\n",
+           output, boot.dir_count, num_inodes, num_blocks, spare, blocks_saved, version);
+    return 0;
+}
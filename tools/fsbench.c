@@ -0,0 +1,419 @@
+/* fsbench.c - time the filesystem read path on the host
+ *
+ * Builds student-distrib/filesystem.c, lib.c and the block layer into an i386 Linux
+ * program (see the Makefile), mounts an image straight from a file, checks the slots of
+ * its name table, which the kernel does not sum at mount, and times
+ *   - read_dentry_by_name of every name in the root directory, and of a missing name,
+ *     against the read_dentry_by_scan it replaced
+ *   - read_data of every regular file, in several chunk sizes
+ *   - dir_read through the whole root directory
+ * Each figure is the fastest of several rounds, in cycles, so a change to the read path
+ * can be measured without booting QEMU.
+ *
+ * Not every host has a 32-bit libc, and lib.c defines memcpy, strlen and printf itself,
+ * so the program is freestanding and makes its few system calls with int $0x80. The
+ * kernel's cli and sti become no-ops under HOST_BUILD (lib.h).
+ *
+ * usage: fsbench [-d] [-x] [-r <rounds>] <image>
+ *   -d  mount through the buffer cache from a block device backed by the file, the way
+ *       the kernel mounts a disk, instead of from the mapped image
+ *   -x  time only the regular files that are not programs, which createfs -z stores
+ *       compressed, so images built with and without -z can be compared
+ *       (make bench-lz4)
+ *   -r  rounds per figure, default 5
+ */
+
+#include "types.h"
+#include "lib.h"
+#include "filesystem.h"
+#include "system_calls.h"
+#include "terminal.h"
+#include "cursor.h"
+#include "vfs.h"
+#include "blkdev.h"
+#include "bcache.h"
+#include "buddy.h"
+
+#define SYS_EXIT        1
+#define SYS_WRITE       4
+#define SYS_OPEN        5
+#define SYS_LSEEK       19
+#define SYS_MMAP        90      // old_mmap, which takes its six arguments in memory
+#define SEEK_END        2
+#define PROT_RW         0x3
+#define MAP_PRIVATE     0x2
+#define MAP_ANONYMOUS   0x20
+#define STDOUT          1
+#define STDERR          2
+
+#define DEFAULT_ROUNDS  5
+#define LOOKUP_REPEATS  100     // lookups of each name per round
+#define MAX_NAMES       DENTRY_NUM
+#define CHUNK_BUF_SIZE  65536
+#define BENCH_FD        2       // descriptor dir_read is handed
+
+/* the kernel code calls these; nothing here draws to a screen or has processes */
+static PCB bench_pcb;
+static terminal_t bench_term;
+file_ops RTC_fop;
+
+PCB* get_curr_pcb(){
+    return &bench_pcb;
+}
+
+terminal_t* curr_term(){
+    return &bench_term;
+}
+
+void update_cursor(int x, int y){
+}
+
+int32_t file_busy(file_ops* fops, uint32_t inode, uint32_t uses){
+    return 0;
+}
+
+static uint32_t map_memory(int32_t fd, uint32_t size, uint32_t flags);
+
+/* the buffer cache takes its buffers from here; memory is never given back */
+uint32_t buddy_alloc(uint32_t order){
+    return map_memory(-1, FRAME_SIZE << order, MAP_PRIVATE | MAP_ANONYMOUS);
+}
+
+static uint8_t* image;
+static uint32_t image_size;
+static block_dev_t image_dev;
+static int8_t names[MAX_NAMES][FILENAME_LEN + 1];
+static uint32_t num_names;
+static uint32_t num_compressed;         //names whose files are stored as LZ4 chunks
+static uint32_t data_only;              //-x
+static uint8_t chunk_buf[CHUNK_BUF_SIZE];
+static uint32_t rounds = DEFAULT_ROUNDS;
+
+/* ---------------------------------------------------------------- Linux */
+
+static int32_t syscall3(uint32_t num, uint32_t a, uint32_t b, uint32_t c){
+    int32_t ret;
+    asm volatile ("int $0x80"
+            : "=a"(ret)
+            : "a"(num), "b"(a), "c"(b), "d"(c)
+            : "memory", "cc"
+    );
+    return ret;
+}
+
+void sys_exit(int32_t status){
+    syscall3(SYS_EXIT, status, 0, 0);
+    for(;;);
+}
+
+asm (".globl _start             \n"
+     "_start:                   \n"
+     "    xorl %ebp, %ebp       \n"
+     "    movl %esp, %eax       \n"
+     "    leal 4(%eax), %ecx    \n"
+     "    pushl %ecx            \n"     // argv
+     "    pushl (%eax)          \n"     // argc
+     "    call main             \n"
+     "    pushl %eax            \n"
+     "    call sys_exit         \n");
+
+static void put_str(int32_t fd, const char* s){
+    syscall3(SYS_WRITE, fd, (uint32_t)s, strlen((const int8_t*)s));
+}
+
+/* format_num
+ * Description: write an unsigned number right aligned in width columns
+ * Output: buf, which needs width + 11 bytes
+ */
+static char* format_num(char* buf, uint32_t value, uint32_t width){
+    char digits[11];
+    uint32_t n = 0, i = 0;
+
+    do{
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    }while(value != 0);
+    for(; width > n; width--){
+        buf[i++] = ' ';
+    }
+    while(n > 0){
+        buf[i++] = digits[--n];
+    }
+    buf[i] = '\0';
+    return buf;
+}
+
+static void put_num(uint32_t value, uint32_t width){
+    char buf[48];
+    put_str(STDOUT, format_num(buf, value, width));
+}
+
+static void die(const char* msg, const char* arg){
+    put_str(STDERR, "fsbench: ");
+    put_str(STDERR, msg);
+    if(arg != NULL){
+        put_str(STDERR, ": ");
+        put_str(STDERR, arg);
+    }
+    put_str(STDERR, "\n");
+    sys_exit(1);
+}
+
+/* map_memory
+ * Description: map size bytes of a file, or of zeroed memory for fd -1, writable
+ * Output: the address, 0 for fail
+ */
+static uint32_t map_memory(int32_t fd, uint32_t size, uint32_t flags){
+    uint32_t args[6];
+    int32_t addr;
+
+    args[0] = 0;
+    args[1] = size;
+    args[2] = PROT_RW;
+    args[3] = flags;
+    args[4] = fd;
+    args[5] = 0;
+    addr = syscall3(SYS_MMAP, (uint32_t)args, 0, 0);
+    return (addr < 0 && addr > -4096) ? 0 : (uint32_t)addr;
+}
+
+/* map_image
+ * Description: map the image file private and writable, since mounting an image may
+ *              patch it in memory; the file itself is never changed
+ */
+static void map_image(const char* path){
+    int32_t fd;
+
+    if((fd = syscall3(SYS_OPEN, (uint32_t)path, 0, 0)) < 0){
+        die("cannot open", path);
+    }
+    image_size = syscall3(SYS_LSEEK, fd, 0, SEEK_END);
+    if((int32_t)image_size <= 0){
+        die("empty image", path);
+    }
+    if((image = (uint8_t*)map_memory(fd, image_size, MAP_PRIVATE)) == NULL){
+        die("cannot map", path);
+    }
+}
+
+/* ---------------------------------------------------------------- mounting */
+
+static int32_t image_read(block_dev_t* dev, uint32_t lba, uint32_t count, void* buf){
+    memcpy(buf, image + lba * SECTOR_SIZE, count * SECTOR_SIZE);
+    return 0;
+}
+
+/* mount_image
+ * Description: mount the mapped image, directly or through a block device and the
+ *              buffer cache
+ */
+static void mount_image(uint32_t disk){
+    if(!disk){
+        init_filesystem((uint32_t)image);
+        return;
+    }
+    strcpy(image_dev.name, (int8_t*)"img");
+    image_dev.sectors = image_size / SECTOR_SIZE;
+    image_dev.max_sectors = BLK_MAX_PAGES * BLK_PAGE_SECTORS;
+    image_dev.read = image_read;
+    if(bcache_init() == -1){
+        die("cannot map the buffer cache", NULL);
+    }
+    if(register_block_dev(&image_dev) == -1 || init_filesystem_disk(&image_dev) == -1){
+        die("not a filesystem image", NULL);
+    }
+}
+
+/* is_program
+ * Description: check whether a regular file starts with the ELF magic
+ */
+static uint32_t is_program(const dentry_t* dentry){
+    uint8_t magic[4];
+
+    return read_data(dentry->inode_num, 0, magic, 4) == 4 && magic[0] == ELFMAG0 &&
+           magic[1] == ELFMAG1 && magic[2] == ELFMAG2 && magic[3] == ELFMAG3;
+}
+
+/* collect_names
+ * Description: remember every name in the root directory for the lookup figures, or
+ *              with -x only those of regular files that are not programs;
+ *              read_dentry_by_index returns unused slots too, which have no name
+ */
+static void collect_names(){
+    dentry_t dentry;
+    uint32_t i;
+
+    for(i = 0; num_names < MAX_NAMES && read_dentry_by_index(i, &dentry) == 0; i++){
+        if(dentry.filename[0] == '\0' ||
+           (data_only && (dentry.file_type != REGULAR_TYPE || is_program(&dentry)))){
+            continue;
+        }
+        strncpy(names[num_names], dentry.filename, FILENAME_LEN);
+        names[num_names++][FILENAME_LEN] = '\0';
+        num_compressed += (dentry.flags & DENTRY_COMPRESSED) != 0;
+    }
+}
+
+/* ---------------------------------------------------------------- figures */
+
+static void report(const char* what, uint32_t cycles, uint32_t ops, const char* unit){
+    put_str(STDOUT, what);
+    put_num(cycles / ops, 40 - strlen((const int8_t*)what));
+    put_str(STDOUT, " cycles/");
+    put_str(STDOUT, unit);
+    put_str(STDOUT, "\n");
+}
+
+/* bench_lookup
+ * Description: fastest round of LOOKUP_REPEATS lookups of every name
+ * Output: cycles of that round
+ */
+static uint32_t bench_lookup(int32_t (*lookup)(const uint8_t*, dentry_t*), uint32_t missing){
+    dentry_t dentry;
+    uint32_t round, repeat, i, start, cycles, best = 0xFFFFFFFF;
+
+    for(round = 0; round < rounds; round++){
+        start = rdtsc();
+        for(repeat = 0; repeat < LOOKUP_REPEATS; repeat++){
+            if(missing){
+                lookup((const uint8_t*)"no_such_file_in_the_image", &dentry);
+                continue;
+            }
+            for(i = 0; i < num_names; i++){
+                lookup((const uint8_t*)names[i], &dentry);
+            }
+        }
+        cycles = rdtsc() - start;
+        if(cycles < best){
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+/* bench_read
+ * Description: fastest round of reading every regular file start to end, chunk bytes
+ *              per read_data call
+ * Input: bytes: set to the bytes one round reads
+ * Output: cycles of that round
+ */
+static uint32_t bench_read(uint32_t chunk, uint32_t* bytes){
+    dentry_t dentry;
+    uint32_t round, i, offset, start, cycles, best = 0xFFFFFFFF;
+    int32_t count;
+
+    for(round = 0; round < rounds; round++){
+        *bytes = 0;
+        start = rdtsc();
+        for(i = 0; i < num_names; i++){
+            if(read_dentry_by_name((const uint8_t*)names[i], &dentry) != 0 || dentry.file_type != REGULAR_TYPE){
+                continue;
+            }
+            for(offset = 0; (count = read_data(dentry.inode_num, offset, chunk_buf, chunk)) > 0; offset += count);
+            *bytes += offset;
+        }
+        cycles = rdtsc() - start;
+        if(cycles < best){
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+/* bench_dir_read
+ * Description: fastest round of reading the root directory with dir_read until it ends
+ * Input: entries: set to the names one round reads
+ * Output: cycles of that round
+ */
+static uint32_t bench_dir_read(uint32_t* entries){
+    int8_t name[FILENAME_LEN + 1];
+    uint32_t round, start, cycles, best = 0xFFFFFFFF;
+
+    bench_pcb.fda[BENCH_FD].inode = ROOT_DIR_INODE;
+    for(round = 0; round < rounds; round++){
+        *entries = 0;
+        bench_pcb.fda[BENCH_FD].file_position = 0;
+        start = rdtsc();
+        while(dir_read(BENCH_FD, name, FILENAME_LEN) > 0){
+            (*entries)++;
+        }
+        cycles = rdtsc() - start;
+        if(cycles < best){
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+static void usage(){
+    die("usage: fsbench [-d] [-x] [-r <rounds>] <image>", NULL);
+}
+
+int main(int argc, char** argv){
+    static const uint32_t chunks[] = {128, 1024, BLOCK_SIZE, CHUNK_BUF_SIZE};
+    const char* path = NULL;
+    char label[40];
+    uint32_t disk = 0, bytes, entries, cycles, i;
+    int32_t arg;
+
+    for(arg = 1; arg < argc; arg++){
+        if(strncmp((int8_t*)argv[arg], (int8_t*)"-d", 3) == 0){
+            disk = 1;
+        }else if(strncmp((int8_t*)argv[arg], (int8_t*)"-x", 3) == 0){
+            data_only = 1;
+        }else if(strncmp((int8_t*)argv[arg], (int8_t*)"-r", 3) == 0 && arg + 1 < argc){
+            rounds = 0;
+            for(i = 0; argv[arg + 1][i] >= '0' && argv[arg + 1][i] <= '9'; i++){
+                rounds = rounds * 10 + argv[arg + 1][i] - '0';
+            }
+            arg++;
+        }else if(argv[arg][0] != '-' && path == NULL){
+            path = argv[arg];
+        }else{
+            usage();
+        }
+    }
+    if(path == NULL || rounds == 0){
+        usage();
+    }
+
+    map_image(path);
+    mount_image(disk);
+    if(verify_name_table() == -1){
+        die("name table does not match its checksum", path);
+    }
+    collect_names();
+    if(num_names == 0){
+        die(data_only ? "no data files in the root directory" : "no names in the root directory", path);
+    }
+    put_str(STDOUT, path);
+    put_str(STDOUT, disk ? " through the buffer cache, " : " mapped, ");
+    put_num(num_names, 0);
+    put_str(STDOUT, data_only ? " data files (" : " names (");
+    put_num(num_compressed, 0);
+    put_str(STDOUT, " compressed), best of ");
+    put_num(rounds, 0);
+    put_str(STDOUT, " rounds\n");
+
+    report("read_dentry_by_name", bench_lookup(read_dentry_by_name, 0), LOOKUP_REPEATS * num_names, "lookup");
+    report("read_dentry_by_name, missing", bench_lookup(read_dentry_by_name, 1), LOOKUP_REPEATS, "lookup");
+    report("read_dentry_by_scan", bench_lookup(read_dentry_by_scan, 0), LOOKUP_REPEATS * num_names, "lookup");
+    report("read_dentry_by_scan, missing", bench_lookup(read_dentry_by_scan, 1), LOOKUP_REPEATS, "lookup");
+    for(i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++){
+        strcpy((int8_t*)label, (int8_t*)"read_data, ");
+        format_num(label + strlen((int8_t*)label), chunks[i], 0);
+        strcpy((int8_t*)label + strlen((int8_t*)label), (int8_t*)" byte chunks");
+        cycles = bench_read(chunks[i], &bytes);
+        report(label, cycles, (bytes + 1023) / 1024, "KB");
+    }
+    cycles = bench_dir_read(&entries);
+    report("dir_read", cycles, entries, "entry");
+    if(disk){
+        put_str(STDOUT, "buffer cache hits ");
+        put_num(bcache_stats.hits, 0);
+        put_str(STDOUT, ", misses ");
+        put_num(bcache_stats.misses, 0);
+        put_str(STDOUT, "\n");
+    }
+    return 0;
+}